@@ -0,0 +1,186 @@
+/********************************************************************************************************************************************
+ * fastSF
+ *
+ * Copyright (C) 2020, Mahendra K. Verma
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     1. Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *     2. Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *     3. Neither the name of the copyright holder nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ********************************************************************************************************************************************
+ */
+
+/*! \file analysis.cc
+ *
+ *  \brief In-situ analysis of the demo, computing the velocity structure functions of the snapshots published by the simulation with
+ *         libfastsf.
+ *
+ *  All the MPI processes (which have to run on the node of the simulation) map the shared memory segment and pass the fields in it
+ *  to fastsf_compute() without copying them. After every snapshot, rank 0 releases the segment for the simulation and appends the
+ *  second-order longitudinal structure function along x to out/insitu_S2.txt (one line per snapshot: step, time, and
+ *  S_2(l_x) for l_x = dx, 2dx, ..., (Nx/2-1)dx).
+ *
+ *  Usage: mpirun -np P analysis.out [px] [segment]
+ *
+ *  \author Shubhadeep Sadhukhan, Shashwat Bhattacharya, Mahendra K. Verma
+ *  \date Feb 2020
+ *  \copyright New BSD License
+ *
+ ********************************************************************************************************************************************
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mpi.h>
+#include "insitu_shm.h"
+#include "libfastsf.h"
+using namespace std;
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to map the shared memory segment once the simulation has created and initialized it.
+ *
+ * \param   segment is the name of the segment.
+ * \param   size returns the size of the mapping.
+ *
+ * \return  The header of the segment.
+ ********************************************************************************************************************************************
+ */
+insitu_header* attach(string segment, size_t& size) {
+    struct stat st;
+    int fd=-1;
+    //The simulation may not have started yet
+    while (true) {
+        fd=shm_open(segment.c_str(), O_RDWR, 0600);
+        if (fd >= 0 and fstat(fd, &st) == 0 and size_t(st.st_size) >= sizeof(insitu_header)) {
+            break;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        usleep(100000);
+    }
+    size=st.st_size;
+    insitu_header* h=(insitu_header*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (h == MAP_FAILED) {
+        cerr<<"ERROR! Cannot map the shared memory segment "<<segment<<": "<<strerror(errno)<<". Aborting.."<<endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    while (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != INSITU_MAGIC) {
+        usleep(10000);
+    }
+    return h;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   The main function of the in-situ analysis.
+ ********************************************************************************************************************************************
+ */
+int main(int argc, char *argv[]) {
+    MPI_Init(NULL, NULL);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    fastsf_options options;
+    fastsf_default_options(&options);
+    options.q1=2;
+    options.q2=2;
+    options.longitudinal=1;
+    options.px=(argc>1) ? atoi(argv[1]) : 1;
+    string segment=(argc>2) ? argv[2] : INSITU_SEGMENT;
+
+    size_t size;
+    insitu_header* h=attach(segment, size);
+    int extents[3]={h->Nx, h->Ny, h->Nz};
+    for (int a=0; a<3; a++) {
+        options.L[a]=h->L[a];
+    }
+    const double* fields[3]={insitu_field(h, 0), insitu_field(h, 1), insitu_field(h, 2)};
+
+    vector<double> S;
+    ofstream table;
+    if (rank==0) {
+        S.resize(fastsf_result_size(3, extents, &options));
+        mkdir("out", 0777);
+        table.open("out/insitu_S2.txt");
+        cout<<"Analysis: attached to "<<segment<<" ("<<h->Nx<<"x"<<h->Ny<<"x"<<h->Nz<<" grid)"<<endl;
+    }
+
+    while (true) {
+        //Rank 0 waits for the next snapshot and tells the others
+        int step=0;
+        if (rank==0) {
+            while (sem_wait(&h->ready) != 0);
+            step=h->step;
+        }
+        MPI_Bcast(&step, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (step < 0) {
+            break;
+        }
+
+        double t0=MPI_Wtime();
+        int status=fastsf_compute(fields, 3, 3, extents, MPI_COMM_WORLD, &options, S.data(), NULL, NULL);
+        if (status != FASTSF_SUCCESS) {
+            if (rank==0) {
+                cout<<"ERROR! "<<fastsf_error_string(status)<<"! Aborting.."<<endl;
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+
+        //All the processes have finished reading the fields once rank 0 has the results
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (rank==0) {
+            double time=h->time;
+            sem_post(&h->free);
+            //S is C-ordered as (lx, ly, lz, q) with a single order
+            long stride=long(h->Ny/2)*(h->Nz/2);
+            table<<step<<" "<<time;
+            for (int lx=1; lx<h->Nx/2; lx++) {
+                table<<" "<<S[lx*stride];
+            }
+            table<<endl;
+            cout<<"Analysis: structure functions of step "<<step<<" computed in "<<MPI_Wtime()-t0<<" s, S_2(dx) = "<<S[stride]<<endl;
+        }
+    }
+
+    //Let the simulation remove the segment
+    if (rank==0) {
+        sem_post(&h->free);
+        cout<<"Analysis ends. S_2 along x written to out/insitu_S2.txt"<<endl;
+    }
+    munmap(h, size);
+    MPI_Finalize();
+    return 0;
+}
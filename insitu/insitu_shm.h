@@ -0,0 +1,101 @@
+/********************************************************************************************************************************************
+ * fastSF
+ *
+ * Copyright (C) 2020, Mahendra K. Verma
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     1. Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *     2. Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *     3. Neither the name of the copyright holder nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ********************************************************************************************************************************************
+ */
+
+/*! \file insitu_shm.h
+ *
+ *  \brief Layout of the POSIX shared memory segment through which the in-situ demo passes the velocity field from the simulation to
+ *         the analysis.
+ *
+ *  The segment starts with an insitu_header, followed by the three components u_x, u_y, u_z of the velocity field, each a C-ordered
+ *  array of Nx*Ny*Nz doubles. The simulation posts "ready" when a snapshot has been copied into the segment, and the analysis posts
+ *  "free" when it has finished reading it.
+ *
+ *  \author Shubhadeep Sadhukhan, Shashwat Bhattacharya, Mahendra K. Verma
+ *  \date Feb 2020
+ *  \copyright New BSD License
+ *
+ ********************************************************************************************************************************************
+ */
+
+#ifndef INSITU_SHM_H
+#define INSITU_SHM_H
+
+#include <semaphore.h>
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Default name of the shared memory segment.
+ ********************************************************************************************************************************************
+ */
+#define INSITU_SEGMENT "/fastsf_insitu"
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Value written to insitu_header::magic once the header is initialized.
+ ********************************************************************************************************************************************
+ */
+#define INSITU_MAGIC 0x66535346
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Header of the shared memory segment.
+ ********************************************************************************************************************************************
+ */
+struct insitu_header {
+    sem_t ready;    //!< Posted by the simulation when a snapshot (or the end of the run) is available.
+    sem_t free;     //!< Posted by the analysis when the segment can be overwritten.
+    int Nx, Ny, Nz; //!< Extents of the fields.
+    double L[3];    //!< Lengths of the domain.
+    int step;       //!< Time step of the snapshot, or -1 at the end of the run.
+    double time;    //!< Time of the snapshot.
+    int magic;      //!< INSITU_MAGIC once the semaphores and the extents are set.
+};
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the size in bytes of the segment for Nx*Ny*Nz points.
+ ********************************************************************************************************************************************
+ */
+inline size_t insitu_size(int Nx, int Ny, int Nz) {
+    return sizeof(insitu_header) + 3*sizeof(double)*size_t(Nx)*Ny*Nz;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the pointer to the component c (0, 1, 2 for u_x, u_y, u_z) of the velocity field in the segment.
+ ********************************************************************************************************************************************
+ */
+inline double* insitu_field(insitu_header* h, int c) {
+    return (double*) (h+1) + c*size_t(h->Nx)*h->Ny*h->Nz;
+}
+
+#endif
@@ -0,0 +1,159 @@
+/********************************************************************************************************************************************
+ * fastSF
+ *
+ * Copyright (C) 2020, Mahendra K. Verma
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     1. Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *     2. Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *     3. Neither the name of the copyright holder nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ********************************************************************************************************************************************
+ */
+
+/*! \file simulation.cc
+ *
+ *  \brief Stand-in simulation of the in-situ demo, publishing its velocity field in POSIX shared memory every few time steps.
+ *
+ *  The "simulation" evolves a decaying Taylor-Green vortex with a travelling small-scale mode on a periodic grid of N^3 points. Every
+ *  "every" steps it waits until the analysis has released the shared memory segment, copies the velocity field into it, and signals
+ *  the analysis, which computes the structure functions while the simulation continues.
+ *
+ *  Usage: simulation.out [N] [steps] [every] [segment]
+ *
+ *  \author Shubhadeep Sadhukhan, Shashwat Bhattacharya, Mahendra K. Verma
+ *  \date Feb 2020
+ *  \copyright New BSD License
+ *
+ ********************************************************************************************************************************************
+ */
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "insitu_shm.h"
+using namespace std;
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to evaluate the velocity field at time t.
+ *
+ * \param   u is the velocity field, three C-ordered arrays of N^3 doubles.
+ * \param   N is the number of grid points per direction.
+ * \param   t is the time.
+ ********************************************************************************************************************************************
+ */
+void velocity(vector<double>& u, int N, double t) {
+    const double nu=0.05, k=4;
+    double d=2*M_PI/N;
+    double a1=exp(-3*nu*t), a2=0.2*exp(-2*k*k*nu*t);
+    long n=long(N)*N*N;
+    #pragma omp parallel for
+    for (int i=0; i<N; i++) {
+        for (int j=0; j<N; j++) {
+            for (int l=0; l<N; l++) {
+                double x=i*d, y=j*d, z=l*d;
+                long m=(long(i)*N+j)*N+l;
+                u[m]=a1*sin(x)*cos(y)*cos(z)+a2*sin(k*(y+z)-t);
+                u[n+m]=-a1*cos(x)*sin(y)*cos(z)+a2*sin(k*(z+x)-t);
+                u[2*n+m]=a2*sin(k*(x+y)-t);
+            }
+        }
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   The main function of the stand-in simulation.
+ ********************************************************************************************************************************************
+ */
+int main(int argc, char *argv[]) {
+    int N=(argc>1) ? atoi(argv[1]) : 32;
+    int steps=(argc>2) ? atoi(argv[2]) : 100;
+    int every=(argc>3) ? atoi(argv[3]) : 10;
+    string segment=(argc>4) ? argv[4] : INSITU_SEGMENT;
+    const double dt=0.05;
+
+    if (N < 2 or steps < 1 or every < 1) {
+        cout<<"ERROR! Usage: simulation.out [N] [steps] [every] [segment] with N > 1, steps > 0, every > 0! Aborting.."<<endl;
+        exit(1);
+    }
+
+    //Create the segment; the header is published last through the magic number
+    size_t size=insitu_size(N, N, N);
+    shm_unlink(segment.c_str());
+    int fd=shm_open(segment.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 or ftruncate(fd, size) != 0) {
+        cout<<"ERROR! Cannot create the shared memory segment "<<segment<<": "<<strerror(errno)<<". Aborting.."<<endl;
+        exit(1);
+    }
+    insitu_header* h=(insitu_header*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (h == MAP_FAILED) {
+        cout<<"ERROR! Cannot map the shared memory segment "<<segment<<": "<<strerror(errno)<<". Aborting.."<<endl;
+        shm_unlink(segment.c_str());
+        exit(1);
+    }
+    sem_init(&h->ready, 1, 0);
+    sem_init(&h->free, 1, 1);
+    h->Nx=h->Ny=h->Nz=N;
+    h->L[0]=h->L[1]=h->L[2]=2*M_PI*(N-1)/N;
+    h->step=0;
+    __atomic_store_n(&h->magic, INSITU_MAGIC, __ATOMIC_RELEASE);
+    cout<<"Simulation: "<<N<<"^3 grid, "<<steps<<" steps, snapshot every "<<every<<" steps in "<<segment<<endl;
+
+    vector<double> u(3*size_t(N)*N*N);
+    for (int step=1; step<=steps; step++) {
+        velocity(u, N, step*dt);
+
+        if (step%every == 0) {
+            //Wait for the analysis to release the previous snapshot
+            while (sem_wait(&h->free) != 0);
+            memcpy(insitu_field(h, 0), u.data(), u.size()*sizeof(double));
+            h->step=step;
+            h->time=step*dt;
+            sem_post(&h->ready);
+            cout<<"Simulation: snapshot of step "<<step<<" published"<<endl;
+        }
+    }
+
+    //Signal the end of the run and wait for the analysis to finish before removing the segment
+    while (sem_wait(&h->free) != 0);
+    h->step=-1;
+    sem_post(&h->ready);
+    while (sem_wait(&h->free) != 0);
+
+    sem_destroy(&h->ready);
+    sem_destroy(&h->free);
+    munmap(h, size);
+    shm_unlink(segment.c_str());
+    cout<<"Simulation ends."<<endl;
+    return 0;
+}
@@ -56,6 +56,10 @@ cd ..
 cd test_velocity_3D
 mpirun -np 1 ../../src/fastSF.out
 cd ../
+python test_modes.py
+if [ -f test_library.out ]; then
+    mpirun -np 2 ./test_library.out
+fi
 python test.py
 
 
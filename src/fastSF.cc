@@ -47,19 +47,39 @@
 #include <fstream>
 #include <hdf5.h>
 #include <sstream>
+#include <vector>
+#include <queue>
+#include <algorithm>
 #include <blitz/array.h>
 #include <omp.h>
 #include <mpi.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 #include <limits.h>
 #include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
 using namespace std;
 using namespace blitz;
 
 //Function declarations
 void get_Inputs(); 
-void write_3D(Array<double,3>, string, int);
-void write_4D(Array<double,4>, string, int);
+void reset_parameters();
+void write_3D(Array<double,3>, string, int, bool=false);
+void write_4D(Array<double,4>, string, int, bool=false);
+void write_2D(Array<double,2>, string, bool=false);
+void write_1D(Array<double,1>, string, bool=false);
+void write_dataset(const double*, string, int, const hsize_t*, bool);
+void write_grid(Array<double,4>, string, int, bool=false);
+void write_grid(Array<double,3>, string, int, bool=false);
+void write_blocks(Array<double,4>, string, int, bool=false);
+void write_blocks(Array<double,3>, string, int, bool=false);
 void read_2D(Array<double,2>, string, string);
 string int_to_str(int);
 void VECTOR_TEST_CASE_3D();
@@ -67,20 +87,26 @@ void VECTOR_TEST_CASE_2D();
 void SCALAR_TEST_CASE_2D();
 void SCALAR_TEST_CASE_3D();
 void compute_time_elapsed(timeval, timeval, double&);
+template <class T> void get_optional(const YAML::Node&, string, string, T&);
+void perf_open();
+void perf_start();
+void perf_stop();
+void perf_report(double);
+double flops_per_pair();
 
 void read_3D(Array<double,3>, string, string);
 
 
-void SFunc2D(Array<double,2>, Array<double,2>);
+void SFunc2D(Array<double,2>, Array<double,2>, Array<double,2>, Array<double,2>);
 
 
-void SFunc_long_2D(Array<double,2>, Array<double,2>);
+void SFunc_long_2D(Array<double,2>, Array<double,2>, Array<double,2>, Array<double,2>);
 
 
-void SFunc3D(Array<double,3>, Array<double,3>, Array<double,3>);
+void SFunc3D(Array<double,3>, Array<double,3>, Array<double,3>, Array<double,3>, Array<double,3>, Array<double,3>);
 
 
-void SFunc_long_3D(Array<double,3>, Array<double,3>, Array<double,3>);
+void SFunc_long_3D(Array<double,3>, Array<double,3>, Array<double,3>, Array<double,3>, Array<double,3>, Array<double,3>);
 
 void Read_Init(Array<double,2>&, Array<double,2>&);
 void Read_Init(Array<double,3>&, Array<double,3>&, Array<double,3>&);
@@ -89,16 +115,66 @@ void Read_Init(Array<double,3>&);
 
 
 
-void SF_scalar_3D(Array<double,3>);
+void SF_scalar_3D(vector<Array<double,3> >, vector<Array<double,3> >);
 
 
-void SF_scalar_2D(Array<double,2>);
+void SF_scalar_2D(vector<Array<double,2> >, vector<Array<double,2> >);
 
 void Read_fields();
+void read_mask();
 void resize_SFs();
 void calc_SFs();
+vector<Array<double,3>*> fields_3D();
+vector<Array<double,2>*> fields_2D();
+void SF_out_of_core_3D();
+hid_t open_field(string, string, hid_t&);
+void read_plane(hid_t, int, double*);
+void bin_cylindrical(Array<int,1>, Array<int,1>, Array<int,1>, Array<double,4>, Array<double,4>, Array<double,3>);
+void bin_cylindrical(Array<int,1>, Array<int,1>, Array<int,1>, Array<double,3>, Array<double,3>, Array<double,3>);
+void count_cylindrical(Array<int,1>, Array<int,1>, Array<int,1>, Array<double,4>);
+void count_cylindrical(Array<int,1>, Array<int,1>, Array<int,1>, Array<double,3>);
+void setup_cylindrical();
+void setup_axes();
+void SF_axes();
+int axes_lags(int);
+string axes_name(int);
+void reduce_cylindrical(Array<double,3>);
+void clear_binned();
+void reduce_binned();
+void setup_harmonics();
+void project_harmonics(Array<int,1>, Array<int,1>, Array<int,1>, Array<double,4>, Array<double,3>);
+void reduce_harmonics(Array<double,3>);
+void open_cache();
+void close_cache();
+int lag_signs();
+inline int computed_slot(int, int, int);
+int lag_level(int, int, int);
+void write_shard();
+void setup_numa();
+void first_touch(double*, long);
+void replicate_fields();
+const double* numa_local(const double*);
+Array<double,3> numa_local(Array<double,3>);
+Array<double,2> numa_local(Array<double,2>);
+void allocate_field(Array<double,3>&, int, int, int);
+void allocate_field(Array<double,2>&, int, int);
+void free_shared_fields();
+void SF_ensemble();
+void write_ensemble_errors();
+void SF_space_time();
+void write_space_time();
+void read_plane_fields();
+void SF_planes();
+void write_planes(Array<double,4>, string, int);
+int tensor_count();
+string tensor_name(int);
+int particle_columns();
+void read_particles();
+void SF_particles();
 void write_SFs();
+void write_coverage();
 void test_cases();
+string scalar_suffix(int);
 
 
 
@@ -151,6 +227,25 @@ Array<double,2> V1_2D;
  */
 Array<double,2> V3_2D;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Names of the datasets (and files) of the scalar fields, "T.Fr" by default, and number of scalar fields.
+ *
+ *          The structure functions of all the scalar fields are computed in one traversal of the displacement vectors, and stored one
+ *          field after the other along the last dimension of the arrays of the scalar structure functions.
+ ********************************************************************************************************************************************
+ */
+vector<string> scalar_names;
+int scalar_count=1;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Arrays storing the scalar fields after the first one, which is stored in T or T_2D (3D and 2D fields).
+ ********************************************************************************************************************************************
+ */
+vector<Array<double,3> > T_more;
+vector<Array<double,2> > T_more_2D;
+
 
 /**
  ********************************************************************************************************************************************
@@ -322,6 +417,14 @@ double dz;
  */
 int rank_mpi;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Communicator of the MPI processes computing the structure functions (MPI_COMM_WORLD unless set by the library).
+ *
+ ********************************************************************************************************************************************
+ */
+MPI_Comm comm_SF;
+
 /**
  ********************************************************************************************************************************************
  * \brief   This variable stores the length of the domain.
@@ -362,1503 +465,7400 @@ int P;
  */
 int px;
 
-
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable stores the number of the MPI process along y axis (1 for 2D fields).
+ *
+ ********************************************************************************************************************************************
+ */
+int py;
 
 /**
  ********************************************************************************************************************************************
- * \brief   The main function of the "fastSF".
- 
+ * \brief   This variable stores the number of the MPI process along z axis.
+ *
  ********************************************************************************************************************************************
  */
-int main(int argc, char *argv[]) {
-    MPI_Init(NULL, NULL);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank_mpi);
-    MPI_Comm_size(MPI_COMM_WORLD, &P);
+int pz;
 
-    //set the number of processors in x direction
-    if (argc>1) {
-        px = std::atoi(argv[1]);
-    }
-    else {
-        px = 1;
-    }
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the hardware performance counters are sampled during the computation of the structure functions.
+ *
+ * If the value is "true", the Linux perf_event_open counters are enabled around calc_SFs() on every rank and the derived metrics are
+ * printed at the end of the run.
+ ********************************************************************************************************************************************
+ */
+bool perf_switch;
 
-    //Initiallizing h5si
-    h5::init();
-    timeval start_pt, end_pt, start_t, end_t;
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the 3D input fields are streamed from the disk plane by plane instead of being read in memory.
+ *
+ ********************************************************************************************************************************************
+ */
+bool ooc_switch;
 
-    //Record the time of starting of the program
-    gettimeofday(&start_t,NULL);
+/**
+ ********************************************************************************************************************************************
+ * \brief   Memory (in MB) per MPI process available for the planes of the input fields in the out-of-core mode.
+ *
+ ********************************************************************************************************************************************
+ */
+double memory_budget;
 
-    double elapsedt=0.0;
-    double elapsepdt=0.0;
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the structure functions are also binned as function of the displacements perpendicular and
+ *          parallel to an anisotropy axis.
+ *
+ ********************************************************************************************************************************************
+ */
+bool cyl_switch;
 
-    get_Inputs();
+/**
+ ********************************************************************************************************************************************
+ * \brief   The anisotropy axis of the cylindrical binning (0, 1, and 2 for the \f$ x \f$, \f$ y \f$, and \f$ z \f$ axes).
+ *
+ ********************************************************************************************************************************************
+ */
+int cyl_axis;
 
-    //Resizing the input fields
-    Read_fields();
+/**
+ ********************************************************************************************************************************************
+ * \brief   Width of the \f$ l_\perp \f$ bins, taken as the smallest grid spacing perpendicular to the anisotropy axis.
+ *
+ ********************************************************************************************************************************************
+ */
+double cyl_width;
 
-    //Resize the structure function array according to the type of inputs
-    resize_SFs();
+/**
+ ********************************************************************************************************************************************
+ * \brief   3D arrays storing the binned longitudinal, transverse, and scalar structure functions.
+ *
+ *          The arrays are indexed as \f$ (l_\perp, l_\parallel, q) \f$. Every processor accumulates the structure functions of its
+ *          displacement vectors weighted by their number of pairs; the sums are reduced and normalized at rank 0.
+ ********************************************************************************************************************************************
+ */
+Array<double,3> SF_cyl_pll, SF_cyl_perp, SF_cyl_scalar;
 
-    
-    //Record the time of starting the parallel processing
-    gettimeofday(&start_pt,NULL);
+/**
+ ********************************************************************************************************************************************
+ * \brief   2D array storing the number of pairs of points of every \f$ (l_\perp, l_\parallel) \f$ bin (at rank 0 only).
+ *
+ ********************************************************************************************************************************************
+ */
+Array<double,2> SF_cyl_count;
 
-    //Calculating the structure functions
-    calc_SFs();
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the structure functions are also projected onto the spherical harmonics of the direction of the
+ *          displacement vector, up to the degree harm_degree, in shells of \f$ |\mathbf{l}| \f$.
+ ********************************************************************************************************************************************
+ */
+bool harmonic_switch;
+int harm_degree;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Width of the shells of \f$ |\mathbf{l}| \f$, taken as the smallest grid spacing.
+ ********************************************************************************************************************************************
+ */
+double harm_width;
 
-    //Record the time of ending of parallel processing
-    gettimeofday(&end_pt,NULL);
-    
- 
-    //Write the SF array to disk
-    write_SFs();
+/**
+ ********************************************************************************************************************************************
+ * \brief   3D arrays storing the projections of the longitudinal, transverse, and scalar structure functions onto the spherical harmonics.
+ *
+ *          The arrays are indexed as \f$ (r, l^2+l+m, q) \f$ for the shell \f$ r \f$ and the real spherical harmonic \f$ Y_l^m \f$. Every
+ *          processor accumulates the projections of its displacement vectors; the sums are reduced and normalized at rank 0.
+ ********************************************************************************************************************************************
+ */
+Array<double,3> SF_harm_pll, SF_harm_perp, SF_harm_scalar;
 
-    if (test_switch){
-        test_cases();
-    }
+/**
+ ********************************************************************************************************************************************
+ * \brief   Number of displacement vectors of the whole sphere of directions in every shell (at rank 0 only).
+ ********************************************************************************************************************************************
+ */
+Array<double,1> SF_harm_count;
 
-    //Record the time when the program ends
-    gettimeofday(&end_t,NULL);
-    
-    compute_time_elapsed(start_t, end_t, elapsedt);
-    compute_time_elapsed(start_pt, end_pt, elapsepdt);
-    
-    
-    if (rank_mpi==0) {
-        cout<<"\nTime elapsed for the parallel part: "<<elapsepdt<<endl;
-        cout<<"\nTotal time elapsed: "<<elapsedt<<endl;
-        cout<<"\nProgram ends."<<endl;
-   }
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the structure functions of every order are stored in, and served from, a persistent cache.
+ ********************************************************************************************************************************************
+ */
+bool cache_switch;
 
-    h5::finalize();
-    MPI_Finalize();
-    return 0;
-}
+/**
+ ********************************************************************************************************************************************
+ * \brief   Name of the hdf5 file of the cache, and name of the group of the current inputs and parameters (see cache_group()).
+ ********************************************************************************************************************************************
+ */
+string cache_file;
+string cache_key;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Identities of the input files hashed by this run (see file_hash()), with the hashes of their contents, to be stored in the
+ *          cache by close_cache().
+ ********************************************************************************************************************************************
+ */
+vector<pair<string, unsigned long long> > cache_hashes;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Orders requested by the parameters file (the global q1 and q2 hold the orders computed in the run), and whether all of them
+ *          are found in the cache.
+ ********************************************************************************************************************************************
+ */
+int cache_q1, cache_q2;
+bool cache_hit;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the structure functions are computed only for the displacements along the coordinate axes.
+ *
+ ********************************************************************************************************************************************
+ */
+bool axes_switch;
 
 /**
-*************************************************************************************************************************************
-*\brief     Function to generate or read the input fields.
-*           
-*************************************************************************************************************************************
-*/
-void Read_fields() {
-    if(two_dimension_switch){
-        if (scalar_switch) {
-            T_2D.resize(Nx, Nz);
-        }
-        else {
-            V1_2D.resize(Nx, Nz);
-            V3_2D.resize(Nx, Nz);
-        }
-        
-    }
-    else{
-        if (scalar_switch) {
-            T.resize(Nx, Ny, Nz);
-        }
-        else {
-            V1.resize(Nx,Ny,Nz);
-            V2.resize(Nx,Ny,Nz);
-            V3.resize(Nx,Ny,Nz);
-        }
-        
-    }
-    //Defining the input fields
-    if (test_switch){
-        if (rank_mpi==0){
-            cout<<"\nWARNING: The code is running in TEST mode. It will generate velocity / scalar fields and will take them as inputs.\n";
-        }
-        if (two_dimension_switch) {
-            if (scalar_switch) {
-                Read_Init(T_2D);
-            }
-            else {
-                Read_Init(V1_2D, V3_2D);
-            }
-        }
-        else {
-            if (scalar_switch) {
-                Read_Init(T);
-            }
-            else {
-                Read_Init(V1, V2, V3);
-            }
-        }
-    } 
-    else {
-        if (rank_mpi==0){
-            cout<<"Reading from the hdf5 files\n";
-        }
-        if (two_dimension_switch){
-            if (scalar_switch) {
-                read_2D(T_2D,"in/", "T.Fr");
-            }
-            else {
-                read_2D(V1_2D,"in/","U.V1r");
-                read_2D(V3_2D,"in/","U.V3r");
-            }
-        }
-        else{
-            if (scalar_switch) {
-                read_3D(T, "in/","T.Fr");
-            }
-            else {
-                read_3D(V1, "in/", "U.V1r");
-                read_3D(V2, "in/", "U.V2r");
-                read_3D(V3, "in/", "U.V3r");
-            }
-        }
-    }
-}
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the diagonal directions are added to the coordinate axes in the axes only mode.
+ *
+ ********************************************************************************************************************************************
+ */
+bool diagonals;
 
 /**
-*************************************************************************************************************************************
-*\brief     Function resize the structure function arrays according to the inputs.
-*  
-*************************************************************************************************************************************
-*/
-void resize_SFs(){
-    if (rank_mpi==0) {
-        if (not two_dimension_switch) {
-            if (scalar_switch) {
-                SF_Grid_scalar.resize(Nx/2, Ny/2, Nz/2, q2-q1+1);
-                SF_Grid_scalar = 0; 
-            }
-            else {
-                SF_Grid_pll.resize(Nx/2, Ny/2, Nz/2, q2-q1+1);
-                SF_Grid_pll = 0;
-                if (not longitudinal) {
-                    SF_Grid_perp.resize(Nx/2, Ny/2, Nz/2, q2-q1+1);
-                    SF_Grid_perp = 0;
-                }
-            }
-            
-        }
-        else {
-            if (scalar_switch) {
-                SF_Grid2D_scalar.resize(Nx/2, Nz/2, q2-q1+1);
-                SF_Grid2D_scalar = 0; 
-            }
-            else {
-                SF_Grid2D_pll.resize(Nx/2, Nz/2, q2-q1+1);
-                SF_Grid2D_pll = 0; 
-                if (not longitudinal) {
-                    SF_Grid2D_perp.resize(Nx/2, Nz/2, q2-q1+1);
-                    SF_Grid2D_perp = 0;
-                }
-            }
-        }   
-    }
-}
+ ********************************************************************************************************************************************
+ * \brief   2D array storing the directions of the axes only mode, one per row, as the components \f$ (n_x, n_y, n_z) \f$ (0 or 1) of the
+ *          displacement vector of one grid step.
+ ********************************************************************************************************************************************
+ */
+Array<int,2> axes_dirs;
 
 /**
-*************************************************************************************************************************************
-*\brief     Function to compute the structure functions based on the inputs provided by the user.
+ ********************************************************************************************************************************************
+ * \brief   3D arrays storing the longitudinal, transverse, and scalar structure functions of the axes only mode (at rank 0 only).
+ *
+ *          The arrays are indexed as (direction, \f$ m \f$, \f$ q \f$), where the displacement vector is \f$ m \f$ grid steps along the
+ *          direction.
+ ********************************************************************************************************************************************
+ */
+Array<double,3> SF_axes_pll, SF_axes_perp, SF_axes_scalar;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether only the pairs of points lying inside a mask are taken into account.
+ *
+ ********************************************************************************************************************************************
+ */
+bool mask_switch;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides how the mask is defined: 0 for the nonzero points of in/mask.h5, 1 (2) for the points where the scalar
+ *          field of in/T.Fr.h5 is above (below) mask_threshold.
+ ********************************************************************************************************************************************
+ */
+int mask_condition;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   The threshold on the scalar field for the conditional structure functions.
+ *
+ ********************************************************************************************************************************************
+ */
+double mask_threshold;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Runs of consecutive points inside the mask along \f$ z \f$, stored as pairs (first index, last index + 1).
+ *
+ ********************************************************************************************************************************************
+ */
+vector<int> mask_runs;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Offsets in mask_runs of the runs of every row along \f$ z \f$; the row \f$ (x, y) \f$ has the index \f$ x N_y + y \f$
+ *          (\f$ x \f$ for 2D fields).
+ ********************************************************************************************************************************************
+ */
+vector<long> mask_rows;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Arrays storing the number of pairs of points inside the mask as function of the displacement vector (3D and 2D fields).
+ *
+ ********************************************************************************************************************************************
+ */
+Array<double,4> SF_Grid_count;
+Array<double,3> SF_Grid2D_count;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the structure functions are computed for the signed displacement vectors
+ *          \f$ (l_x, \pm l_y, \pm l_z) \f$ (\f$ (l_x, \pm l_z) \f$ for 2D fields), which cover the half-space \f$ l_x \geq 0 \f$.
+ *
+ *          The structure function arrays then store the sign variants of every displacement vector along their last dimension (see
+ *          lag_signs()).
+ ********************************************************************************************************************************************
+ */
+bool signed_switch;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Level (1 to 9) of the gzip compression of the output files, applied after the shuffle filter to chunked datasets; 0 writes
+ *          uncompressed contiguous datasets.
+ ********************************************************************************************************************************************
+ */
+int compression;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the structure functions are stored in single precision (the pair counts are always stored
+ *          in double precision).
+ ********************************************************************************************************************************************
+ */
+bool single_precision;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Folder of the input fields, "in/" except in the ensemble and space-time modes, where it is the folder of the current snapshot.
+ ********************************************************************************************************************************************
+ */
+string in_folder="in/";
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the structure functions are averaged over an ensemble of snapshots.
+ ********************************************************************************************************************************************
+ */
+bool ensemble_switch;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Folders of the input fields of the snapshots of the ensemble.
+ ********************************************************************************************************************************************
+ */
+vector<string> snapshots;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Name of the hdf5 file storing the running sums of the ensemble, from which an interrupted job resumes.
+ ********************************************************************************************************************************************
+ */
+string ensemble_file;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Number of snapshots accumulated, their indices in the order of accumulation, and the running means and sums of squared
+ *          deviations (Welford's algorithm) of every array listed by ensemble_arrays().
+ ********************************************************************************************************************************************
+ */
+long ensemble_n;
+vector<int> ensemble_log;
+vector<vector<double> > ensemble_mean, ensemble_M2;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether only a shard of the displacement vectors is computed, and stored as raw sums and pair counts
+ *          that merge_shards.py combines with the other shards.
+ ********************************************************************************************************************************************
+ */
+bool shard_switch;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Index (from 0) of the shard computed by this run and number of shards; the \f$ l_x \f$ displacements are dealt to the
+ *          \f$ p_x \times \f$ shard_count processors of all the shards by their cost.
+ ********************************************************************************************************************************************
+ */
+int shard_index=0, shard_count=1;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Pinning of the MPI processes and of their OpenMP threads to the cores: 0 none, 1 compact (consecutive cores), 2 spread
+ *          (cores taken from the NUMA nodes in turn).
+ ********************************************************************************************************************************************
+ */
+int numa_pinning;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Placement of the input fields in memory: 0 where the reading thread touches them first, 1 interleaved page by page among
+ *          the threads (and hence the NUMA nodes), 2 one replica per NUMA node.
+ ********************************************************************************************************************************************
+ */
+int numa_placement;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   NUMA node of every OpenMP thread, recorded by setup_numa(), and number of NUMA nodes of the machine.
+ ********************************************************************************************************************************************
+ */
+vector<int> thread_node;
+int numa_nodes=1;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Structure storing the replicas of an input field on the NUMA nodes.
+ ********************************************************************************************************************************************
+ */
+struct field_replicas {
+    const double* field;        //!< Data of the input field.
+    vector<double*> copies;     //!< Copy of the field on every NUMA node (NULL for the nodes without threads).
+};
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Replicas of the input fields with numa_placement 2.
+ ********************************************************************************************************************************************
+ */
+vector<field_replicas> replicas;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the input fields are stored once per node in MPI shared memory windows, read by one process
+ *          of the node and viewed by the others.
+ ********************************************************************************************************************************************
+ */
+bool shared_switch;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Communicator of the processes of this node, rank of this process in it, and shared memory windows of the input fields.
+ ********************************************************************************************************************************************
+ */
+MPI_Comm node_comm=MPI_COMM_NULL;
+int node_rank;
+vector<MPI_Win> field_windows;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the structure functions are also computed per sub-block of the domain, the pair
+ *          \f$ (\mathbf{x}, \mathbf{x}+\mathbf{l}) \f$ being counted in the sub-block containing its base point \f$ \mathbf{x} \f$.
+ ********************************************************************************************************************************************
+ */
+bool block_switch;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Sizes of the sub-blocks along \f$ x, y, z \f$ in grid points, and numbers of sub-blocks along \f$ x, y, z \f$ (the last
+ *          sub-block of a direction may be smaller).
+ ********************************************************************************************************************************************
+ */
+int block_size[3]={1,1,1}, block_count[3]={1,1,1};
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Arrays storing, for every displacement vector, the records of the sub-blocks (see block_record()) (3D and 2D fields).
+ ********************************************************************************************************************************************
+ */
+Array<double,4> SF_Grid_blocks;
+Array<double,3> SF_Grid2D_blocks;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the number of sub-blocks with block_switch, and 1 otherwise.
+ ********************************************************************************************************************************************
+ */
+inline int block_number() {
+    return block_switch ? block_count[0]*block_count[1]*block_count[2] : 1;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the length of the record of a sub-block: the sums of the longitudinal and transverse structure functions,
+ *          or of the structure functions of every scalar field, and the number of pairs of points, \f$ 2(q_2-q_1+1)+1 \f$ elements
+ *          (\f$ n_f(q_2-q_1+1)+1 \f$ for \f$ n_f \f$ scalar fields).
+ *
+ *          After finish_variants(), the sums are normalized by the number of pairs of the sub-block.
+ ********************************************************************************************************************************************
+ */
+inline int block_record() {
+    return (scalar_switch ? scalar_count : 2)*(q2-q1+1)+1;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the displacement vectors are computed from coarse to fine lattices (see lag_level()), with the
+ *          structure functions computed so far written after the lattices.
+ ********************************************************************************************************************************************
+ */
+bool progress_switch;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Minimum time in seconds between two intermediate outputs of the progressive mode, and time of the last output (rank 0).
+ ********************************************************************************************************************************************
+ */
+double progress_interval, progress_time;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Level of the finest lattice of displacement vectors completed in the progressive mode.
+ ********************************************************************************************************************************************
+ */
+int progress_level;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the space-time structure functions \f$ S(\mathbf{l}, \tau) \f$ are computed over a sliding window
+ *          of snapshots.
+ ********************************************************************************************************************************************
+ */
+bool time_switch;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Folders of the input fields of the snapshots of the space-time structure functions, in the order of time.
+ ********************************************************************************************************************************************
+ */
+vector<string> time_snapshots;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Number of snapshots kept in memory, which computes the time lags \f$ |\tau| \f$ from 0 to time_window - 1 snapshots.
+ ********************************************************************************************************************************************
+ */
+int time_window;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Time lag (in snapshots) of the pairs of points being computed, from the first point to the second one; 0 within a snapshot.
+ ********************************************************************************************************************************************
+ */
+int time_lag;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Sums over the time origins of every array listed by ensemble_arrays(), one block of the size of the array per time lag from
+ *          \f$ 1 - \f$ time_window to time_window \f$ - 1 \f$ (rank 0).
+ ********************************************************************************************************************************************
+ */
+vector<vector<double> > time_sums;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Input fields of a snapshot kept in the window of the space-time structure functions, in the order of fields_3D() and
+ *          fields_2D().
+ ********************************************************************************************************************************************
+ */
+struct snapshot_fields {
+    vector<Array<double,3> > F;
+    vector<Array<double,2> > F_2D;
+};
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the 2D structure functions of the horizontal planes \f$ (x, y) \f$ of 3D fields are computed, one
+ *          plane after another.
+ ********************************************************************************************************************************************
+ */
+bool plane_switch;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Indices along \f$ z \f$ of the planes computed, and grid of the 3D fields.
+ *
+ *          In the planes mode, get_Inputs() sets the globals of the grid to the 2D grid of a plane, as for 2D fields: Nx and dx are those
+ *          of \f$ x \f$, Nz and dz those of \f$ y \f$, and Ny = 1, dy = 0. The processors are arranged accordingly: px along \f$ x \f$
+ *          and pz along \f$ y \f$ (py = 1). Only read_plane_fields() uses the 3D grid.
+ ********************************************************************************************************************************************
+ */
+vector<int> planes;
+int plane_grid[3];
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Arrays storing the structure functions \f$ (l_x, l_y, n, q) \f$ of every plane \f$ n \f$ (rank 0).
+ ********************************************************************************************************************************************
+ */
+Array<double,4> SF_planes_pll, SF_planes_perp, SF_planes_scalar;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the tensors of the velocity increments \f$ D_{ij} = \langle \delta u_i \delta u_j \rangle \f$
+ *          (and \f$ D_{ijk} \f$ if tensor_order is 3) are computed along with the structure functions.
+ ********************************************************************************************************************************************
+ */
+bool tensor_switch;
+int tensor_order;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Arrays storing the independent components of the tensors (see tensor_name()) of every slot of lag_signs().
+ ********************************************************************************************************************************************
+ */
+Array<double,4> SF_Grid_tensor;
+Array<double,3> SF_Grid2D_tensor;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the structure functions are computed from scattered particles instead of fields on the grid.
+ ********************************************************************************************************************************************
+ */
+bool particle_switch;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Name of the hdf5 file and dataset of the particles, maximum separation of the pairs of particles, and number of bins of the
+ *          separation.
+ ********************************************************************************************************************************************
+ */
+string particle_file;
+double particle_rmax;
+int particle_bins;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Positions and values of the particles, one row of particle_columns() elements per particle.
+ ********************************************************************************************************************************************
+ */
+vector<double> particle_data;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Arrays storing the structure functions \f$ (b, q) \f$ of the bins \f$ b \f$ of the separation, and the numbers of pairs of
+ *          particles of the bins (rank 0).
+ ********************************************************************************************************************************************
+ */
+Array<double,2> SF_particles_pll, SF_particles_perp, SF_particles_scalar;
+Array<double,1> SF_particles_count;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Suffix appended to the names of the output files, "_err" while the standard errors of the ensemble are written.
+ ********************************************************************************************************************************************
+ */
+string out_suffix;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Number of point pairs (summed over all displacements and orders computed together) processed by this MPI process.
+ *
+ ********************************************************************************************************************************************
+ */
+long long pair_count;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Number of hardware events sampled by the performance counters.
+ ********************************************************************************************************************************************
+ */
+const int N_PERF_EVENTS = 4;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   File descriptors of the hardware performance counters (cycles, instructions, last level cache references and misses).
+ *
+ * A value of -1 marks a counter that is not available on this machine.
+ ********************************************************************************************************************************************
+ */
+int perf_fd[N_PERF_EVENTS];
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Values of the hardware performance counters read at the end of calc_SFs(), scaled for multiplexing.
+ ********************************************************************************************************************************************
+ */
+long long perf_count[N_PERF_EVENTS];
+
+
+
+//The Python module (fastsf_module.cc) and the library (libfastsf.cc) include this file without the main function
+#ifndef FASTSF_NO_MAIN
+/**
+ ********************************************************************************************************************************************
+ * \brief   The main function of the "fastSF".
+ 
+ ********************************************************************************************************************************************
+ */
+int main(int argc, char *argv[]) {
+    MPI_Init(NULL, NULL);
+    comm_SF = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm_SF, &rank_mpi);
+    MPI_Comm_size(comm_SF, &P);
+
+    //set the number of processors in x direction
+    if (argc>1) {
+        px = std::atoi(argv[1]);
+    }
+    else {
+        px = 1;
+    }
+
+    //set the number of processors in y direction (3D only); 0 lets get_Inputs() choose it
+    if (argc>2) {
+        py = std::atoi(argv[2]);
+    }
+    else {
+        py = 0;
+    }
+
+    //Initiallizing h5si
+    h5::init();
+    timeval start_pt, end_pt, start_t, end_t;
+
+    //Record the time of starting of the program
+    gettimeofday(&start_t,NULL);
+
+    double elapsedt=0.0;
+    double elapsepdt=0.0;
+
+    get_Inputs();
+
+    //Open the hardware counters before any worker thread is created so that they are inherited
+    if (perf_switch) {
+        perf_open();
+    }
+
+    //Pin the processes and threads and report where they run
+    setup_numa();
+
+    //Look up the orders stored in the cache, which reduces the orders to compute
+    if (cache_switch) {
+        open_cache();
+    }
+
+    //Resizing the input fields (the fields of the snapshots are read by SF_ensemble() and SF_space_time())
+    if (not (ensemble_switch or time_switch or cache_hit)) {
+        Read_fields();
+    }
+
+    //Resize the structure function array according to the type of inputs
+    resize_SFs();
+
+    
+    //Record the time of starting the parallel processing
+    gettimeofday(&start_pt,NULL);
+    if (perf_switch) {
+        perf_start();
+    }
+
+    //Calculating the structure functions
+    if (ensemble_switch) {
+        SF_ensemble();
+    }
+    else if (time_switch) {
+        SF_space_time();
+    }
+    else if (plane_switch) {
+        SF_planes();
+    }
+    else if (particle_switch) {
+        SF_particles();
+    }
+    else if (not cache_hit) {
+        calc_SFs();
+    }
+
+    if (perf_switch) {
+        perf_stop();
+    }
+
+    //Record the time of ending of parallel processing
+    gettimeofday(&end_pt,NULL);
+    
+ 
+    //Merge the orders computed with those of the cache
+    if (cache_switch) {
+        close_cache();
+    }
+
+    //Write the SF array to disk
+    write_SFs();
+    if (ensemble_switch) {
+        write_ensemble_errors();
+    }
+    if (time_switch) {
+        write_space_time();
+    }
+
+    if (test_switch){
+        test_cases();
+    }
+
+    //Record the time when the program ends
+    gettimeofday(&end_t,NULL);
+    
+    compute_time_elapsed(start_t, end_t, elapsedt);
+    compute_time_elapsed(start_pt, end_pt, elapsepdt);
+    
+    
+    if (rank_mpi==0) {
+        cout<<"\nTime elapsed for the parallel part: "<<elapsepdt<<endl;
+        cout<<"\nTotal time elapsed: "<<elapsedt<<endl;
+   }
+
+    if (perf_switch) {
+        perf_report(elapsepdt);
+    }
+
+    if (rank_mpi==0) {
+        cout<<"\nProgram ends."<<endl;
+    }
+
+    free_shared_fields();
+    h5::finalize();
+    MPI_Finalize();
+    return 0;
+}
+#endif
+
+
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to generate or read the input fields.
+*           
+*************************************************************************************************************************************
+*/
+void Read_fields() {
+    if (mask_switch) {
+        read_mask();
+    }
+    if (ooc_switch) {
+        if (rank_mpi==0){
+            cout<<"Streaming the input fields from the hdf5 files with a memory budget of "<<memory_budget<<" MB per processor\n";
+        }
+        return;
+    }
+    if (plane_switch) {
+        read_plane_fields();
+        return;
+    }
+    if (particle_switch) {
+        read_particles();
+        return;
+    }
+    free_shared_fields();
+    if(two_dimension_switch){
+        if (scalar_switch) {
+            allocate_field(T_2D, Nx, Nz);
+            T_more_2D.resize(scalar_count-1);
+            for (int f=1; f<scalar_count; f++) {
+                allocate_field(T_more_2D[f-1], Nx, Nz);
+            }
+        }
+        else {
+            allocate_field(V1_2D, Nx, Nz);
+            allocate_field(V3_2D, Nx, Nz);
+        }
+        
+    }
+    else{
+        if (scalar_switch) {
+            allocate_field(T, Nx, Ny, Nz);
+            T_more.resize(scalar_count-1);
+            for (int f=1; f<scalar_count; f++) {
+                allocate_field(T_more[f-1], Nx, Ny, Nz);
+            }
+        }
+        else {
+            allocate_field(V1, Nx, Ny, Nz);
+            allocate_field(V2, Nx, Ny, Nz);
+            allocate_field(V3, Nx, Ny, Nz);
+        }
+        
+    }
+    //With the shared fields, only the first process of every node fills them
+    bool reader=(not shared_switch) or node_rank==0;
+
+    //Spread the pages of the fields over the NUMA nodes before they are filled
+    if (numa_placement==1 and reader) {
+        vector<Array<double,3>*> fields3D=fields_3D();
+        vector<Array<double,2>*> fields2D=fields_2D();
+        for (size_t f=0; f<fields3D.size(); f++) {
+            first_touch(fields3D[f]->data(), fields3D[f]->size());
+        }
+        for (size_t f=0; f<fields2D.size(); f++) {
+            first_touch(fields2D[f]->data(), fields2D[f]->size());
+        }
+    }
+
+    //Defining the input fields
+    if (not reader) {
+        //The fields are filled by the first process of the node
+    }
+    else if (test_switch){
+        if (rank_mpi==0){
+            cout<<"\nWARNING: The code is running in TEST mode. It will generate velocity / scalar fields and will take them as inputs.\n";
+        }
+        if (two_dimension_switch) {
+            if (scalar_switch) {
+                Read_Init(T_2D);
+            }
+            else {
+                Read_Init(V1_2D, V3_2D);
+            }
+        }
+        else {
+            if (scalar_switch) {
+                Read_Init(T);
+            }
+            else {
+                Read_Init(V1, V2, V3);
+            }
+        }
+    } 
+    else {
+        if (rank_mpi==0){
+            cout<<"Reading from the hdf5 files\n";
+        }
+        if (two_dimension_switch){
+            if (scalar_switch) {
+                read_2D(T_2D, in_folder, scalar_names[0]);
+                for (int f=1; f<scalar_count; f++) {
+                    read_2D(T_more_2D[f-1], in_folder, scalar_names[f]);
+                }
+            }
+            else {
+                read_2D(V1_2D, in_folder, "U.V1r");
+                read_2D(V3_2D, in_folder, "U.V3r");
+            }
+        }
+        else{
+            if (scalar_switch) {
+                read_3D(T, in_folder, scalar_names[0]);
+                for (int f=1; f<scalar_count; f++) {
+                    read_3D(T_more[f-1], in_folder, scalar_names[f]);
+                }
+            }
+            else {
+                read_3D(V1, in_folder, "U.V1r");
+                read_3D(V2, in_folder, "U.V2r");
+                read_3D(V3, in_folder, "U.V3r");
+            }
+        }
+    }
+
+    //Make the fields written by the first process of the node visible to the others
+    for (size_t w=0; w<field_windows.size(); w++) {
+        MPI_Win_fence(0, field_windows[w]);
+    }
+
+    if (numa_placement==2) {
+        replicate_fields();
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function resize the structure function arrays according to the inputs.
+*  
+*************************************************************************************************************************************
+*/
+void resize_SFs(){
+    if (axes_switch) {
+        setup_axes();
+        return;
+    }
+    if (rank_mpi==0) {
+        if (not two_dimension_switch) {
+            if (scalar_switch) {
+                SF_Grid_scalar.resize(Nx/2, Ny/2, Nz/2, scalar_count*lag_signs()*(q2-q1+1));
+                SF_Grid_scalar = 0; 
+            }
+            else {
+                SF_Grid_pll.resize(Nx/2, Ny/2, Nz/2, lag_signs()*(q2-q1+1));
+                SF_Grid_pll = 0;
+                if (not longitudinal) {
+                    SF_Grid_perp.resize(Nx/2, Ny/2, Nz/2, lag_signs()*(q2-q1+1));
+                    SF_Grid_perp = 0;
+                }
+            }
+            
+        }
+        else {
+            if (scalar_switch) {
+                SF_Grid2D_scalar.resize(Nx/2, Nz/2, scalar_count*lag_signs()*(q2-q1+1));
+                SF_Grid2D_scalar = 0; 
+            }
+            else {
+                SF_Grid2D_pll.resize(Nx/2, Nz/2, lag_signs()*(q2-q1+1));
+                SF_Grid2D_pll = 0; 
+                if (not longitudinal) {
+                    SF_Grid2D_perp.resize(Nx/2, Nz/2, lag_signs()*(q2-q1+1));
+                    SF_Grid2D_perp = 0;
+                }
+            }
+        }   
+    }
+    if (mask_switch and rank_mpi==0) {
+        if (two_dimension_switch) {
+            SF_Grid2D_count.resize(Nx/2, Nz/2, lag_signs());
+            SF_Grid2D_count = 0;
+        }
+        else {
+            SF_Grid_count.resize(Nx/2, Ny/2, Nz/2, lag_signs());
+            SF_Grid_count = 0;
+        }
+    }
+    if (block_switch and rank_mpi==0) {
+        if (two_dimension_switch) {
+            SF_Grid2D_blocks.resize(Nx/2, Nz/2, block_number()*block_record());
+            SF_Grid2D_blocks = 0;
+        }
+        else {
+            SF_Grid_blocks.resize(Nx/2, Ny/2, Nz/2, block_number()*block_record());
+            SF_Grid_blocks = 0;
+        }
+    }
+    if (particle_switch) {
+        if (rank_mpi==0) {
+            if (scalar_switch) {
+                SF_particles_scalar.resize(particle_bins, scalar_count*(q2-q1+1));
+            }
+            else {
+                SF_particles_pll.resize(particle_bins, q2-q1+1);
+                if (not longitudinal) {
+                    SF_particles_perp.resize(particle_bins, q2-q1+1);
+                }
+            }
+            SF_particles_count.resize(particle_bins);
+        }
+        return;
+    }
+    if (tensor_switch and rank_mpi==0) {
+        if (two_dimension_switch) {
+            SF_Grid2D_tensor.resize(Nx/2, Nz/2, lag_signs()*tensor_count());
+            SF_Grid2D_tensor = 0;
+        }
+        else {
+            SF_Grid_tensor.resize(Nx/2, Ny/2, Nz/2, lag_signs()*tensor_count());
+            SF_Grid_tensor = 0;
+        }
+    }
+    if (plane_switch and rank_mpi==0) {
+        int np=planes.size();
+        if (scalar_switch) {
+            SF_planes_scalar.resize(Nx/2, Nz/2, np, SF_Grid2D_scalar.extent(2));
+        }
+        else {
+            SF_planes_pll.resize(Nx/2, Nz/2, np, SF_Grid2D_pll.extent(2));
+            if (not longitudinal) {
+                SF_planes_perp.resize(Nx/2, Nz/2, np, SF_Grid2D_perp.extent(2));
+            }
+        }
+    }
+    if (cyl_switch) {
+        setup_cylindrical();
+    }
+    if (harmonic_switch) {
+        setup_harmonics();
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function returning the handles of the current input fields, in the order of fields_3D() and fields_2D().
+*************************************************************************************************************************************
+*/
+snapshot_fields current_fields() {
+    snapshot_fields fields;
+    vector<Array<double,3>*> fields3D=fields_3D();
+    vector<Array<double,2>*> fields2D=fields_2D();
+    for (size_t f=0; f<fields3D.size(); f++) {
+        fields.F.push_back(*fields3D[f]);
+    }
+    for (size_t f=0; f<fields2D.size(); f++) {
+        fields.F_2D.push_back(*fields2D[f]);
+    }
+    return fields;
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to compute the structure functions of the pairs of points whose first point is taken from the fields first and
+*           second point from the fields second (the same fields except for the space-time structure functions).
+*
+*           The scalar fields are the first entries of the lists and the velocity components the last ones.
+*************************************************************************************************************************************
+*/
+void calc_SFs(const snapshot_fields& first, const snapshot_fields& second) {
+    if (two_dimension_switch){
+        const vector<Array<double,2> >& U=first.F_2D;
+        const vector<Array<double,2> >& W=second.F_2D;
+        int v=U.size()-2;
+        if (scalar_switch) {
+            SF_scalar_2D(vector<Array<double,2> >(U.begin(), U.begin()+scalar_count),
+                         vector<Array<double,2> >(W.begin(), W.begin()+scalar_count));
+        }
+        else {
+            if (longitudinal) {
+                SFunc_long_2D(U[v], U[v+1], W[v], W[v+1]);
+            } 
+            else {
+                SFunc2D(U[v], U[v+1], W[v], W[v+1]);
+            }
+        }
+    }
+    
+    else {
+        const vector<Array<double,3> >& U=first.F;
+        const vector<Array<double,3> >& W=second.F;
+        int v=U.size()-3;
+        if (scalar_switch) {
+            SF_scalar_3D(vector<Array<double,3> >(U.begin(), U.begin()+scalar_count),
+                         vector<Array<double,3> >(W.begin(), W.begin()+scalar_count));
+        }
+        else {
+            if (longitudinal) {
+                SFunc_long_3D(U[v], U[v+1], U[v+2], W[v], W[v+1], W[v+2]);
+            }
+            else {
+                SFunc3D(U[v], U[v+1], U[v+2], W[v], W[v+1], W[v+2]);
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to compute the structure functions based on the inputs provided by the user.
+*************************************************************************************************************************************
+*/
+void calc_SFs() {
+    clear_binned();
+    if (axes_switch) {
+        SF_axes();
+    }
+    else if (ooc_switch) {
+        SF_out_of_core_3D();
+    }
+    else {
+        snapshot_fields fields=current_fields();
+        calc_SFs(fields, fields);
+    }
+    reduce_binned();
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to reset the cylindrical bins and the projections onto the spherical harmonics, which are accumulated again from
+*           all the structure functions computed so far at every collection (see compute_levels()).
+*************************************************************************************************************************************
+*/
+void clear_binned() {
+    if (cyl_switch) {
+        SF_cyl_count=0;
+        if (scalar_switch) {
+            SF_cyl_scalar=0;
+        }
+        else {
+            SF_cyl_pll=0;
+            if (not longitudinal) {
+                SF_cyl_perp=0;
+            }
+        }
+    }
+    if (harmonic_switch) {
+        if (scalar_switch) {
+            SF_harm_scalar=0;
+        }
+        else {
+            SF_harm_pll=0;
+            if (not longitudinal) {
+                SF_harm_perp=0;
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to sum the cylindrical bins and the projections onto the spherical harmonics of all the processors at rank 0, and to
+*           normalize them.
+*************************************************************************************************************************************
+*/
+void reduce_binned() {
+    if (cyl_switch) {
+        if (rank_mpi!=0) {
+            MPI_Reduce(SF_cyl_count.data(), NULL, SF_cyl_count.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        }
+        else {
+            MPI_Reduce(MPI_IN_PLACE, SF_cyl_count.data(), SF_cyl_count.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        }
+        if (scalar_switch) {
+            reduce_cylindrical(SF_cyl_scalar);
+        }
+        else {
+            reduce_cylindrical(SF_cyl_pll);
+            if (not longitudinal) {
+                reduce_cylindrical(SF_cyl_perp);
+            }
+        }
+    }
+    if (harmonic_switch) {
+        if (scalar_switch) {
+            reduce_harmonics(SF_harm_scalar);
+        }
+        else {
+            reduce_harmonics(SF_harm_pll);
+            if (not longitudinal) {
+                reduce_harmonics(SF_harm_perp);
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to write the structure function arrays to the disk.
+*************************************************************************************************************************************
+*/
+void write_SFs() {
+    if (rank_mpi==0){
+        mkdir("out",0777);
+        if (shard_switch) {
+            write_shard();
+            return;
+        }
+        if (particle_switch) {
+            int nq=q2-q1+1;
+            for (int p1=q1; p1<=q2; p1++) {
+                string name = int_to_str(p1);
+                cout<<"\nWriting "<<p1<<" order SF of the particles as function of the separation\n";
+                if (scalar_switch) {
+                    for (int f=0; f<scalar_count; f++) {
+                        write_1D(SF_particles_scalar(Range::all(), f*nq+p1-q1), "SF_particles_scalar"+name+scalar_suffix(f));
+                    }
+                }
+                else {
+                    write_1D(SF_particles_pll(Range::all(), p1-q1), "SF_particles_pll"+name);
+                    if (not longitudinal) {
+                        write_1D(SF_particles_perp(Range::all(), p1-q1), "SF_particles_perp"+name);
+                    }
+                }
+            }
+            Array<double,1> r(particle_bins);
+            for (int b=0; b<particle_bins; b++) {
+                r(b)=(b+0.5)*particle_rmax/particle_bins;
+            }
+            write_1D(r, "SF_particles_r");
+            write_1D(SF_particles_count, "SF_particles_count", true);
+            return;
+        }
+        if (plane_switch) {
+            int stride = lag_signs()*(q2-q1+1);
+            for (int p1=q1; p1<=q2; p1++) {
+                string name = int_to_str(p1);
+                cout<<"\nWriting "<<p1<<" order SF of the planes as function of lx, ly, and the plane\n";
+                if (scalar_switch) {
+                    for (int f=0; f<scalar_count; f++) {
+                        write_planes(SF_planes_scalar(Range::all(), Range::all(), Range::all(), Range(f*stride, (f+1)*stride-1)),
+                                     "SF_planes_scalar"+name+scalar_suffix(f), p1);
+                    }
+                }
+                else {
+                    write_planes(SF_planes_pll, "SF_planes_pll"+name, p1);
+                    if (not longitudinal) {
+                        write_planes(SF_planes_perp, "SF_planes_perp"+name, p1);
+                    }
+                }
+            }
+            Array<double,1> index(planes.size());
+            for (size_t n=0; n<planes.size(); n++) {
+                index(n)=planes[n];
+            }
+            write_1D(index, "SF_planes_z");
+            return;
+        }
+        if (axes_switch) {
+            for (int d=0; d<axes_dirs.extent(0); d++) {
+                int L=axes_lags(d);
+                cout<<"\nWriting SF as function of the displacement along "<<axes_name(d)<<"\n";
+                for (int p1=q1; p1<=q2; p1++) {
+                    string name = axes_name(d)+"_";
+                    if (scalar_switch) {
+                        write_1D(SF_axes_scalar(d, Range(0, L-1), p1-q1), name+"scalar"+int_to_str(p1));
+                    }
+                    else {
+                        write_1D(SF_axes_pll(d, Range(0, L-1), p1-q1), name+"pll"+int_to_str(p1));
+                        if (not longitudinal) {
+                            write_1D(SF_axes_perp(d, Range(0, L-1), p1-q1), name+"perp"+int_to_str(p1));
+                        }
+                    }
+                }
+            }
+            return;
+        }
+        int p1 = q1;
+        int stride = lag_signs()*(q2-q1+1);
+        while (p1 <= q2) {
+            string name = int_to_str(p1);
+            if (two_dimension_switch) {
+                cout<<"\nWriting "<<p1<<" order SF as function of lx and lz\n";
+                if (scalar_switch){
+                    for (int f=0; f<scalar_count; f++) {
+                        write_grid(SF_Grid2D_scalar(Range::all(), Range::all(), Range(f*stride, (f+1)*stride-1)),
+                                   "SF_Grid_scalar"+name+scalar_suffix(f), p1);
+                    }
+                }
+                else {
+                    write_grid(SF_Grid2D_pll,"SF_Grid_pll"+name, p1);    
+                    if (not longitudinal) {
+                        write_grid(SF_Grid2D_perp, "SF_Grid_perp"+name, p1);
+                    }
+                }
+                cout<<"\nWriting completed\n";
+            }
+            else {
+                cout<<"\nWriting "<<p1<<" order SF as function of lx, ly, and ly\n";
+                if (scalar_switch){
+                    for (int f=0; f<scalar_count; f++) {
+                        write_grid(SF_Grid_scalar(Range::all(), Range::all(), Range::all(), Range(f*stride, (f+1)*stride-1)),
+                                   "SF_Grid_scalar"+name+scalar_suffix(f), p1);
+                    }
+                }
+                else {
+                    write_grid(SF_Grid_pll,"SF_Grid_pll"+name, p1);    
+                    if (not longitudinal) {
+                        write_grid(SF_Grid_perp, "SF_Grid_perp"+name, p1);
+                    }
+                }
+                cout<<"\nWriting completed\n";
+            }
+            if (block_switch) {
+                cout<<"\nWriting "<<p1<<" order SF of the sub-blocks\n";
+                if (two_dimension_switch) {
+                    for (int f=0; scalar_switch and f<scalar_count; f++) {
+                        write_blocks(SF_Grid2D_blocks, "SF_block_scalar"+name+scalar_suffix(f), f*(q2-q1+1)+p1-q1);
+                    }
+                    if (not scalar_switch) {
+                        write_blocks(SF_Grid2D_blocks, "SF_block_pll"+name, p1-q1);
+                    }
+                    if (not scalar_switch and not longitudinal) {
+                        write_blocks(SF_Grid2D_blocks, "SF_block_perp"+name, q2-q1+1+p1-q1);
+                    }
+                }
+                else {
+                    for (int f=0; scalar_switch and f<scalar_count; f++) {
+                        write_blocks(SF_Grid_blocks, "SF_block_scalar"+name+scalar_suffix(f), f*(q2-q1+1)+p1-q1);
+                    }
+                    if (not scalar_switch) {
+                        write_blocks(SF_Grid_blocks, "SF_block_pll"+name, p1-q1);
+                    }
+                    if (not scalar_switch and not longitudinal) {
+                        write_blocks(SF_Grid_blocks, "SF_block_perp"+name, q2-q1+1+p1-q1);
+                    }
+                }
+            }
+            if (harmonic_switch) {
+                cout<<"\nWriting "<<p1<<" order SF projected onto the spherical harmonics\n";
+                if (scalar_switch){
+                    write_3D(SF_harm_scalar,"SF_harm_scalar"+name, p1);
+                }
+                else {
+                    write_3D(SF_harm_pll,"SF_harm_pll"+name, p1);
+                    if (not longitudinal) {
+                        write_3D(SF_harm_perp, "SF_harm_perp"+name, p1);
+                    }
+                }
+            }
+            if (cyl_switch) {
+                cout<<"\nWriting "<<p1<<" order SF as function of l_perp and l_pll\n";
+                if (scalar_switch){
+                    write_3D(SF_cyl_scalar,"SF_cyl_scalar"+name, p1);
+                }
+                else {
+                    write_3D(SF_cyl_pll,"SF_cyl_pll"+name, p1);
+                    if (not longitudinal) {
+                        write_3D(SF_cyl_perp, "SF_cyl_perp"+name, p1);
+                    }
+                }
+            }
+            p1++;
+        }
+        //The numbers of pairs of the cylindrical bins have no ensemble error
+        if (cyl_switch and out_suffix.empty()) {
+            write_2D(SF_cyl_count, "SF_cyl_count", true);
+        }
+        if (harmonic_switch and out_suffix.empty()) {
+            Array<double,1> r(SF_harm_count.extent(0));
+            for (int n=0; n<r.extent(0); n++) {
+                r(n)=n*harm_width;
+            }
+            write_1D(r, "SF_harm_r");
+            write_1D(SF_harm_count, "SF_harm_count", true);
+        }
+        if (mask_switch) {
+            if (two_dimension_switch) {
+                write_grid(SF_Grid2D_count, "SF_Grid_count", q1, true);
+            }
+            else {
+                write_grid(SF_Grid_count, "SF_Grid_count", q1, true);
+            }
+        }
+        if (tensor_switch) {
+            cout<<"\nWriting the tensors of the velocity increments\n";
+            for (int c=0; c<tensor_count(); c++) {
+                if (two_dimension_switch) {
+                    write_grid(SF_Grid2D_tensor, "SF_Grid_tensor_"+tensor_name(c), q1+c);
+                }
+                else {
+                    write_grid(SF_Grid_tensor, "SF_Grid_tensor_"+tensor_name(c), q1+c);
+                }
+            }
+        }
+        if (progress_switch) {
+            write_coverage();
+        }
+        if (block_switch) {
+            if (two_dimension_switch) {
+                write_blocks(SF_Grid2D_blocks, "SF_block_count", block_record()-1, true);
+            }
+            else {
+                write_blocks(SF_Grid_blocks, "SF_block_count", block_record()-1, true);
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to write the coverage of the displacement vectors in the progressive mode: 1 for the displacement vectors computed
+*           (of level at least progress_level) and 0 for the others, in the layout of the structure functions.
+*************************************************************************************************************************************
+*/
+void write_coverage() {
+    if (two_dimension_switch) {
+        Array<double,3> coverage(Nx/2, Nz/2, lag_signs());
+        for (int i=0; i<Nx/2; i++) {
+            for (int k=0; k<Nz/2; k++) {
+                coverage(i, k, Range::all())=(lag_level(i, 0, k) >= progress_level) ? 1.0 : 0.0;
+            }
+        }
+        write_grid(coverage, "SF_Grid_coverage", q1, true);
+    }
+    else {
+        Array<double,4> coverage(Nx/2, Ny/2, Nz/2, lag_signs());
+        for (int i=0; i<Nx/2; i++) {
+            for (int j=0; j<Ny/2; j++) {
+                for (int k=0; k<Nz/2; k++) {
+                    coverage(i, j, k, Range::all())=(lag_level(i, j, k) >= progress_level) ? 1.0 : 0.0;
+                }
+            }
+        }
+        write_grid(coverage, "SF_Grid_coverage", q1, true);
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function returning the suffix of the output files of the scalar field f: empty for a single scalar field, and "_" followed
+*           by the name of the field otherwise.
+*************************************************************************************************************************************
+*/
+string scalar_suffix(int f) {
+    return (scalar_count > 1) ? "_"+scalar_names[f] : "";
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to test the correctness of the code.
+*************************************************************************************************************************************
+*/
+void test_cases() {
+    cout<<"\nCOMMENCING TESTING OF THE CODE.\n";
+    if(rank_mpi==0){
+        if (scalar_switch){
+            if (two_dimension_switch){
+                SCALAR_TEST_CASE_2D();
+            }
+            else{
+                SCALAR_TEST_CASE_3D();
+            }
+        }
+        else{
+            if (two_dimension_switch){
+                VECTOR_TEST_CASE_2D();
+            }
+            else{
+                VECTOR_TEST_CASE_3D();
+            }
+        }
+    }
+    
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to obtain the \$ x \$, \$ y \$, and \$ z \$ ranks of the processor.
+*
+*           The ranks are ordered with the \$ z \$ rank varying the fastest. For 2D fields, \$ p_y = 1 \$ and the second rank is the
+*           \$ z \$ rank.
+*
+*\param     rank is the rank of the processor.
+*\param     rankx is the \$ x \$ rank of the processor.
+*\param     ranky is the \$ y \$ rank of the processor.
+*\param     rankz is the \$ z \$ rank of the processor.
+* 
+*************************************************************************************************************************************
+*/
+void get_rank(int rank, int& rankx, int& ranky, int& rankz){
+    rankz=rank%pz;
+    ranky=(rank/pz)%py;
+    rankx=rank/(py*pz);
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to allocate the displacements along a given direction for a particular rank.
+*
+*           The cost of a displacement \$ l \$ is proportional to the number of pairs \$ N-l \$ along the direction. The \$ N/2 \$
+*           displacements are dealt to the processors in decreasing order of cost, each one going to the processor with the least total
+*           cost so far. For \$ p \$ dividing \$ N/4 \$ this reproduces the pairing of \$ l \$ with \$ N/2-1-l \$, and for any other
+*           \$ p \le N/2 \$ it keeps the imbalance below the cost of a single displacement. Since the cost of a displacement vector is
+*           the product of the costs along each direction, the blocks formed by the lists of the three directions are balanced as well.
+*
+* \param    index_list stores the list of displacements (in grid units) of the processor.
+* \param    N is the number of points along the given direction.
+* \param    p is the number of processors along the given direction.
+* \param    rank is the \$ x \$, \$ y \$, or \$ z \$ rank of the processor.
+*************************************************************************************************************************************
+*/
+void compute_index_list(Array<int,1>& index_list, int N, int p, int rank){
+    int n=N/2;
+    vector<int> owner(n);
+    priority_queue< pair<long,int>, vector< pair<long,int> >, greater< pair<long,int> > > load;
+    for (int r=0; r<p; r++){
+        load.push(make_pair(0L, r));
+    }
+    for (int l=0; l<n; l++){
+        pair<long,int> least=load.top();
+        load.pop();
+        owner[l]=least.second;
+        least.first+=N-l;
+        load.push(least);
+    }
+
+    int list_size=0;
+    for (int l=0; l<n; l++){
+        if (owner[l]==rank) {
+            list_size++;
+        }
+    }
+    index_list.resize(list_size);
+    int i=0;
+    for (int l=0; l<n; l++){
+        if (owner[l]==rank) {
+            index_list(i++)=l;
+        }
+    }
+}
+
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to allocate the block of displacement vectors of a processor.
+*
+*           The space of displacement vectors is divided into \$ p_x \times p_y \times p_z \$ blocks (\$ p_x \times p_z \$ for 2D
+*           fields), each being the product of the cost weighted lists along the three directions.
+*
+* \param    X stores the \$ l_x \$ indices of the block.
+* \param    Y stores the \$ l_y \$ indices of the block (a single zero for 2D fields).
+* \param    Z stores the \$ l_z \$ indices of the block.
+* \param    rank is the rank of the processor.
+*************************************************************************************************************************************
+*/
+void compute_index_list(Array<int,1>& X, Array<int,1>& Y, Array<int,1>& Z, int rank){
+    int rankx, ranky, rankz;
+    get_rank(rank, rankx, ranky, rankz);
+    compute_index_list(X, Nx, px*shard_count, shard_index*px+rankx);
+    compute_index_list(Z, Nz, pz, rankz);
+    if (two_dimension_switch) {
+        Y.resize(1);
+        Y=0;
+    }
+    else {
+        compute_index_list(Y, Ny, py, ranky);
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to choose the number of processors along \$ y \$ and \$ z \$ when only \$ p_x \$ is given.
+*
+*           Among the divisors of \$ P/p_x \$ that are valid for \$ p_y \$, the largest one is taken, so that for \$ N_z/2 \$
+*           displacements along \$ z \$ the work is split along \$ z \$ only when \$ y \$ cannot take more processors.
+*
+*\return    The number of processors along \$ y \$, or 0 if no valid split exists.
+*************************************************************************************************************************************
+*/
+int default_py(){
+    int pyz=P/px;
+    for (int d=min(pyz, max(Ny/2,1)); d>=1; d--){
+        if (pyz%d==0 and pyz/d<=max(Nz/2,1)) {
+            return d;
+        }
+    }
+    return 0;
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to send an array of doubles to another MPI process in pieces that fit in an int count.
+*
+* \param    A is the pointer to the data.
+* \param    n is the number of elements.
+* \param    dest is the rank of the receiving processor.
+*************************************************************************************************************************************
+*/
+void send_doubles(double* A, long n, int dest){
+    const long piece=1L<<28;
+    for (long i=0; i<n; i+=piece){
+        MPI_Send(A+i, int(min(piece, n-i)), MPI_DOUBLE, dest, 0, comm_SF);
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to receive an array of doubles sent by send_doubles().
+*
+* \param    A is the pointer to the buffer.
+* \param    n is the number of elements.
+* \param    source is the rank of the sending processor.
+*************************************************************************************************************************************
+*/
+void recv_doubles(double* A, long n, int source){
+    const long piece=1L<<28;
+    for (long i=0; i<n; i+=piece){
+        MPI_Recv(A+i, int(min(piece, n-i)), MPI_DOUBLE, source, 0, comm_SF, MPI_STATUS_IGNORE);
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to collect the blocks of structure functions computed by all the processors into the global array at rank 0.
+*
+*           The blocks are received one processor at a time, so that the root needs memory for only one block besides the global
+*           array.
+*
+* \param    local is the 4D array \$ (l_x, l_y, l_z, q) \$ of the block computed by this processor.
+* \param    grid is the global 4D array of the structure functions (used only at rank 0).
+*************************************************************************************************************************************
+*/
+void gather_SF(Array<double,4> local, Array<double,4> grid){
+    if (rank_mpi!=0) {
+        send_doubles(local.data(), local.size(), 0);
+        return;
+    }
+    Array<int,1> X, Y, Z;
+    Array<double,4> block;
+    for (int r=0; r<P; r++){
+        compute_index_list(X, Y, Z, r);
+        if (r==0) {
+            block.reference(local);
+        }
+        else {
+            block.resize(X.size(), Y.size(), Z.size(), grid.extent(3));
+            recv_doubles(block.data(), block.size(), r);
+        }
+        for (int i=0; i<X.size(); i++){
+            for (int j=0; j<Y.size(); j++){
+                for (int k=0; k<Z.size(); k++){
+                    grid(X(i), Y(j), Z(k), Range::all())=block(i, j, k, Range::all());
+                }
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to collect the blocks of 2D structure functions computed by all the processors into the global array at rank 0.
+*
+* \param    local is the 3D array \$ (l_x, l_z, q) \$ of the block computed by this processor.
+* \param    grid is the global 3D array of the structure functions (used only at rank 0).
+*************************************************************************************************************************************
+*/
+void gather_SF(Array<double,3> local, Array<double,3> grid){
+    if (rank_mpi!=0) {
+        send_doubles(local.data(), local.size(), 0);
+        return;
+    }
+    Array<int,1> X, Y, Z;
+    Array<double,3> block;
+    for (int r=0; r<P; r++){
+        compute_index_list(X, Y, Z, r);
+        if (r==0) {
+            block.reference(local);
+        }
+        else {
+            block.resize(X.size(), Z.size(), grid.extent(2));
+            recv_doubles(block.data(), block.size(), r);
+        }
+        for (int i=0; i<X.size(); i++){
+            for (int k=0; k<Z.size(); k++){
+                grid(X(i), Z(k), Range::all())=block(i, k, Range::all());
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to find the cylindrical bin of a displacement vector.
+*
+*           \$ l_\parallel \$ is the component of the displacement along the anisotropy axis, which is already on the grid, and
+*           \$ l_\perp \$ is rounded to the nearest multiple of the bin width.
+*
+* \param    x, y, z are the components of the displacement vector in grid units.
+* \param    ip is the index of the \$ l_\perp \$ bin.
+* \param    ia is the index of the \$ l_\parallel \$ bin.
+*************************************************************************************************************************************
+*/
+void cylindrical_bin(int x, int y, int z, int& ip, int& ia){
+    int l[3]={x, y, z};
+    double d[3]={dx, dy, dz};
+    double lperp=0;
+    for (int a=0; a<3; a++){
+        if (a!=cyl_axis) {
+            lperp+=(l[a]*d[a])*(l[a]*d[a]);
+        }
+    }
+    ia=l[cyl_axis];
+    ip=int(sqrt(lperp)/cyl_width+0.5);
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to size the cylindrical bins.
+*
+*           The numbers of pairs of points of the bins are accumulated by count_cylindrical() from the numbers of pairs of the displacement
+*           vectors, which differ from those of the full grid with a mask.
+*************************************************************************************************************************************
+*/
+void setup_cylindrical(){
+    int N[3]={Nx, Ny, Nz};
+    double d[3]={dx, dy, dz};
+    cyl_width=0;
+    for (int a=0; a<3; a++){
+        if (a!=cyl_axis and d[a]>0 and (cyl_width==0 or d[a]<cyl_width)) {
+            cyl_width=d[a];
+        }
+    }
+    if (cyl_width==0) {
+        cyl_width=1;
+    }
+
+    int nlx=Nx/2, nly=two_dimension_switch ? 1 : Ny/2, nlz=Nz/2;
+    int n_perp, n_pll;
+    cylindrical_bin(nlx-1, nly-1, nlz-1, n_perp, n_pll);
+    n_perp++;
+    n_pll=N[cyl_axis]/2;
+
+    if (scalar_switch) {
+        SF_cyl_scalar.resize(n_perp, n_pll, q2-q1+1);
+        SF_cyl_scalar=0;
+    }
+    else {
+        SF_cyl_pll.resize(n_perp, n_pll, q2-q1+1);
+        SF_cyl_pll=0;
+        if (not longitudinal) {
+            SF_cyl_perp.resize(n_perp, n_pll, q2-q1+1);
+            SF_cyl_perp=0;
+        }
+    }
+
+    SF_cyl_count.resize(n_perp, n_pll);
+    SF_cyl_count=0;
+    if (rank_mpi==0) {
+        cout<<"\nBinning the structure functions about the "<<char('x'+cyl_axis)<<" axis in "<<n_perp<<" x "<<n_pll
+            <<" (l_perp, l_pll) bins of width "<<cyl_width<<" x "<<d[cyl_axis]<<endl;
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to accumulate the structure functions of the block of a processor into the cylindrical bins.
+*
+*           The structure function of every displacement vector is weighted by its number of pairs of points (inside the mask), so that
+*           the normalized bins are averages over all the pairs of the bin. With signed lags, every sign variant computed is a displacement
+*           vector of its own; the slots filled from another variant (see computed_slot()) are skipped. The slots are read with the stride
+*           of the last extent of the arrays, and only the first scalar field is binned.
+*
+* \param    X, Y, Z store the displacements of the block, as given by compute_index_list().
+* \param    local is the 4D array \$ (l_x, l_y, l_z, q) \$ of the block computed by this processor.
+* \param    Np is the 4D array of the numbers of pairs of points of every slot of the block.
+* \param    table is the 3D array \$ (l_\perp, l_\parallel, q) \$ of the binned sums.
+*************************************************************************************************************************************
+*/
+void bin_cylindrical(Array<int,1> X, Array<int,1> Y, Array<int,1> Z, Array<double,4> local, Array<double,4> Np, Array<double,3> table){
+    int nq=q2-q1+1;
+    for (int i=0; i<X.size(); i++){
+        for (int j=0; j<Y.size(); j++){
+            for (int k=0; k<Z.size(); k++){
+                int ip, ia;
+                cylindrical_bin(X(i), Y(j), Z(k), ip, ia);
+                for (int s=0; s<Np.extent(3); s++){
+                    if (computed_slot(s, Y(j), Z(k)) != s) {
+                        continue;
+                    }
+                    for (int p=0; p<nq; p++){
+                        table(ip, ia, p)+=Np(i, j, k, s)*local(i, j, k, s*nq+p);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to accumulate the 2D structure functions of the block of a processor into the cylindrical bins.
+*
+* \param    X, Y, Z store the displacements of the block, as given by compute_index_list().
+* \param    local is the 3D array \$ (l_x, l_z, q) \$ of the block computed by this processor.
+* \param    Np is the 3D array of the numbers of pairs of points of every slot of the block.
+* \param    table is the 3D array \$ (l_\perp, l_\parallel, q) \$ of the binned sums.
+*************************************************************************************************************************************
+*/
+void bin_cylindrical(Array<int,1> X, Array<int,1> Y, Array<int,1> Z, Array<double,3> local, Array<double,3> Np, Array<double,3> table){
+    Array<double,4> block(local.data(), shape(X.size(), 1, Z.size(), local.extent(2)), neverDeleteData);
+    Array<double,4> count(Np.data(), shape(X.size(), 1, Z.size(), Np.extent(2)), neverDeleteData);
+    bin_cylindrical(X, Y, Z, block, count, table);
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to accumulate the numbers of pairs of points of the block of a processor into the cylindrical bins (see
+*           bin_cylindrical()), once per run.
+*
+* \param    X, Y, Z store the displacements of the block, as given by compute_index_list().
+* \param    Np is the 4D array of the numbers of pairs of points of every slot of the block.
+*************************************************************************************************************************************
+*/
+void count_cylindrical(Array<int,1> X, Array<int,1> Y, Array<int,1> Z, Array<double,4> Np){
+    for (int i=0; i<X.size(); i++){
+        for (int j=0; j<Y.size(); j++){
+            for (int k=0; k<Z.size(); k++){
+                int ip, ia;
+                cylindrical_bin(X(i), Y(j), Z(k), ip, ia);
+                for (int s=0; s<Np.extent(3); s++){
+                    if (computed_slot(s, Y(j), Z(k)) == s) {
+                        SF_cyl_count(ip, ia)+=Np(i, j, k, s);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to accumulate the numbers of pairs of points of the 2D block of a processor into the cylindrical bins.
+*
+* \param    X, Y, Z store the displacements of the block, as given by compute_index_list().
+* \param    Np is the 3D array of the numbers of pairs of points of every slot of the block.
 *************************************************************************************************************************************
 */
-void calc_SFs() {
-    if (two_dimension_switch){
-        if (scalar_switch) {
-            SF_scalar_2D(T_2D);
+void count_cylindrical(Array<int,1> X, Array<int,1> Y, Array<int,1> Z, Array<double,3> Np){
+    Array<double,4> count(Np.data(), shape(X.size(), 1, Z.size(), Np.extent(2)), neverDeleteData);
+    count_cylindrical(X, Y, Z, count);
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to sum the cylindrical bins of all the processors at rank 0 and normalize them by their number of pairs.
+*
+* \param    table is the 3D array \$ (l_\perp, l_\parallel, q) \$ of the binned sums.
+*************************************************************************************************************************************
+*/
+void reduce_cylindrical(Array<double,3> table){
+    if (rank_mpi!=0) {
+        MPI_Reduce(table.data(), NULL, table.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        return;
+    }
+    MPI_Reduce(MPI_IN_PLACE, table.data(), table.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+    for (int ip=0; ip<table.extent(0); ip++){
+        for (int ia=0; ia<table.extent(1); ia++){
+            if (SF_cyl_count(ip, ia)>0) {
+                table(ip, ia, Range::all())/=SF_cyl_count(ip, ia);
+            }
+        }
+    }
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to compute the real spherical harmonics \$ Y_l^m \$ of a direction up to the degree harm_degree.
+*
+*           The polar axis is the anisotropy axis, and the azimuth is measured from the next axis in cyclic order (e.g., from \$ x \$ about
+*           \$ z \$). The harmonics are orthonormal on the sphere: \$ Y_l^0 = K_l^0 P_l^0(\cos \theta) \$, and
+*           \$ Y_l^m = \sqrt{2} K_l^m P_l^m(\cos \theta) \cos(m \phi) \$ and \$ Y_l^{-m} = \sqrt{2} K_l^m P_l^m(\cos \theta) \sin(m \phi) \$ for
+*           \$ m > 0 \$, where \$ K_l^m = \sqrt{(2l+1)(l-m)! / (4 \pi (l+m)!)} \$.
+*
+* \param    l stores the components of the displacement vector (not necessarily normalized, but nonzero).
+* \param    Y stores the \$ (l_{max}+1)^2 \$ harmonics, \$ Y_l^m \$ at the index \$ l^2+l+m \$.
+*************************************************************************************************************************************
+*/
+void spherical_harmonics(const double l[3], double* Y) {
+    double a=l[(cyl_axis+1)%3], b=l[(cyl_axis+2)%3], c=l[cyl_axis];
+    double r=sqrt(a*a+b*b+c*c);
+    double x=c/r, sx=sqrt(a*a+b*b)/r, phi=atan2(b, a);
+    int L=harm_degree;
+    for (int m=0; m<=L; m++) {
+        //Associated Legendre functions P_l^m(x) for l = m to L by the upward recurrence
+        double pmm=1;
+        for (int i=1; i<=m; i++) {
+            pmm*=-(2*i-1)*sx;
+        }
+        double p0=pmm, p1=x*(2*m+1)*pmm;
+        for (int n=m; n<=L; n++) {
+            double p=p0;
+            if (n==m+1) {
+                p=p1;
+            }
+            else if (n>m+1) {
+                p=(x*(2*n-1)*p1-(n+m-1)*p0)/(n-m);
+                p0=p1;
+                p1=p;
+            }
+            double K=(2*n+1)/(4*M_PI);
+            for (int i=n-m+1; i<=n+m; i++) {
+                K/=i;
+            }
+            K=sqrt(K);
+            if (m==0) {
+                Y[n*n+n]=K*p;
+            }
+            else {
+                Y[n*n+n+m]=sqrt(2.0)*K*p*cos(m*phi);
+                Y[n*n+n-m]=sqrt(2.0)*K*p*sin(m*phi);
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to find the shell of \$ |\mathbf{l}| \$ of a displacement vector, rounded to the nearest multiple of harm_width.
+*
+* \param    x, y, z are the components of the displacement vector in grid units.
+*************************************************************************************************************************************
+*/
+int harmonic_shell(int x, int y, int z) {
+    double lx=x*dx, ly=y*dy, lz=z*dz;
+    return int(sqrt(lx*lx+ly*ly+lz*lz)/harm_width+0.5);
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to size the tables of the projections onto the spherical harmonics and count the displacement vectors of every
+*           shell.
+*
+*           The displacement vectors of a shell cover the whole sphere of directions: every computed displacement vector
+*           \$ (l_x, l_y, l_z) \$ stands for the distinct vectors \$ (\pm l_x, \pm l_y, \pm l_z) \$ (see project_harmonics()).
+*************************************************************************************************************************************
+*/
+void setup_harmonics(){
+    double d[3]={dx, dy, dz};
+    harm_width=0;
+    for (int a=0; a<3; a++){
+        if (d[a]>0 and (harm_width==0 or d[a]<harm_width)) {
+            harm_width=d[a];
+        }
+    }
+    if (harm_width==0) {
+        harm_width=1;
+    }
+
+    int nlx=Nx/2, nly=Ny/2, nlz=Nz/2;
+    int n_shell=harmonic_shell(nlx-1, nly-1, nlz-1)+1;
+    int n_lm=(harm_degree+1)*(harm_degree+1);
+
+    if (scalar_switch) {
+        SF_harm_scalar.resize(n_shell, n_lm, q2-q1+1);
+        SF_harm_scalar=0;
+    }
+    else {
+        SF_harm_pll.resize(n_shell, n_lm, q2-q1+1);
+        SF_harm_pll=0;
+        if (not longitudinal) {
+            SF_harm_perp.resize(n_shell, n_lm, q2-q1+1);
+            SF_harm_perp=0;
+        }
+    }
+
+    if (rank_mpi==0) {
+        SF_harm_count.resize(n_shell);
+        SF_harm_count=0;
+        for (int x=0; x<nlx; x++){
+            for (int y=0; y<nly; y++){
+                for (int z=0; z<nlz; z++){
+                    if (x==0 and y==0 and z==0) {
+                        continue;
+                    }
+                    SF_harm_count(harmonic_shell(x, y, z))+=1 << ((x>0)+(y>0)+(z>0));
+                }
+            }
+        }
+        cout<<"\nProjecting the structure functions onto the spherical harmonics of degree up to "<<harm_degree<<" about the "
+            <<char('x'+cyl_axis)<<" axis in "<<n_shell<<" shells of width "<<harm_width<<endl;
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to accumulate the projections of the structure functions of the block of a processor onto the spherical harmonics.
+*
+*           Every computed displacement vector \$ (l_x, l_y, l_z) \$ stands for the distinct vectors \$ (\pm l_x, \pm l_y, \pm l_z) \$
+*           of the whole sphere. With signed lags, the vectors with \$ l_x \ge 0 \$ are computed, and the others follow from
+*           \$ S_q(-\mathbf{l}) = S_q(\mathbf{l}) \$, or \$ (-1)^q S_q(\mathbf{l}) \$ for the scalar structure functions. Without signed lags,
+*           the structure functions are in addition assumed to be symmetric under the reflections \$ l_y \to -l_y \$ and
+*           \$ l_z \to -l_z \$.
+*
+* \param    X, Y, Z store the displacements of the block, as given by compute_index_list().
+* \param    local is the 4D array \$ (l_x, l_y, l_z, q) \$ of the block computed by this processor, with the slots of lag_signs().
+* \param    table is the 3D array \$ (r, l^2+l+m, q) \$ of the sums of the projections.
+*************************************************************************************************************************************
+*/
+void project_harmonics(Array<int,1> X, Array<int,1> Y, Array<int,1> Z, Array<double,4> local, Array<double,3> table){
+    int nq=q2-q1+1, n_lm=table.extent(1);
+    vector<double> Ylm(n_lm);
+    for (int i=0; i<X.size(); i++){
+        for (int j=0; j<Y.size(); j++){
+            for (int k=0; k<Z.size(); k++){
+                int x=X(i), y=Y(j), z=Z(k);
+                if (x==0 and y==0 and z==0) {
+                    continue;
+                }
+                int shell=harmonic_shell(x, y, z);
+                for (int s=0; s<8; s++) {
+                    int sx=(s&4) ? -1 : 1, sy=(s&2) ? -1 : 1, sz=(s&1) ? -1 : 1;
+                    //Every distinct vector once: a zero component is taken with the positive sign only
+                    if ((x==0 and sx<0) or (y==0 and sy<0) or (z==0 and sz<0)) {
+                        continue;
+                    }
+                    double l[3]={sx*x*dx, sy*y*dy, sz*z*dz};
+                    spherical_harmonics(l, Ylm.data());
+                    //Slot of the computed vector, the vector itself for l_x >= 0 and its opposite otherwise
+                    bool opposite=(sx<0);
+                    int slot=0;
+                    if (signed_switch) {
+                        slot=2*((opposite ? -sy : sy)<0)+((opposite ? -sz : sz)<0);
+                    }
+                    for (int p=0; p<nq; p++){
+                        double S=local(i, j, k, slot*nq+p);
+                        if (opposite and scalar_switch and (q1+p)%2 != 0) {
+                            S=-S;
+                        }
+                        for (int n=0; n<n_lm; n++) {
+                            table(shell, n, p)+=S*Ylm[n];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to sum the projections onto the spherical harmonics of all the processors at rank 0 and normalize them.
+*
+*           The coefficients of a shell are \$ 4 \pi / N \sum S_q(\mathbf{l}) Y_l^m(\hat{\mathbf{l}}) \$ over its \$ N \$ displacement
+*           vectors, which approximates \$ \int S_q Y_l^m d\Omega \$.
+*
+* \param    table is the 3D array \$ (r, l^2+l+m, q) \$ of the sums of the projections.
+*************************************************************************************************************************************
+*/
+void reduce_harmonics(Array<double,3> table){
+    if (rank_mpi!=0) {
+        MPI_Reduce(table.data(), NULL, table.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        return;
+    }
+    MPI_Reduce(MPI_IN_PLACE, table.data(), table.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+    for (int n=0; n<table.extent(0); n++){
+        if (SF_harm_count(n)>0) {
+            table(n, Range::all(), Range::all())*=4*M_PI/SF_harm_count(n);
+        }
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Test function to validate the calculation of structure functions of 3D velocity field data.
+ *
+ *          This function validates the calculation of the structure functions computed using 3D velocity field data. The velocity field is
+ *          generated as \f$ \mathbf{u} = x \hat{x} + y \hat{y} + z \hat{z} \f$. For such field, the velocity structure functions of order
+ *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_y, l_z) = (\sqrt{l_x^2 + l_y^2 + l_z^2})^q \f$. In this function, the theoretical values
+ *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values
+ *          is less than \f$1 \times 10^{-10} \f$, the test is passed.
+ *
+ ********************************************************************************************************************************************
+ */
+void VECTOR_TEST_CASE_3D()
+{	
+    double epsilon=1e-10;
+    double err1 = 0, err2 = 0;
+    double max = 0;
+	Array<double,3> test1,test2;
+
+	if (longitudinal==true){
+		test1.resize(Nx/2,Ny/2,Nz/2);
+
+		for (int order=0 ; order<=q2-q1; order++){
+			string name=int_to_str(order+q1);
+			read_3D(test1,"out/","SF_Grid_pll"+name);
+			for (int i=0; i<test1.extent(0); i++){
+				double lx=dx*i;
+				for (int j=0; j<test1.extent(1); j++){
+					double ly=dy*j;
+					for (int k=0; k<test1.extent(2); k++){
+						double lz=dz*k;
+                        if (lx*lx + ly*ly + lz*lz > epsilon) {
+                            err1 = abs((test1(i,j,k)-pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.))/pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.));
+                        }
+                        else {
+                            err1 = abs(test1(i,j,k));
+                        }
+
+                        if (err1 > max) {
+                            max = err1;
+                        }
+
+
+					}
+				}
+			}
+		}
+
+	}
+	else{
+        cout<<"\nTESTING BOTH TRANSVERSE AND LONGITUDINAL\n";
+		test1.resize(Nx/2,Ny/2,Nz/2);
+		test2.resize(Nx/2,Ny/2,Nz/2);
+		for (int order=0 ; order<=q2-q1; order++){
+			string name=int_to_str(order+q1);
+
+			read_3D(test1,"out/","SF_Grid_pll"+name);
+			read_3D(test2,"out/","SF_Grid_perp"+name);
+
+
+			for (int i=0; i<test1.extent(0); i++){
+				double lx=dx*i;
+				for (int j=0; j<test1.extent(1); j++){
+					double ly=dy*j;
+					for (int k=0; k<test1.extent(2); k++){
+						double lz=dz*k;
+						if (lx*lx + ly*ly + lz*lz > epsilon) {
+                            err1 = abs((test1(i,j,k)-pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.))/pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.));
+                        }
+                        else {
+                            err1 = abs(test1(i,j,k));
+                        }
+                        err2 = abs(test2(i,j,k));
+                        if (err1 > max) {
+                            max = err1;
+                            
+                        }
+
+                        if (err2 > max) {
+                            max = err2;
+                    
+                        }
+
+					}
+				}
+			}
+
+		}
+	}
+
+
+	if (max > epsilon){
+		cout<<"\n\nVECTOR_3D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
+	}
+	else{
+		cout<<"\n\nVECTOR_3D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
+	}
+
+    cout<<"MAXIMUM PERCENTAGE ERROR: "<<max<<endl<<endl;
+
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Test function to validate the calculation of structure functions of 2D velocity field data.
+ *
+ *          This function validates the calculation of the structure functions computed using 2D velocity field data. The velocity field is
+ *          generated as \f$ \mathbf{u} = x \hat{x} + z \hat{z} \f$. For such field, the velocity structure functions of order
+ *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_z) = (\sqrt{l_x^2 + l_z^2})^q \f$. In this function, the analytically obtained  values
+ *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
+            than \f$1 \times 10^{-10} \f$, the test is passed.
+ *
+ ********************************************************************************************************************************************
+ */
+void VECTOR_TEST_CASE_2D()
+{	
+	double epsilon=1e-10;
+	double max=0;
+	double err1=0, err2 = 0;
+    Array<double,2> test1,test2;
+	int count=0;
+
+	if (longitudinal==true){
+		test1.resize(Nx/2,Nz/2);
+
+		for (int order=0 ; order<=q2-q1; order++){
+			string name=int_to_str(order+q1);
+			read_2D(test1,"out/","SF_Grid_pll"+name);
+			for (int i=0; i<test1.extent(0); i++){
+				double lx=dx*i;
+				for (int k=0; k<test1.extent(1); k++){
+					double lz=dz*k;
+                    if ((lx*lx + lz*lz)>epsilon) {
+                        err1 = abs((test1(i,k)-pow(lx*lx+lz*lz,(order+q1)/2.))/pow(lx*lx+lz*lz,(order+q1)/2.));
+                    }
+                    else {
+                        err1 =  abs(test1(i,k));
+                    }
+
+                    if (err1 > max) {
+                        max=err1;
+                    }
+
+				}
+			}
+		}
+
+	}
+	else{
+		test1.resize(Nx/2,Nz/2);
+		test2.resize(Nx/2,Nz/2);
+		for (int order=0 ; order<=q2-q1; order++){
+			string name=int_to_str(order+q1);
+
+			read_2D(test1,"out/","SF_Grid_pll"+name);
+			read_2D(test2,"out/","SF_Grid_perp"+name);
+
+
+			for (int i=0; i<test1.extent(0); i++){
+				double lx=dx*i;
+
+				for (int k=0; k<test1.extent(1); k++){
+					double lz=dz*k;
+                    if ((lx*lx + lz*lz)>epsilon) {
+                        err1 = abs((test1(i,k)-pow(lx*lx+lz*lz,(order+q1)/2.))/pow(lx*lx+lz*lz,(order+q1)/2.));
+                    }
+                    else {
+                        err1 =  abs(test1(i,k));
+                    }
+
+                    err2 = abs(test2(i,k));
+
+                    if (err1 > max) {
+                        max = err1;
+                    }
+                    if (err2 > max) {
+                        max = err2;
+                    }
+
+				}
+			}
+		}
+	}
+
+
+	if (max > epsilon){
+		cout<<"\n\nVECTOR_2D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
+	}
+	else{
+		cout<<"\n\nVECTOR_2D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
+	}
+
+    cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
+
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Test function to validate the calculation of structure functions of 2D scalar field data.
+ *
+ *          This function validates the calculation of the structure functions computed using 2D scalar field data. The scalar field is
+ *          generated as \f$ \theta = x + z \f$. For such field, the structure functions of order
+ *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_z) = (l_x^2 + l_z^2)^q \f$. In this function, the theoretical values
+ *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
+ *          than \f$1 \times 10^{-10} \f$, the test is passed.
+ *
+ ********************************************************************************************************************************************
+ */
+void SCALAR_TEST_CASE_2D()
+{	double epsilon=1e-10;
+	double max=0;
+	double err=0;
+	Array<double,2> test1;
+	int count=0;
+	test1.resize(Nx/2,Nz/2);
+	for (int order=0 ; order<=q2-q1; order++){
+		string name=int_to_str(order+q1);
+
+		read_2D(test1,"out/","SF_Grid_scalar"+name);
+
+
+
+		for (int i=0; i<test1.extent(0); i++){
+			double lx=dx*i;
+
+			for (int k=0; k<test1.extent(1); k++){
+				double lz=dz*k;
+				if (abs(lx+lz)>epsilon){
+					err=abs((test1(i,k)-pow(lx+lz,(order+q1)))/pow(lx+lz,(order+q1)));
+
+				}
+				else{
+					err=abs(test1(i,k));
+
+				}
+
+                if (err>max) {
+                    max = err;
+                }
+                
+
+			}
+            
+		}
+	}
+	if (max > epsilon){
+		cout<<"\n\nSCALAR_2D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
+	}
+	else{
+		cout<<"\n\nSCALAR_2D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
+	}
+
+	cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Test function to validate the calculation of structure functions of 3D scalar field data.
+ *
+ *          This function validates the calculation of the structure functions computed using 3D scalar field data. The scalar field is
+ *          generated as \f$ \theta = x + y + z \f$. For such field, the structure functions of order
+ *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_y, l_z) = (l_x^2 + l_y^2 + l_z^2)^q \f$. In this function, the theoretical values
+ *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
+ *          than \f$1 \times 10^{-10} \f$, the test is passed.
+ *
+ ********************************************************************************************************************************************
+ */
+void SCALAR_TEST_CASE_3D(){
+
+	double epsilon=1e-10;
+	double max=0;
+	double err=0;
+    Array<double,3> test1;
+	int count=0;
+	test1.resize(Nx/2,Ny/2,Nz/2);
+	for (int order=0 ; order<=q2-q1; order++){
+		string name=int_to_str(order+q1);
+		read_3D(test1,"out/","SF_Grid_scalar"+name);
+		for (int i=0; i<test1.extent(0); i++){
+			double lx=dx*i;
+			for (int j=0; j<test1.extent(1); j++){
+				double ly=dy*j;
+				for (int k=0; k<test1.extent(2); k++){
+					double lz=dz*k;
+					if (abs(lx+ly+lz)>epsilon){
+						err=abs((test1(i,j,k)-pow(lx+ly+lz,(order+q1)))/pow(lx+ly+lz,(order+q1)));
+
+					}
+					else{
+						err=abs(test1(i,j,k));
+
+					}
+
+                    if (err>max) {
+                        max=err;
+                    }
+				}
+			}
+		}
+	}
+	if (max > epsilon){
+		cout<<"\n\nSCALAR_3D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
+	}
+	else{
+		cout<<"\n\nSCALAR_3D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
+
+	}
+
+    cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
+
+}
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to convert an integer type value to string.
+ *
+ *
+ * \param   number is the integer value of to be converted.
+ *
+ * \return  The value as a string.
+ *
+ ********************************************************************************************************************************************
+ */
+string int_to_str(int number)
+{
+    stringstream ss;
+
+    ss << number;
+
+    return ss.str();
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the time elapsed.
+ *
+ *          This function computes the time elapsed in seconds between a start point and an end point during the execution of the
+ *          program
+ *
+ * \param start_t is the time corresponding to the start point
+ * \param end_t is the time corresponding to the end point
+ * \param elapsed stores the time elapsed in seconds
+ ********************************************************************************************************************************************
+ */
+void compute_time_elapsed(timeval start_t, timeval end_t, double& elapsed){
+    long elapsed_2 = (end_t.tv_sec-start_t.tv_sec)*1000000u + end_t.tv_usec-start_t.tv_usec;
+    elapsed=elapsed_2/1.0e6;
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to open the hardware performance counters of this MPI process.
+ *
+ *          The counters are opened in the disabled state with the inherit flag set, so that the threads spawned afterwards are also
+ *          counted. Only the user-space part of the computation is counted. Counters that cannot be opened (for example, due to the
+ *          value of /proc/sys/kernel/perf_event_paranoid or the absence of a PMU in a virtual machine) are marked as unavailable.
+ ********************************************************************************************************************************************
+ */
+void perf_open() {
+    for (int i=0; i<N_PERF_EVENTS; i++) {
+        perf_fd[i] = -1;
+        perf_count[i] = 0;
+    }
+#ifdef __linux__
+    unsigned long long config[N_PERF_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES};
+    for (int i=0; i<N_PERF_EVENTS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config[i];
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        perf_fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+    if (perf_fd[0] < 0 && rank_mpi==0) {
+        cout<<"\nWARNING: The hardware performance counters could not be opened. Only the derived metrics that do not depend on them will be reported.\n";
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to reset and enable the hardware performance counters.
+ ********************************************************************************************************************************************
+ */
+void perf_start() {
+#ifdef __linux__
+    for (int i=0; i<N_PERF_EVENTS; i++) {
+        if (perf_fd[i] >= 0) {
+            ioctl(perf_fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to disable and read the hardware performance counters.
+ *
+ *          If the kernel had to multiplex the counters, the values are scaled by the ratio of the enabled time to the running time.
+ ********************************************************************************************************************************************
+ */
+void perf_stop() {
+#ifdef __linux__
+    for (int i=0; i<N_PERF_EVENTS; i++) {
+        if (perf_fd[i] >= 0) {
+            ioctl(perf_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int i=0; i<N_PERF_EVENTS; i++) {
+        unsigned long long value[3];
+        if (perf_fd[i] >= 0 && read(perf_fd[i], value, sizeof(value)) == sizeof(value)) {
+            if (value[2] > 0 && value[2] < value[1]) {
+                perf_count[i] = (long long) (value[0]*(double(value[1])/value[2]));
+            }
+            else {
+                perf_count[i] = value[0];
+            }
+        }
+        else {
+            perf_count[i] = -1;
+        }
+        if (perf_fd[i] >= 0) {
+            close(perf_fd[i]);
+        }
+    }
+#endif
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to estimate the number of floating point operations performed for a pair of points.
+ *
+ *          The estimate counts the operations needed for computing the increment and its projections, and one multiplication and one
+ *          addition for every order of the structure function. It depends only on the type of the structure function, hence the
+ *          achieved FLOP rates of different runs can be compared directly.
+ *
+ * \return  The nominal number of floating point operations per pair.
+ ********************************************************************************************************************************************
+ */
+double flops_per_pair() {
+    int orders = q2-q1+1;
+    if (scalar_switch) {
+        return 1 + 2*orders;
+    }
+    int dim = two_dimension_switch ? 2 : 3;
+    //Increment and longitudinal projection
+    double flops = dim + 2*dim - 1 + 1 + 2*orders;
+    if (not longitudinal) {
+        //Transverse vector, its magnitude, and its powers
+        flops += 2*dim + 2*dim - 1 + 1 + 2*orders;
+    }
+    return flops;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to print the hardware counter readings and the derived performance metrics.
+ *
+ *          The counter values of all the MPI processes are summed up. The following metrics are reported: instructions per cycle,
+ *          last level cache miss ratio, bytes moved from the memory per pair (estimated as 64 bytes per last level cache miss), the
+ *          corresponding memory bandwidth, and the achieved FLOP rate based on flops_per_pair().
+ *
+ * \param   elapsed is the time taken by calc_SFs() in seconds.
+ ********************************************************************************************************************************************
+ */
+void perf_report(double elapsed) {
+    long long total[N_PERF_EVENTS];
+    long long available[N_PERF_EVENTS], all_available[N_PERF_EVENTS];
+    for (int i=0; i<N_PERF_EVENTS; i++) {
+        available[i] = (perf_count[i] >= 0 && perf_fd[i] >= 0) ? 1 : 0;
+        if (not available[i]) {
+            perf_count[i] = 0;
+        }
+    }
+    long long total_pairs, max_pairs, min_pairs;
+    MPI_Reduce(perf_count, total, N_PERF_EVENTS, MPI_LONG_LONG, MPI_SUM, 0, comm_SF);
+    MPI_Reduce(available, all_available, N_PERF_EVENTS, MPI_LONG_LONG, MPI_MIN, 0, comm_SF);
+    MPI_Reduce(&pair_count, &total_pairs, 1, MPI_LONG_LONG, MPI_SUM, 0, comm_SF);
+    MPI_Reduce(&pair_count, &max_pairs, 1, MPI_LONG_LONG, MPI_MAX, 0, comm_SF);
+    MPI_Reduce(&pair_count, &min_pairs, 1, MPI_LONG_LONG, MPI_MIN, 0, comm_SF);
+
+    if (rank_mpi==0) {
+        double flops = total_pairs*flops_per_pair();
+        cout<<"\nPERFORMANCE REPORT (summed over "<<P<<" MPI processes)\n";
+        cout<<"Pairs of points: "<<total_pairs<<" (max/min per process: "<<max_pairs<<"/"<<min_pairs<<")\n";
+        cout<<"Nominal FLOPs per pair: "<<flops_per_pair()<<endl;
+        if (elapsed > 0) {
+            cout<<"Pairs per second: "<<total_pairs/elapsed<<endl;
+            cout<<"Achieved GFLOP/s: "<<flops/elapsed/1e9<<endl;
+        }
+        if (all_available[0] and all_available[1]) {
+            cout<<"Cycles: "<<total[0]<<endl;
+            cout<<"Instructions: "<<total[1]<<endl;
+            if (total[0] > 0) {
+                cout<<"Instructions per cycle: "<<double(total[1])/total[0]<<endl;
+            }
+        }
+        if (all_available[2] and all_available[3]) {
+            cout<<"Last level cache references: "<<total[2]<<endl;
+            cout<<"Last level cache misses: "<<total[3]<<endl;
+            if (total[2] > 0) {
+                cout<<"Last level cache miss ratio: "<<double(total[3])/total[2]<<endl;
+            }
+            if (total_pairs > 0) {
+                cout<<"Memory traffic per pair (bytes): "<<64.0*total[3]/total_pairs<<endl;
+            }
+            if (elapsed > 0) {
+                cout<<"Memory bandwidth (GB/s): "<<64.0*total[3]/elapsed/1e9<<endl;
+            }
+        }
+        if (not (all_available[0] and all_available[1] and all_available[2] and all_available[3])) {
+            cout<<"Some hardware counters were not available on all the MPI processes.\n";
+        }
+    }
+}
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the structure functions as function of \f$ (l_x,l_y,l_z) \f$ as a 3D hdf5 file.
+ *
+ *          This function reads the structure functions as a 4D array of dimensions \f$ (l_x \times l_y \times l_z \times p)\f$, where \f$ p \f$ is the order of the number of orders of
+ *          structure function.
+ *          The structure functions of different orders are then stored as separate 3D hdf5 files.
+ *
+ * \param   A is the 4D array representing the structure functions.
+ * \param   file is the name of the hdf5 file and the dataset in which the structure functions are stored.
+ * \param   q is the order of the structure function to be stored.
+ * \param   exact decides whether the array is stored in double precision regardless of single_precision.
+ ********************************************************************************************************************************************
+ */
+void write_4D(Array<double,4> A, string file,int q, bool exact) {
+  int nx=A(Range::all(),0,0,0).size();
+  int ny=A(0,Range::all(),0,0).size();
+  int nz=A(0,0,Range::all(),0).size();
+  Array<double,3> temp(nx,ny,nz);
+  temp(Range::all(),Range::all(),Range::all())=(A(Range::all(),Range::all(),Range::all(),q-q1));
+  hsize_t dims[3]={hsize_t(nx), hsize_t(ny), hsize_t(nz)};
+  write_dataset(temp.data(), file, 3, dims, exact);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the structure functions as function of lx,lz as a 2D hdf5 file.
+ *
+ *          This function reads the structure functions as a 3D array of dimensions \f$ (l_x \times l_z \times p) \f$, where \f$ p \f$ is the number of orders of the structure function.
+ *          The structure functions of different orders are then stored as separate 2D hdf5 files.
+ *
+ * \param   A is the 3D array representing the structure functions.
+ * \param   file is the name of the hdf5 file and the dataset in which the structure functions are stored.
+ * \param   q is the order of the structure function to be stored.
+ * \param   exact decides whether the array is stored in double precision regardless of single_precision.
+ ********************************************************************************************************************************************
+ */
+void write_3D(Array<double,3> A, string file,int q, bool exact) {
+  int nx=A(Range::all(),0,0).size();
+  int nz=A(0,Range::all(),0).size();
+  Array<double,2> temp(nx,nz);
+  temp(Range::all(),Range::all())=(A(Range::all(),Range::all(),q-q1));
+  hsize_t dims[2]={hsize_t(nx), hsize_t(nz)};
+  write_dataset(temp.data(), file, 2, dims, exact);
+}
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write a 2D array as a 2D hdf5 file.
+ *
+ * \param   A is the 2D array to be stored.
+ * \param   file is the name of the hdf5 file and the dataset in which the array is stored.
+ * \param   exact decides whether the array is stored in double precision regardless of single_precision.
+ ********************************************************************************************************************************************
+ */
+void write_2D(Array<double,2> A, string file, bool exact) {
+  hsize_t dims[2]={hsize_t(A.extent(0)), hsize_t(A.extent(1))};
+  write_dataset(A.data(), file, 2, dims, exact);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write a 1D array as a 1D hdf5 file.
+ *
+ * \param   A is the 1D array to be stored.
+ * \param   file is the name of the hdf5 file and the dataset in which the array is stored.
+ * \param   exact decides whether the array is stored in double precision regardless of single_precision.
+ ********************************************************************************************************************************************
+ */
+void write_1D(Array<double,1> A, string file, bool exact) {
+  Array<double,1> temp(A.extent(0));
+  temp=A;
+  hsize_t dims[1]={hsize_t(A.extent(0))};
+  write_dataset(temp.data(), file, 1, dims, exact);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the structure functions of order q of the 3D grid of displacement vectors.
+ *
+ *          With signed lags, the slots of the sign variants are assembled into a 3D array of dimensions
+ *          \f$ (N_x/2) \times (2 (N_y/2) - 1) \times (2 (N_z/2) - 1) \f$, where the index \f$ j \f$ corresponds to
+ *          \f$ l_y = (j - N_y/2 + 1) dy \f$ and similarly for \f$ l_z \f$. Otherwise the function is write_4D().
+ *
+ * \param   A is the 4D array of the structure functions.
+ * \param   file is the name of the hdf5 file and the dataset.
+ * \param   q is the order of the structure function to be stored.
+ * \param   exact decides whether the array is stored in double precision regardless of single_precision.
+ ********************************************************************************************************************************************
+ */
+void write_grid(Array<double,4> A, string file, int q, bool exact) {
+  if (not signed_switch) {
+    write_4D(A, file, q, exact);
+    return;
+  }
+  int nq=A.extent(3)/4;
+  int nx=A.extent(0), ny=A.extent(1), nz=A.extent(2);
+  Array<double,3> temp(nx, 2*ny-1, 2*nz-1);
+  for (int i=0; i<nx; i++) {
+    for (int j=1-ny; j<ny; j++) {
+      for (int k=1-nz; k<nz; k++) {
+        temp(i, j+ny-1, k+nz-1)=A(i, abs(j), abs(k), (2*(j<0)+(k<0))*nq+q-q1);
+      }
+    }
+  }
+  hsize_t dims[3]={hsize_t(nx), hsize_t(2*ny-1), hsize_t(2*nz-1)};
+  write_dataset(temp.data(), file, 3, dims, exact);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the structure functions of order q of the 2D grid of displacement vectors.
+ *
+ *          With signed lags, the array written has the dimensions \f$ (N_x/2) \times (2 (N_z/2) - 1) \f$, where the index \f$ k \f$
+ *          corresponds to \f$ l_z = (k - N_z/2 + 1) dz \f$. Otherwise the function is write_3D().
+ *
+ * \param   A is the 3D array of the structure functions.
+ * \param   file is the name of the hdf5 file and the dataset.
+ * \param   q is the order of the structure function to be stored.
+ * \param   exact decides whether the array is stored in double precision regardless of single_precision.
+ ********************************************************************************************************************************************
+ */
+void write_grid(Array<double,3> A, string file, int q, bool exact) {
+  if (not signed_switch) {
+    write_3D(A, file, q, exact);
+    return;
+  }
+  int nq=A.extent(2)/2;
+  int nx=A.extent(0), nz=A.extent(1);
+  Array<double,2> temp(nx, 2*nz-1);
+  for (int i=0; i<nx; i++) {
+    for (int k=1-nz; k<nz; k++) {
+      temp(i, k+nz-1)=A(i, abs(k), (k<0)*nq+q-q1);
+    }
+  }
+  hsize_t dims[2]={hsize_t(nx), hsize_t(2*nz-1)};
+  write_dataset(temp.data(), file, 2, dims, exact);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the structure functions of order q of the planes, as an array of dimensions
+ *          \f$ (N_x/2) \times (N_y/2) \times n_p \f$ for \f$ n_p \f$ planes (\f$ 2 (N_y/2) - 1 \f$ along \f$ l_y \f$ with signed lags, as
+ *          in write_grid()).
+ *
+ * \param   A is the 4D array \f$ (l_x, l_y, n, q) \f$ of the structure functions of the planes.
+ * \param   file is the name of the hdf5 file and the dataset.
+ * \param   q is the order of the structure function to be stored.
+ ********************************************************************************************************************************************
+ */
+void write_planes(Array<double,4> A, string file, int q) {
+  int ns=lag_signs(), nq=A.extent(3)/ns;
+  int nx=A.extent(0), ny=A.extent(1), np=A.extent(2);
+  int my=(ns==2) ? 2*ny-1 : ny;
+  Array<double,3> temp(nx, my, np);
+  for (int i=0; i<nx; i++) {
+    for (int j=0; j<my; j++) {
+      int l=(ns==2) ? j-ny+1 : j;
+      for (int n=0; n<np; n++) {
+        temp(i, j, n)=A(i, abs(l), n, (l<0)*nq+q-q1);
+      }
+    }
+  }
+  hsize_t dims[3]={hsize_t(nx), hsize_t(my), hsize_t(np)};
+  write_dataset(temp.data(), file, 3, dims, false);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write one entry of the records of the sub-blocks of the 3D grid of displacement vectors.
+ *
+ *          The array written has the dimensions \f$ (N_x/2) \times (N_y/2) \times (N_z/2) \times n_b \f$, where \f$ n_b \f$ is the number
+ *          of sub-blocks, ordered as in block_index().
+ *
+ * \param   A is the 4D array of the records of the sub-blocks.
+ * \param   file is the name of the hdf5 file and the dataset.
+ * \param   p is the index of the entry in the record (see block_record()).
+ * \param   exact decides whether the array is stored in double precision regardless of single_precision.
+ ********************************************************************************************************************************************
+ */
+void write_blocks(Array<double,4> A, string file, int p, bool exact) {
+  int nx=A.extent(0), ny=A.extent(1), nz=A.extent(2), nb=block_number();
+  Array<double,4> temp(nx, ny, nz, nb);
+  for (int i=0; i<nx; i++) {
+    for (int j=0; j<ny; j++) {
+      for (int k=0; k<nz; k++) {
+        for (int b=0; b<nb; b++) {
+          temp(i, j, k, b)=A(i, j, k, b*block_record()+p);
+        }
+      }
+    }
+  }
+  hsize_t dims[4]={hsize_t(nx), hsize_t(ny), hsize_t(nz), hsize_t(nb)};
+  write_dataset(temp.data(), file, 4, dims, exact);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write one entry of the records of the sub-blocks of the 2D grid of displacement vectors, as an array of
+ *          dimensions \f$ (N_x/2) \times (N_z/2) \times n_b \f$.
+ *
+ * \param   A is the 3D array of the records of the sub-blocks.
+ * \param   file is the name of the hdf5 file and the dataset.
+ * \param   p is the index of the entry in the record (see block_record()).
+ * \param   exact decides whether the array is stored in double precision regardless of single_precision.
+ ********************************************************************************************************************************************
+ */
+void write_blocks(Array<double,3> A, string file, int p, bool exact) {
+  int nx=A.extent(0), nz=A.extent(1), nb=block_number();
+  Array<double,3> temp(nx, nz, nb);
+  for (int i=0; i<nx; i++) {
+    for (int k=0; k<nz; k++) {
+      for (int b=0; b<nb; b++) {
+        temp(i, k, b)=A(i, k, b*block_record()+p);
+      }
+    }
+  }
+  hsize_t dims[3]={hsize_t(nx), hsize_t(nz), hsize_t(nb)};
+  write_dataset(temp.data(), file, 3, dims, exact);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write a contiguous array as the dataset of an hdf5 file in the out folder.
+ *
+ *          With compression, the dataset is split into chunks of consecutive rows of at most \f$ 2^{18} \f$ values and compressed with
+ *          the shuffle and gzip filters. With single_precision, hdf5 converts the values to floats while writing.
+ *
+ * \param   A is the pointer to the data, stored in row-major order.
+ * \param   file is the name of the hdf5 file and the dataset.
+ * \param   rank is the number of dimensions of the dataset.
+ * \param   dims are the dimensions of the dataset.
+ * \param   exact decides whether the array is stored in double precision regardless of single_precision.
+ ********************************************************************************************************************************************
+ */
+void write_dataset(const double* A, string file, int rank, const hsize_t* dims, bool exact) {
+  const hsize_t chunk_size=1<<18;
+  hid_t file_id=H5Fcreate(("out/"+file+out_suffix+".h5").c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if (file_id < 0) {
+    cerr<<"ERROR! Unable to create the output file out/"<<file+out_suffix<<".h5. Aborting..\n";
+    MPI_Abort(comm_SF, 1);
+  }
+  hid_t space=H5Screate_simple(rank, dims, NULL);
+  hid_t dcpl=H5Pcreate(H5P_DATASET_CREATE);
+
+  hsize_t n=1;
+  for (int d=0; d<rank; d++) {
+    n*=dims[d];
+  }
+  if (compression > 0 and n > 0) {
+    //Keep whole rows along the last dimensions as long as the chunk fits
+    hsize_t chunk[4], c=1;
+    for (int d=rank-1; d>=0; d--) {
+      chunk[d]=max(min(dims[d], chunk_size/c), hsize_t(1));
+      c*=chunk[d];
+    }
+    H5Pset_chunk(dcpl, rank, chunk);
+    H5Pset_shuffle(dcpl);
+    H5Pset_deflate(dcpl, compression);
+  }
+
+  hid_t type=(single_precision and not exact) ? H5T_NATIVE_FLOAT : H5T_NATIVE_DOUBLE;
+  hid_t dataset=H5Dcreate2(file_id, (file+out_suffix).c_str(), type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+  herr_t status=(dataset < 0) ? -1 : H5Dwrite(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, A);
+  if (dataset >= 0) {
+    H5Dclose(dataset);
+  }
+  H5Pclose(dcpl);
+  H5Sclose(space);
+  H5Fclose(file_id);
+  if (status < 0) {
+    cerr<<"ERROR! Unable to write the dataset "<<file+out_suffix<<" in out/"<<file+out_suffix<<".h5. Aborting..\n";
+    MPI_Abort(comm_SF, 1);
+  }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to store an integer parameter of the run as an attribute of an hdf5 object.
+ ********************************************************************************************************************************************
+ */
+herr_t write_attribute(hid_t object, const char* name, int value) {
+  hid_t space=H5Screate(H5S_SCALAR);
+  hid_t attribute=H5Acreate2(object, name, H5T_NATIVE_INT, space, H5P_DEFAULT, H5P_DEFAULT);
+  herr_t status=(attribute < 0) ? -1 : H5Awrite(attribute, H5T_NATIVE_INT, &value);
+  if (attribute >= 0) {
+    H5Aclose(attribute);
+  }
+  H5Sclose(space);
+  return status;
+}
+
+herr_t write_attribute(hid_t object, const char* name, double value) {
+  hid_t space=H5Screate(H5S_SCALAR);
+  hid_t attribute=H5Acreate2(object, name, H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT);
+  herr_t status=(attribute < 0) ? -1 : H5Awrite(attribute, H5T_NATIVE_DOUBLE, &value);
+  if (attribute >= 0) {
+    H5Aclose(attribute);
+  }
+  H5Sclose(space);
+  return status;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write a contiguous array as a dataset of an open hdf5 file.
+ ********************************************************************************************************************************************
+ */
+herr_t write_dataset(hid_t file_id, const char* name, hid_t type, const void* A, int rank, const hsize_t* dims) {
+  hid_t space=H5Screate_simple(rank, dims, NULL);
+  hid_t dataset=H5Dcreate2(file_id, name, type, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  herr_t status=(dataset < 0) ? -1 : H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, A);
+  if (dataset >= 0) {
+    H5Dclose(dataset);
+  }
+  H5Sclose(space);
+  return status;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the partial results of a shard to out/SF_shard_k_of_n.h5 (rank 0 only).
+ *
+ *          Instead of the normalized structure functions, the file stores the raw sums over the pairs of points and the numbers of
+ *          pairs, which simply add up when the shards, and the same shards of several snapshots, are merged. The dataset "lx" lists
+ *          the \f$ l_x \f$ indices of the shard, and the datasets "count" and "sum_pll", "sum_perp", or "sum_scalar" have the
+ *          dimensions of the structure function arrays with \f$ l_x \f$ restricted to these indices (\f$ N_y/2 = 1 \f$ for 2D
+ *          fields). The parameters of the run are stored as attributes of the file. The tool merge_shards.py writes the final
+ *          structure functions from these files.
+ ********************************************************************************************************************************************
+ */
+void write_shard() {
+  int nq=q2-q1+1, ns=lag_signs();
+  int nly=two_dimension_switch ? 1 : Ny/2, nlz=Nz/2;
+
+  //The lx indices of all the processors along x
+  vector<int> lx;
+  for (int r=0; r<px; r++) {
+    Array<int,1> X;
+    compute_index_list(X, Nx, px*shard_count, shard_index*px+r);
+    for (int i=0; i<X.size(); i++) {
+      lx.push_back(X(i));
+    }
+  }
+  sort(lx.begin(), lx.end());
+  int nlx=lx.size();
+
+  vector<string> names;
+  vector<double*> grids;
+  if (two_dimension_switch) {
+    Array<double,3>* all[3]={&SF_Grid2D_pll, &SF_Grid2D_perp, &SF_Grid2D_scalar};
+    for (int a=0; a<3; a++) {
+      grids.push_back(all[a]->data());
+    }
+  }
+  else {
+    Array<double,4>* all[3]={&SF_Grid_pll, &SF_Grid_perp, &SF_Grid_scalar};
+    for (int a=0; a<3; a++) {
+      grids.push_back(all[a]->data());
+    }
+  }
+  const char* all_names[3]={"sum_pll", "sum_perp", "sum_scalar"};
+  vector<double*> sums;
+  for (int a=0; a<3; a++) {
+    if ((a == 2) == scalar_switch and (a != 1 or not longitudinal)) {
+      names.push_back(all_names[a]);
+      sums.push_back(grids[a]);
+    }
+  }
+
+  //Raw sums and counts of the lx planes of the shard
+  long plane=long(nly)*nlz;
+  vector<double> count(nlx*plane*ns);
+  vector< vector<double> > raw(sums.size(), vector<double>(nlx*plane*ns*nq));
+  double* counts=mask_switch ? (two_dimension_switch ? SF_Grid2D_count.data() : SF_Grid_count.data()) : NULL;
+  for (int i=0; i<nlx; i++) {
+    for (int j=0; j<nly; j++) {
+      for (int k=0; k<nlz; k++) {
+        long lag=(long(lx[i])*nly+j)*nlz+k, cell=(long(i)*nly+j)*nlz+k;
+        for (int s=0; s<ns; s++) {
+          double n=counts ? counts[lag*ns+s] : double(Nx-lx[i])*(Ny-j)*(Nz-k);
+          count[cell*ns+s]=n;
+          for (size_t a=0; a<sums.size(); a++) {
+            for (int p=0; p<nq; p++) {
+              raw[a][(cell*ns+s)*nq+p]=n*sums[a][(lag*ns+s)*nq+p];
+            }
+          }
+        }
+      }
+    }
+  }
+
+  string file="out/SF_shard_"+int_to_str(shard_index)+"_of_"+int_to_str(shard_count)+".h5";
+  hid_t file_id=H5Fcreate(file.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if (file_id < 0) {
+    cerr<<"ERROR! Unable to create the shard file "<<file<<". Aborting..\n";
+    MPI_Abort(comm_SF, 1);
+  }
+  herr_t status=0;
+  const char* keys[14]={"Nx", "Ny", "Nz", "q1", "q2", "scalar_switch", "2D_switch", "Only_longitudinal", "mask_switch",
+                        "signed_switch", "px", "shard_index", "shard_count", "lx_total"};
+  int values[14]={Nx, Ny, Nz, q1, q2, scalar_switch, two_dimension_switch, longitudinal, mask_switch, signed_switch, px,
+                  shard_index, shard_count, Nx/2};
+  for (int a=0; a<14; a++) {
+    status|=write_attribute(file_id, keys[a], values[a]);
+  }
+  hsize_t n=nlx;
+  status|=write_dataset(file_id, "lx", H5T_NATIVE_INT, lx.data(), 1, &n);
+  hsize_t dims[4]={hsize_t(nlx), hsize_t(nly), hsize_t(nlz), hsize_t(ns)};
+  status|=write_dataset(file_id, "count", H5T_NATIVE_DOUBLE, count.data(), 4, dims);
+  dims[3]=ns*nq;
+  for (size_t a=0; a<sums.size(); a++) {
+    status|=write_dataset(file_id, names[a].c_str(), H5T_NATIVE_DOUBLE, raw[a].data(), 4, dims);
+  }
+  H5Fclose(file_id);
+  if (status < 0) {
+    cerr<<"ERROR! Unable to write the shard file "<<file<<". Aborting..\n";
+    MPI_Abort(comm_SF, 1);
+  }
+  cout<<"\nShard "<<shard_index<<" of "<<shard_count<<" ("<<nlx<<" of "<<Nx/2<<" lx displacements) written to "<<file<<endl;
+}
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to read a 2D field from an hdf5 file.
+ *
+ *          This function reads an hdf5 file containing a 2D field, which can be the \f$ x \f$ or \f$ z \f$ component of a 2D velocity field. The dimensions of the
+ *          2D field is \f$(N_x \times N_z)\f$, where \f$N_x\f$ and \f$N_z\f$ are the number of gridpoints in \f$ x \f$ and \f$ z \f$ directions respectively.
+ *          The hdf5 file should have only
+ *          one dataset, and the names of the hdf5 file and the dataset must be identical. This function makes use of the H5SI library for reading the
+ *          hdf5 file.
+ *
+ * \param   A is the 2D array to store the field that is read from the file.
+ * \param   fold is the name of the folder in which the input files are kept.
+ * \param   file is a string storing the name of the file to be read.
+ ********************************************************************************************************************************************
+ */
+void read_2D(Array<double,2> A, string fold, string file) {
+  h5::File f(fold+file+".h5", "r");
+  f[file] >> A.data();
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to read a 3D field from an hdf5 file.
+ *
+ *          This function reads an hdf5 file containing a 4D field, which can be the \f$ x \f$, \f$ y \f$, or \f$ z \f$ component of a 3D velocity field. The dimensions of the
+ *          3D field is \f$(N_x \times N_y \times N_z)\f$, where \f$N_x\f$, \f$N_y\f$, and \f$N_z\f$ are the number of gridpoints in \f$ x \f$, \f$ y \f$, and \f$ z \f$ directions
+ *          respectively. The hdf5 file should
+ *          have only one dataset, and the names of the hdf5 file and the dataset must be identical. This function makes use of the H5SI library for
+ *          reading the hdf5 file.
+ *
+ * \param A is the 3D array to store the field that is read from the file.
+ * \param fold is the name of the folder in which the input files are kept.
+ * \param file is a string storing the name of the file to be read.
+ ********************************************************************************************************************************************
+ */
+void read_3D(Array<double,3> A, string fold, string file) {
+  h5::File f(fold+file+".h5", "r");
+  f[file] >> A.data();
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to read an optional entry of the parameters file.
+ *
+ *          The value is left unchanged if either the section or the key is missing from the file, so the caller has to set the default
+ *          value before calling this function. This keeps older parameter files valid when new entries are introduced.
+ *
+ * \param   para is the parsed parameters file.
+ * \param   section is the name of the section, e.g. "program".
+ * \param   key is the name of the entry inside the section.
+ * \param   value stores the value of the entry.
+ ********************************************************************************************************************************************
+ */
+template <class T>
+void get_optional(const YAML::Node& para, string section, string key, T& value) {
+    if (const YAML::Node *sec = para.FindValue(section)) {
+        if (const YAML::Node *val = sec->FindValue(key)) {
+            *val >> value;
+        }
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to switch off all the optional modes and to restore the defaults of the parameters set by get_Inputs(), so that every
+ *          call of the library and module interfaces starts from the same state, whatever the previous calls of the process.
+ ********************************************************************************************************************************************
+ */
+void reset_parameters() {
+    test_switch = perf_switch = ooc_switch = cyl_switch = harmonic_switch = axes_switch = diagonals = mask_switch = signed_switch = false;
+    ensemble_switch = cache_switch = cache_hit = shard_switch = shared_switch = block_switch = progress_switch = time_switch = false;
+    plane_switch = tensor_switch = particle_switch = single_precision = false;
+
+    scalar_names.assign(1, "T.Fr");
+    scalar_count = 1;
+    in_folder = "in/";
+    out_suffix = "";
+    memory_budget = 1024;
+    cyl_axis = 2;
+    harm_degree = 4;
+    mask_condition = 0;
+    mask_threshold = 0;
+    mask_runs.clear();
+    mask_rows.clear();
+    snapshots.clear();
+    ensemble_file = "out/SF_ensemble.h5";
+    cache_file = "out/SF_cache.h5";
+    cache_hashes.clear();
+    shard_index = 0;
+    shard_count = 1;
+    for (int a=0; a<3; a++) {
+        block_size[a] = block_count[a] = 1;
+    }
+    numa_pinning = numa_placement = 0;
+    numa_nodes = 1;
+    thread_node.clear();
+    replicas.clear();
+    progress_interval = 600;
+    progress_level = 0;
+    time_window = 2;
+    time_lag = 0;
+    time_snapshots.clear();
+    planes.clear();
+    tensor_order = 2;
+    particle_file = "particles";
+    particle_rmax = 0;
+    particle_bins = 32;
+    compression = 0;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Modes of a run that check_modes() tests for incompatible combinations; the last three are kinds of input fields.
+ ********************************************************************************************************************************************
+ */
+enum run_mode {MODE_TEST, MODE_OOC, MODE_CYL, MODE_HARM, MODE_AXES, MODE_MASK, MODE_SIGNED, MODE_ENSEMBLE, MODE_SHARD, MODE_SHARED,
+               MODE_BLOCK, MODE_PROGRESS, MODE_TIME, MODE_PLANES, MODE_TENSOR, MODE_PARTICLES, MODE_CACHE, MODE_SCALARS, MODE_2D,
+               MODE_SCALAR, MODE_COUNT};
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Names of the modes in the error messages of check_modes().
+ ********************************************************************************************************************************************
+ */
+const char* mode_names[MODE_COUNT] = {"test mode", "out-of-core mode", "cylindrical mode", "spherical harmonics", "axes only mode", "mask",
+                                      "signed lags", "ensemble", "shards", "shared fields", "sub-blocks", "progressive mode",
+                                      "space-time structure functions", "planes", "tensors", "particles", "cache", "several scalar fields",
+                                      "2D fields", "scalar fields"};
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Structure storing a mode and the modes it cannot be combined with.
+ ********************************************************************************************************************************************
+ */
+struct mode_exclusion {
+    run_mode mode;              //!< Mode protected by the exclusion.
+    vector<run_mode> others;    //!< Modes that cannot be combined with it.
+};
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Table of the incompatible modes, checked by check_modes(). Every entry states why the mode cannot be combined with the others.
+ ********************************************************************************************************************************************
+ */
+const mode_exclusion mode_exclusions[] = {
+    //The out-of-core driver streams the planes of 3D fields read from the hdf5 files, and accumulates the plain sums of every field, the
+    //tensors, and the number of pairs of the unsigned lags over all the planes before the cylindrical and harmonic binning
+    {MODE_OOC, {MODE_2D, MODE_TEST}},
+    //The generated test fields have no mask, and the axes only driver does not count the pairs inside a mask
+    {MODE_MASK, {MODE_TEST, MODE_AXES}},
+    //The signed lags are computed by the kernels of the full grid, which the out-of-core and axes only drivers do not use, and have no
+    //analytical test
+    {MODE_SIGNED, {MODE_TEST, MODE_OOC, MODE_AXES}},
+    //The test mode compares a single run with the analytical structure functions
+    {MODE_ENSEMBLE, {MODE_TEST}},
+    //The shards write the raw sums of the full grid of a single snapshot, which merge_shards.py turns into structure functions
+    {MODE_SHARD, {MODE_TEST, MODE_AXES, MODE_CYL, MODE_ENSEMBLE}},
+    //Only the kernels of the full grid (in memory or out-of-core), the sub-blocks, and the harmonics loop over the scalar fields, the
+    //cylindrical bins hold the first one
+    {MODE_SCALARS, {MODE_TEST, MODE_AXES, MODE_SHARD}},
+    //The sums of the sub-blocks are accumulated by the kernels of the full grid over the unsigned lags of a single run
+    {MODE_BLOCK, {MODE_TEST, MODE_OOC, MODE_AXES, MODE_CYL, MODE_SIGNED, MODE_SHARD}},
+    //The intermediate outputs are collected between the levels of the drivers of the full grid of a single snapshot, the cylindrical
+    //bins of the displacement vectors computed so far being binned again at every collection
+    {MODE_PROGRESS, {MODE_TEST, MODE_OOC, MODE_AXES, MODE_ENSEMBLE, MODE_SHARD}},
+    //The snapshots of the time lags are read without mask and without shared fields by their own driver of the full grid
+    {MODE_TIME, {MODE_TEST, MODE_OOC, MODE_AXES, MODE_CYL, MODE_ENSEMBLE, MODE_SHARD, MODE_PROGRESS, MODE_MASK, MODE_SHARED}},
+    //The tensors are accumulated from the velocity increments by the kernels of the full grid, over the whole domain (not per sub-block),
+    //and have no plane sums
+    {MODE_TENSOR, {MODE_SCALAR, MODE_TEST, MODE_AXES, MODE_CYL, MODE_SHARD, MODE_PLANES}},
+    //The cache stores the final structure functions of the full grid of the input fields, per order
+    {MODE_CACHE, {MODE_TEST, MODE_OOC, MODE_AXES, MODE_CYL, MODE_ENSEMBLE, MODE_SHARD, MODE_PROGRESS, MODE_TIME, MODE_BLOCK, MODE_PLANES,
+                  MODE_TENSOR, MODE_PARTICLES, MODE_HARM}},
+    //The harmonics project the 3D grid of a single field, binned once at the end of the run
+    {MODE_HARM, {MODE_2D, MODE_TEST, MODE_AXES, MODE_CYL, MODE_PROGRESS, MODE_TIME, MODE_SHARD, MODE_BLOCK, MODE_PLANES,
+                 MODE_SCALARS}},
+    //The axes only driver computes lines of displacements from the fields in memory, which the test and the cylindrical binning of the
+    //full grid do not cover
+    {MODE_AXES, {MODE_TEST, MODE_OOC, MODE_CYL}},
+    //The planes are computed as 2D fields of the planes of 3D fields, by the 2D drivers of a single snapshot without mask
+    {MODE_PLANES, {MODE_2D, MODE_TEST, MODE_OOC, MODE_AXES, MODE_CYL, MODE_ENSEMBLE, MODE_SHARD, MODE_PROGRESS, MODE_TIME, MODE_MASK,
+                   MODE_BLOCK}},
+    //The pairs of particles have no grid of displacement vectors
+    {MODE_PARTICLES, {MODE_TEST, MODE_OOC, MODE_AXES, MODE_CYL, MODE_ENSEMBLE, MODE_SHARD, MODE_PROGRESS, MODE_TIME, MODE_MASK,
+                      MODE_SHARED, MODE_BLOCK, MODE_SIGNED, MODE_PLANES, MODE_TENSOR}}
+};
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to stop the run if it combines incompatible modes (see mode_exclusions), reporting the first such pair.
+ ********************************************************************************************************************************************
+ */
+void check_modes() {
+    bool on[MODE_COUNT];
+    on[MODE_TEST]=test_switch;
+    on[MODE_OOC]=ooc_switch;
+    on[MODE_CYL]=cyl_switch;
+    on[MODE_HARM]=harmonic_switch;
+    on[MODE_AXES]=axes_switch;
+    on[MODE_MASK]=mask_switch;
+    on[MODE_SIGNED]=signed_switch;
+    on[MODE_ENSEMBLE]=ensemble_switch;
+    on[MODE_SHARD]=shard_switch;
+    on[MODE_SHARED]=shared_switch;
+    on[MODE_BLOCK]=block_switch;
+    on[MODE_PROGRESS]=progress_switch;
+    on[MODE_TIME]=time_switch;
+    on[MODE_PLANES]=plane_switch;
+    on[MODE_TENSOR]=tensor_switch;
+    on[MODE_PARTICLES]=particle_switch;
+    on[MODE_CACHE]=cache_switch;
+    on[MODE_SCALARS]=(scalar_count > 1);
+    on[MODE_2D]=two_dimension_switch;
+    on[MODE_SCALAR]=scalar_switch;
+
+    for (size_t e=0; e<sizeof(mode_exclusions)/sizeof(mode_exclusions[0]); e++) {
+        const mode_exclusion& exclusion=mode_exclusions[e];
+        for (size_t n=0; n<exclusion.others.size(); n++) {
+            if (on[exclusion.mode] and on[exclusion.others[n]]) {
+                if (rank_mpi==0) {
+                    cout<<"ERROR! The "<<mode_names[exclusion.mode]<<" cannot be combined with the "<<mode_names[exclusion.others[n]]
+                        <<"! Aborting.."<<endl;
+                }
+                h5::finalize();
+                MPI_Finalize();
+                exit(1);
+            }
+        }
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to open the yaml file and parse the parameters.
+ *
+ *          The function opens the parameters.yaml file and parses the simulation parameters into its member variables that are publicly
+ *          accessible.
+ ********************************************************************************************************************************************
+ */
+void get_Inputs() {
+    YAML::Node para;
+    ifstream para_yaml,input_field;
+    string para_path="in/para.yaml";
+    para_yaml.open(para_path.c_str());
+  
+    if (para_yaml.is_open())
+    {
+      try
+      {
+        YAML::Parser parser(para_yaml);
+        parser.GetNextDocument(para);
+      }
+      catch(YAML::ParserException& e)
+      {
+        cerr << "Global::Parse: Error reading parameter file: \n" << e.what() << endl;
+      }
+  
+    }
+    else
+    {
+      cerr << "Global::Parse: Unable to open '" + para_path + "'." << endl;
+      h5::finalize();
+      MPI_Finalize();
+      exit(1);
+    }
+    reset_parameters();
+    para["program"]["scalar_switch"]>>scalar_switch;
+    para["program"]["Only_longitudinal"]>>longitudinal;
+    para["program"]["2D_switch"]>>two_dimension_switch;
+    para["grid"]["Nx"]>>Nx;
+    para["grid"]["Ny"]>>Ny;
+    para["grid"]["Nz"]>>Nz;
+    para["domain_dimension"]["Lx"]>>Lx;
+    para["domain_dimension"]["Ly"]>>Ly;
+    para["domain_dimension"]["Lz"]>>Lz;
+  
+    para["structure_function"]["q1"]>>q1;
+    para["structure_function"]["q2"]>>q2;
+    para["test"]["test_switch"]>>test_switch;
+
+    get_optional(para, "performance", "perf_counters", perf_switch);
+
+    get_optional(para, "program", "scalar_fields", scalar_names);
+
+    get_optional(para, "out_of_core", "ooc_switch", ooc_switch);
+    get_optional(para, "out_of_core", "memory_budget", memory_budget);
+
+    string axis = "z";
+    get_optional(para, "anisotropy", "cylindrical_switch", cyl_switch);
+    get_optional(para, "anisotropy", "axis", axis);
+
+    get_optional(para, "harmonics", "harmonic_switch", harmonic_switch);
+    get_optional(para, "harmonics", "degree", harm_degree);
+
+    get_optional(para, "axes_only", "axes_switch", axes_switch);
+    get_optional(para, "axes_only", "diagonals", diagonals);
+
+    string condition = "file";
+    get_optional(para, "mask", "mask_switch", mask_switch);
+    get_optional(para, "mask", "condition", condition);
+    get_optional(para, "mask", "threshold", mask_threshold);
+
+    get_optional(para, "signed_lags", "signed_switch", signed_switch);
+
+    get_optional(para, "ensemble", "ensemble_switch", ensemble_switch);
+    get_optional(para, "ensemble", "snapshots", snapshots);
+    get_optional(para, "ensemble", "accumulator", ensemble_file);
+
+    get_optional(para, "cache", "cache_switch", cache_switch);
+    get_optional(para, "cache", "file", cache_file);
+
+    get_optional(para, "shard", "shard_switch", shard_switch);
+    get_optional(para, "shard", "index", shard_index);
+    get_optional(para, "shard", "count", shard_count);
+    if (not shard_switch) {
+        shard_index = 0;
+        shard_count = 1;
+    }
+
+    get_optional(para, "shared_fields", "shared_switch", shared_switch);
+
+    block_size[0] = Nx;
+    block_size[1] = Ny;
+    block_size[2] = Nz;
+    get_optional(para, "local_blocks", "block_switch", block_switch);
+    get_optional(para, "local_blocks", "size_x", block_size[0]);
+    get_optional(para, "local_blocks", "size_y", block_size[1]);
+    get_optional(para, "local_blocks", "size_z", block_size[2]);
+
+    string pinning = "none";
+    string placement = "default";
+    get_optional(para, "numa", "pinning", pinning);
+    get_optional(para, "numa", "placement", placement);
+
+    get_optional(para, "progressive", "progress_switch", progress_switch);
+    get_optional(para, "progressive", "interval", progress_interval);
+    progress_time = MPI_Wtime();
+
+    get_optional(para, "space_time", "time_switch", time_switch);
+    get_optional(para, "space_time", "window", time_window);
+    get_optional(para, "space_time", "snapshots", time_snapshots);
+
+    get_optional(para, "planes", "plane_switch", plane_switch);
+    get_optional(para, "planes", "indices", planes);
+
+    get_optional(para, "tensor", "tensor_switch", tensor_switch);
+    get_optional(para, "tensor", "order", tensor_order);
+
+    get_optional(para, "particles", "particle_switch", particle_switch);
+    get_optional(para, "particles", "file", particle_file);
+    get_optional(para, "particles", "max_separation", particle_rmax);
+    get_optional(para, "particles", "bins", particle_bins);
+
+    get_optional(para, "output", "compression", compression);
+    get_optional(para, "output", "single_precision", single_precision);
+  
+    if (Nx==1){dx=0;}
+    else{
+      dx=Lx/double(Nx-1);}
+    if (Ny==1){dy=0;}
+    else{
+      dy=Ly/double(Ny-1);}
+    if (Nz==1){dz=0;}
+    else{
+      dz=Lz/double(Nz-1);
+  }
+
+    if (cyl_switch or harmonic_switch) {
+        if (axis=="x") {
+            cyl_axis=0;
+        }
+        else if (axis=="y" and not two_dimension_switch) {
+            cyl_axis=1;
+        }
+        else if (axis=="z") {
+            cyl_axis=2;
+        }
+        else {
+            if (rank_mpi==0) {
+                cout<<"ERROR! The anisotropy axis has to be x, y, or z (x or z for 2D fields)! Aborting.."<<endl;
+            }
+            h5::finalize();
+            MPI_Finalize();
+            exit(1);
+        }
+    }
+
+    numa_pinning = (pinning=="compact") ? 1 : (pinning=="spread") ? 2 : 0;
+    numa_placement = (placement=="interleave") ? 1 : (placement=="replicate") ? 2 : 0;
+    if ((numa_pinning==0 and pinning!="none") or (numa_placement==0 and placement!="default")) {
+        if (rank_mpi==0) {
+            cout<<"ERROR! The pinning has to be none, compact, or spread, and the placement default, interleave, or replicate! Aborting.."<<endl;
+        }
+        h5::finalize();
+        MPI_Finalize();
+        exit(1);
+    }
+
+    if (shared_switch and numa_placement==2) {
+        if (rank_mpi==0) {
+            cout<<"ERROR! The shared input fields cannot be replicated on the NUMA nodes! Aborting.."<<endl;
+        }
+        h5::finalize();
+        MPI_Finalize();
+        exit(1);
+    }
+
+    if (compression < 0 or compression > 9) {
+        if (rank_mpi==0) {
+            cout<<"ERROR! The compression level of the output files has to be between 0 and 9! Aborting.."<<endl;
+        }
+        h5::finalize();
+        MPI_Finalize();
+        exit(1);
+    }
+    if (compression > 0 and H5Zfilter_avail(H5Z_FILTER_DEFLATE) <= 0) {
+        if (rank_mpi==0) {
+            cout<<"WARNING: The gzip filter is not available in this hdf5 library; the output files will not be compressed."<<endl;
+        }
+        compression = 0;
+    }
+
+    if (mask_switch) {
+        if (condition=="file") {
+            mask_condition=0;
+        }
+        else if (condition=="T_above") {
+            mask_condition=1;
+        }
+        else if (condition=="T_below") {
+            mask_condition=2;
+        }
+        else {
+            if (rank_mpi==0) {
+                cout<<"ERROR! The condition of the mask has to be file, T_above, or T_below! Aborting.."<<endl;
+            }
+            h5::finalize();
+            MPI_Finalize();
+            exit(1);
+        }
+    }
+
+    if (ensemble_switch) {
+        if (snapshots.empty()) {
+            if (rank_mpi==0) {
+                cout<<"ERROR! The ensemble needs the folders of its snapshots! Aborting.."<<endl;
+            }
+            h5::finalize();
+            MPI_Finalize();
+            exit(1);
+        }
+        for (size_t s=0; s<snapshots.size(); s++) {
+            if (snapshots[s].empty() or snapshots[s][snapshots[s].size()-1] != '/') {
+                snapshots[s]+="/";
+            }
+        }
+    }
+
+    if (shard_switch) {
+        if (shard_count < 1 or shard_index < 0 or shard_index >= shard_count) {
+            if (rank_mpi==0) {
+                cout<<"ERROR! The index of the shard has to be between 0 and the number of shards minus 1! Aborting.."<<endl;
+            }
+            h5::finalize();
+            MPI_Finalize();
+            exit(1);
+        }
+    }
+
+    scalar_count = scalar_switch ? scalar_names.size() : 1;
+    if (scalar_switch and scalar_count == 0) {
+        if (rank_mpi==0) {
+            cout<<"ERROR! The list of the scalar fields is empty! Aborting.."<<endl;
+        }
+        h5::finalize();
+        MPI_Finalize();
+        exit(1);
+    }
+
+    check_modes();
+
+    if (block_switch) {
+        if (two_dimension_switch) {
+            block_size[1] = 1;
+        }
+        if (block_size[0] < 1 or block_size[1] < 1 or block_size[2] < 1) {
+            if (rank_mpi==0) {
+                cout<<"ERROR! The sizes of the sub-blocks have to be positive! Aborting.."<<endl;
+            }
+            h5::finalize();
+            MPI_Finalize();
+            exit(1);
+        }
+        int N[3]={Nx, Ny, Nz};
+        for (int d=0; d<3; d++) {
+            block_size[d] = min(block_size[d], N[d]);
+            block_count[d] = (N[d]+block_size[d]-1)/block_size[d];
+        }
+    }
+
+    if (time_switch) {
+        if (time_window < 1 or time_window > int(time_snapshots.size())) {
+            if (rank_mpi==0) {
+                cout<<"ERROR! The window of the space-time structure functions has to be between 1 and the number of snapshots! Aborting.."<<endl;
+            }
+            h5::finalize();
+            MPI_Finalize();
+            exit(1);
+        }
+        for (size_t s=0; s<time_snapshots.size(); s++) {
+            if (time_snapshots[s].empty() or time_snapshots[s][time_snapshots[s].size()-1] != '/') {
+                time_snapshots[s]+="/";
+            }
+        }
+    }
+
+    if (tensor_switch) {
+        if (tensor_order != 2 and tensor_order != 3) {
+            if (rank_mpi==0) {
+                cout<<"ERROR! The order of the tensors has to be 2 or 3! Aborting.."<<endl;
+            }
+            h5::finalize();
+            MPI_Finalize();
+            exit(1);
+        }
+    }
+
+    if (harmonic_switch) {
+        if (harm_degree < 0) {
+            if (rank_mpi==0) {
+                cout<<"ERROR! The degree of the spherical harmonics has to be nonnegative! Aborting.."<<endl;
+            }
+            h5::finalize();
+            MPI_Finalize();
+            exit(1);
+        }
+    }
+
+    if (plane_switch) {
+        if (planes.empty()) {
+            for (int k=0; k<Nz; k++) {
+                planes.push_back(k);
+            }
+        }
+        for (size_t n=0; n<planes.size(); n++) {
+            if (planes[n] < 0 or planes[n] >= Nz) {
+                if (rank_mpi==0) {
+                    cout<<"ERROR! The indices of the planes have to be between 0 and Nz-1! Aborting.."<<endl;
+                }
+                h5::finalize();
+                MPI_Finalize();
+                exit(1);
+            }
+        }
+        if (py > 1) {
+            if (rank_mpi==0) {
+                cout<<"ERROR! The planes are split among px processors along x and the other processors along y; the number of processors in y direction cannot be set! Aborting.."<<endl;
+            }
+            h5::finalize();
+            MPI_Finalize();
+            exit(1);
+        }
+        //A plane is computed as a 2D field whose second direction (z in the 2D mode) is y, see plane_grid
+        plane_grid[0]=Nx;
+        plane_grid[1]=Ny;
+        plane_grid[2]=Nz;
+        two_dimension_switch=true;
+        Nz=Ny;
+        Ny=1;
+        dz=dy;
+        dy=0;
+    }
+
+    //The pairs of particles are distributed over the processors by cells, without decomposition of the displacement vectors
+    if (particle_switch) {
+        if (particle_rmax <= 0 or particle_bins < 1) {
+            if (rank_mpi==0) {
+                cout<<"ERROR! The maximum separation of the particles has to be positive, and the number of bins at least 1! Aborting.."<<endl;
+            }
+            h5::finalize();
+            MPI_Finalize();
+            exit(1);
+        }
+        if (rank_mpi==0) {
+            cout<<"\nNumber of processors: "<<P<<endl;
+            cout<<"Number of threads per processor: "<<omp_get_max_threads()<<endl;
+        }
+        return;
+    }
+
+    if (px < 1 or px > P or P%px != 0) {
+        if (rank_mpi==0) {
+            cout<<"ERROR! Number of processors in x direction has to divide the total number of processors! Aborting.."<<endl;
+        }
+        h5::finalize();
+        MPI_Finalize();
+        exit(1);
+    }
+
+    if (two_dimension_switch) {
+        py = 1;
+    }
+    else if (py == 0) {
+        py = default_py();
+    }
+    if (py < 1 or (P/px)%py != 0) {
+        if (rank_mpi==0) {
+            cout<<"ERROR! Number of processors in y direction has to divide the number of processors divided by the number of processors in x direction! Aborting.."<<endl;
+        }
+        h5::finalize();
+        MPI_Finalize();
+        exit(1);
+    }
+    pz = P/(px*py);
+
+    if (rank_mpi==0) {
+        cout<<"\nNumber of processors in x direction: "<<px<<endl;
+        if (not two_dimension_switch) {
+            cout<<"Number of processors in y direction: "<<py<<endl;
+        }
+        if (plane_switch) {
+            cout<<"Number of processors in y direction of the planes: "<<pz<<endl;
+        }
+        else {
+            cout<<"Number of processors in z direction: "<<pz<<endl;
+        }
+        cout<<"Number of threads per processor: "<<omp_get_max_threads()<<endl;
+    }
+
+    if (px*shard_count > max(Nx/2,1)) {
+        if (rank_mpi==0) {
+            cout<<"ERROR! Number of processors in x direction times the number of shards should be less or equal to Nx/2\n Aborting...\n";
+        }
+        h5::finalize();
+        MPI_Finalize();
+        exit(1);
+    }
+    if (py > max(Ny/2,1)) {
+        if (rank_mpi==0) {
+            cout<<"ERROR! Number of processors in y direction should be less or equal to Ny/2\n Aborting...\n";
+        }
+        h5::finalize();
+        MPI_Finalize();
+        exit(1);
+    }
+    if (pz > max(Nz/2,1)) {
+        if (rank_mpi==0) {
+            if (plane_switch) {
+                cout<<"ERROR! The number of processors divided by the number of processors in x direction should be less or equal to Ny/2 for the planes\n Aborting...\n";
+            }
+            else {
+                cout<<"ERROR! Number of processors in z direction should be less or equal to Nz/2\n Aborting...\n";
+            }
+        }
+        h5::finalize();
+        MPI_Finalize();
+        exit(1);
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to generate an idealized 3D velocity field.
+ *
+ *          This function generates the following 3D velocity field.
+ *          \f$u_x = x, \quad u_y = y, \quad u_z = z\f$.
+ *
+ * \param Ux is a 3D array representing the x-component of 3D velocity field.
+ * \param Uy is a 3D array representing the y-component of 3D velocity field.
+ * \param Uz is a 3D array representing the z-component of 3D velocity field.
+ ********************************************************************************************************************************************
+ */
+void Read_Init(Array<double,3>& Ux, Array<double,3>& Uy, Array<double,3>& Uz){
+  if (rank_mpi==0)
+  {cout<<"\nGenerating the 3D velocity field: U = [x, y, z] \n";
+  }
+  for (int i=0; i<Nx; i++){
+      for (int j=0; j<Ny; j++){
+        for (int k=0; k<Nz; k++){
+            Ux(i, j, k) = i*dx;
+            Uy(i, j, k) = j*dy;
+            Uz(i, j, k) = k*dz;
+          }
+        }
+    }
+    if (rank_mpi==0)
+    {cout<<"\nField has been generated.\n";
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to generate an idealized 2D velocity field.
+ *
+ *          This function generates the following 2D velocity field.
+ *          \f$u_x = x, \quad u_z = z\f$.
+ *
+ * \param Ux is a 2D array representing the x-component of 2D velocity field.
+ * \param Uz is a 2D array representing the z-component of 2D velocity field.
+ ********************************************************************************************************************************************
+ */
+void Read_Init(Array<double,2>& Ux, Array<double,2>& Uz){
+	if (rank_mpi==0){
+		cout<<"\nGenerating the 2D velocity field: U = [x, z] \n";
+	}
+    for (int i=0;i<Nx;i++){
+      for (int k=0;k<Nz;k++){
+          Ux(i, k) = i*dx;
+          Uz(i, k) = k*dz;
+       }
+  }
+  if (rank_mpi==0)
+    {cout<<"\nField has been generated.\n";
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to generate an idealized 2D scalar field.
+ *
+ *          This function generates the following 2D scalar field.
+ *          \f$\theta = x + z \f$
+ *
+ * \param T is a 2D array representing the x-component of 2D velocity field.
+ ********************************************************************************************************************************************
+ */
+void Read_Init(Array<double,2>& T) {
+	if (rank_mpi==0){
+		cout<<"\nGenerating the scalar field: T = x + z \n";
+	}
+    for (int i=0;i<Nx;i++){
+      for (int k=0;k<Nz;k++){
+          T(i, k) = i*dx + k*dz;
+       }
+  }
+  if (rank_mpi==0)
+    {cout<<"\nField has been generated.\n";
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to generate an idealized 3D scalar field.
+ *
+ *          This function generates the following 2D scalar field.
+ *          \f$\theta = x + y + z \f$
+ *
+ * \param T is a 3D array representing the x-component of 2D velocity field.
+ ********************************************************************************************************************************************
+ */
+void Read_Init(Array<double,3>& T) {
+	if (rank_mpi==0){
+		cout<<"\nGenerating the scalar field: T = x + y + z \n";
+	}
+    for (int i=0;i<Nx;i++){
+      for (int j=0;j<Ny;j++){
+          for (int k=0;k<Nz;k++){
+              T(i, j, k) = i*dx + j*dy + k*dz;
+          }
+      }
+  }
+  if (rank_mpi==0)
+    {cout<<"\nField has been generated.\n";
+    }
+}
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute an integer power of a real number by repeated squaring.
+ *
+ * \param   a is the base.
+ * \param   q is the exponent.
+ *
+ * \return  \f$ a^q \f$.
+ ********************************************************************************************************************************************
+ */
+inline double int_pow(double a, int q) {
+    if (q < 0) {
+        return 1.0/int_pow(a, -q);
+    }
+    double result = 1.0;
+    while (q > 0) {
+        if (q & 1) {
+            result *= a;
+        }
+        a *= a;
+        q >>= 1;
+    }
+    return result;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the powers of a row of increments to the sums of the structure functions.
+ *
+ *          The power \f$ q_1 \f$ is computed once per increment, and the higher orders are obtained by successive multiplication, so that
+ *          all the orders are accumulated in one sweep over the row. The loops run over contiguous memory and are vectorized.
+ *
+ * \param   d is the row of increments.
+ * \param   t is a scratch row of the same length.
+ * \param   n is the length of the row.
+ * \param   S stores the sums for the orders \f$ q_1 \f$ to \f$ q_2 \f$.
+ ********************************************************************************************************************************************
+ */
+inline void add_powers(const double* d, double* t, int n, double* S) {
+    for (int k=0; k<n; k++) {
+        t[k] = int_pow(d[k], q1);
+    }
+    for (int p=0; p<=q2-q1; p++) {
+        double s = 0;
+        for (int k=0; k<n; k++) {
+            s += t[k];
+        }
+        S[p] += s;
+        if (p < q2-q1) {
+            for (int k=0; k<n; k++) {
+                t[k] *= d[k];
+            }
+        }
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Cursor over the segments of valid pairs of points of two rows along \f$ z \f$.
+ *
+ *          For a displacement \f$ l_z \f$ along the rows, a pair \f$ (k, k+l_z) \f$ is valid if both points are inside the mask. The
+ *          segments of valid \f$ k \f$ are the intersections of the runs of the first row with the runs of the second row shifted by
+ *          \f$ -l_z \f$, which are enumerated by merging the two lists of runs. Without mask, the single segment is the whole row.
+ ********************************************************************************************************************************************
+ */
+struct mask_segments {
+    const int *p1, *e1, *p2, *e2;
+    int z, nz, offset;
+    int rest_a, rest_b;
+    bool full;
+
+    /**
+     * \param row1, row2 are the indices of the two rows.
+     * \param z is the displacement along the rows.
+     * \param nz is the number of pairs of the rows, \f$ N_z - l_z \f$.
+     * \param offset is the \f$ z \f$ index of the base point of the pair \f$ k = 0 \f$, used to split the segments at the boundaries
+     *        of the sub-blocks with block_switch.
+     */
+    mask_segments(long row1, long row2, int z, int nz, int offset=0) : p1(NULL), e1(NULL), p2(NULL), e2(NULL), z(z), nz(nz),
+                                                                      offset(offset), rest_a(0), rest_b(0), full(not mask_switch) {
+        if (mask_switch) {
+            p1=mask_runs.data()+mask_rows[row1];
+            e1=mask_runs.data()+mask_rows[row1+1];
+            p2=mask_runs.data()+mask_rows[row2];
+            e2=mask_runs.data()+mask_rows[row2+1];
+        }
+    }
+
+    /**
+     * \brief   Function to get the next segment \f$ [a, b) \f$ of valid first points.
+     *
+     *          With block_switch, the segments are split so that the base points of a segment lie in one sub-block.
+     *
+     * \return  false when there is no segment left.
+     */
+    bool next(int& a, int& b) {
+        if (rest_a >= rest_b and not next_run(rest_a, rest_b)) {
+            return false;
+        }
+        a=rest_a;
+        b=rest_b;
+        if (block_switch) {
+            b=min(b, ((a+offset)/block_size[2]+1)*block_size[2]-offset);
+        }
+        rest_a=b;
+        return true;
+    }
+
+    /**
+     * \brief   Function to get the next segment \f$ [a, b) \f$ of valid first points, regardless of the sub-blocks.
+     *
+     * \return  false when there is no segment left.
+     */
+    bool next_run(int& a, int& b) {
+        if (full) {
+            full=false;
+            a=0;
+            b=nz;
+            return nz > 0;
+        }
+        while (p1 < e1 and p2 < e2) {
+            int f1=p1[1], f2=p2[1]-z;
+            a=max(p1[0], p2[0]-z);
+            b=min(min(f1, f2), nz);
+            if (a >= nz) {
+                return false;
+            }
+            if (f1 < f2) {
+                p1+=2;
+            }
+            else {
+                p2+=2;
+            }
+            if (a < b) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the unit vector along a displacement vector, and along \f$ x \f$ for the zero displacement vector (which
+ *          is computed only with a time lag).
+ *
+ * \param x, y, z are the components of the displacement vector in grid units.
+ * \param e stores the unit vector.
+ ********************************************************************************************************************************************
+ */
+void unit_vector(int x, int y, int z, double e[3]) {
+    double lx=x*dx, ly=y*dy, lz=z*dz;
+    double r=sqrt(lx*lx+ly*ly+lz*lz);
+    if (r == 0) {
+        e[0]=1;
+        e[1]=e[2]=0;
+        return;
+    }
+    e[0]=lx/r;
+    e[1]=ly/r;
+    e[2]=lz/r;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   One sign variant of a displacement vector, with the sums of its structure functions.
+ *
+ *          With signed lags, the displacement vectors \f$ (l_x, \pm l_y, \pm l_z) \f$ share the magnitudes of their components, and the
+ *          kernels compute all the variants of a displacement vector in one traversal of the fields.
+ ********************************************************************************************************************************************
+ */
+struct lag_variant {
+    int y, z;       //!< Signed \f$ y \f$ and \f$ z \f$ components of the displacement vector in grid units.
+    int slot;       //!< Slot of the variant in the arrays of the structure functions.
+    double e[3];    //!< Unit vector along the displacement vector.
+    double* S1;     //!< Sums for the longitudinal (or scalar) structure functions of orders \f$ q_1 \f$ to \f$ q_2 \f$.
+    double* S2;     //!< Sums for the transverse structure functions, or NULL.
+    long count;     //!< Number of pairs of points (inside the mask).
+    double* B;      //!< Records of the sub-blocks with block_switch (see block_record()), or NULL.
+    int field;      //!< Scalar field of the variant, whose sums are stored field*(q2-q1+1) elements into the records of the sub-blocks.
+    double* T;      //!< Sums for the components of the tensors of the velocity increments (see tensor_count()), or NULL.
+};
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the sub-block containing the base point \f$ (x, y, z) \f$ (in grid units), whose index is
+ *          \f$ (b_x n_y + b_y) n_z + b_z \f$ for the sub-block \f$ (b_x, b_y, b_z) \f$ of the \f$ n_x \times n_y \times n_z \f$ sub-blocks.
+ ********************************************************************************************************************************************
+ */
+inline int block_index(int x, int y, int z) {
+    if (not block_switch) {
+        return 0;
+    }
+    return ((x/block_size[0])*block_count[1]+y/block_size[1])*block_count[2]+z/block_size[2];
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the powers of a row of increments to the sums of a variant, or to the record of a sub-block with
+ *          block_switch.
+ *
+ * \param v is the variant.
+ * \param d1 is the row of longitudinal (or scalar) increments.
+ * \param d2 is the row of transverse increments, used only if the variant has transverse sums.
+ * \param t is a scratch row of the same length.
+ * \param n is the length of the rows.
+ * \param block is the sub-block of the base points of the row.
+ ********************************************************************************************************************************************
+ */
+inline void add_row(lag_variant& v, const double* d1, const double* d2, double* t, int n, int block) {
+    double *S1=v.S1, *S2=v.S2;
+    if (v.B != NULL) {
+        double* r=v.B+long(block)*block_record();
+        S1=r+v.field*(q2-q1+1);
+        S2=(S2 == NULL) ? NULL : r+q2-q1+1;
+        //The pairs of the row are counted once, with the first field
+        if (v.field == 0) {
+            r[block_record()-1]+=n;
+        }
+    }
+    add_powers(d1, t, n, S1);
+    if (S2 != NULL) {
+        add_powers(d2, t, n, S2);
+    }
+    v.count+=n;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the number of sign variants stored for every displacement vector: 4 for \f$ (\pm l_y, \pm l_z) \f$ and 2 for
+ *          \f$ \pm l_z \f$ (2D fields) with signed lags, and 1 otherwise.
+ ********************************************************************************************************************************************
+ */
+int lag_signs() {
+    if (not signed_switch) {
+        return 1;
+    }
+    return two_dimension_switch ? 2 : 4;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the slot of the variant computed for a slot of a displacement vector.
+ *
+ *          The slot of the signs \f$ (s_y, s_z) \f$ is \f$ 2 s_y + s_z \f$ (\f$ s_z \f$ for 2D fields), where 1 stands for a negative
+ *          component. A negative zero component is the same as a positive one, so that its slot is filled from the positive variant.
+ *
+ * \param s is the slot.
+ * \param y, z are the (nonnegative) \f$ y \f$ and \f$ z \f$ components of the displacement vector in grid units.
+ ********************************************************************************************************************************************
+ */
+inline int computed_slot(int s, int y, int z) {
+    int sy=(lag_signs()==4 and y>0) ? s/2 : 0;
+    int sz=(z>0) ? s%2 : 0;
+    return 2*sy+sz;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to set the sign variants of a displacement vector to be computed and to reset their sums.
+ *
+ * \param x, y, z are the (nonnegative) components of the displacement vector in grid units.
+ * \param S1 stores the sums for the longitudinal (or scalar) structure functions, \f$ q_2-q_1+1 \f$ orders per slot.
+ * \param S2 stores the sums for the transverse structure functions, or is NULL.
+ * \param B stores the records of the sub-blocks with block_switch, or is NULL.
+ * \param v stores the variants to be computed.
+ *
+ * \return  The number of variants to be computed (0 for the zero displacement vector without a time lag).
+ ********************************************************************************************************************************************
+ */
+int set_variants(int x, int y, int z, double* S1, double* S2, double* B, lag_variant v[4]) {
+    int nq=q2-q1+1, nv=0;
+    for (int p=0; p<lag_signs()*nq; p++) {
+        S1[p]=0;
+        if (S2 != NULL) {
+            S2[p]=0;
+        }
+    }
+    for (long p=0; B != NULL and p<long(block_number())*block_record(); p++) {
+        B[p]=0;
+    }
+    if (x==0 and y==0 and z==0 and time_lag==0) {
+        return 0;
+    }
+    for (int s=0; s<lag_signs(); s++) {
+        if (computed_slot(s, y, z) != s) {
+            continue;
+        }
+        v[nv].y=(s/2==1) ? -y : y;
+        v[nv].z=(s%2==1) ? -z : z;
+        v[nv].slot=s;
+        unit_vector(x, v[nv].y, v[nv].z, v[nv].e);
+        v[nv].S1=S1+s*nq;
+        v[nv].S2=(S2 == NULL) ? NULL : S2+s*nq;
+        v[nv].count=0;
+        v[nv].B=B;
+        v[nv].field=0;
+        v[nv].T=NULL;
+        nv++;
+    }
+    return nv;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to normalize the sums of the variants of a displacement vector by their numbers of pairs, and to fill the slots of
+ *          the variants that were not computed.
+ *
+ *          With block_switch, the sums of the variants are first obtained from the records of the sub-blocks, which are normalized by
+ *          their own numbers of pairs.
+ *
+ * \param y, z are the (nonnegative) \f$ y \f$ and \f$ z \f$ components of the displacement vector in grid units.
+ * \param S1 stores the structure functions, \f$ q_2-q_1+1 \f$ orders per slot.
+ * \param S2 stores the transverse structure functions, or is NULL.
+ * \param Np stores the number of pairs of points of every slot.
+ * \param v stores the variants computed.
+ * \param nv is the number of variants computed.
+ *
+ * \return  The total number of pairs of points of the variants computed.
+ ********************************************************************************************************************************************
+ */
+long finish_variants(int y, int z, double* S1, double* S2, double* Np, const lag_variant v[4], int nv) {
+    int nq=q2-q1+1;
+    long count=0;
+    for (int s=0; s<lag_signs(); s++) {
+        Np[s]=0;
+    }
+    for (int n=0; n<nv; n++) {
+        for (long b=0; v[n].B != NULL and b<block_number(); b++) {
+            double* r=v[n].B+b*block_record();
+            double count_b=r[block_record()-1];
+            double* r1=r+v[n].field*nq;
+            for (int p=0; p<nq; p++) {
+                v[n].S1[p]+=r1[p];
+                if (count_b > 0) {
+                    r1[p]/=count_b;
+                }
+                if (v[n].S2 != NULL) {
+                    v[n].S2[p]+=r[nq+p];
+                    if (count_b > 0) {
+                        r[nq+p]/=count_b;
+                    }
+                }
+            }
+        }
+        for (int p=0; p<nq and v[n].count>0; p++) {
+            v[n].S1[p]/=v[n].count;
+            if (v[n].S2 != NULL) {
+                v[n].S2[p]/=v[n].count;
+            }
+        }
+        Np[v[n].slot]=v[n].count;
+        count+=v[n].count;
+    }
+    for (int s=0; s<lag_signs(); s++) {
+        int c=computed_slot(s, y, z);
+        if (c == s) {
+            continue;
+        }
+        Np[s]=Np[c];
+        for (int p=0; p<nq; p++) {
+            S1[s*nq+p]=S1[c*nq+p];
+            if (S2 != NULL) {
+                S2[s*nq+p]=S2[c*nq+p];
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the number of independent components of the tensors of the velocity increments: the components
+ *          \f$ D_{ij} \f$ with \f$ i \le j \f$, followed by the components \f$ D_{ijk} \f$ with \f$ i \le j \le k \f$ if tensor_order is 3
+ *          (6 and 10 in 3D, 3 and 4 in 2D), and 0 without tensor_switch.
+ ********************************************************************************************************************************************
+ */
+int tensor_count() {
+    if (not tensor_switch) {
+        return 0;
+    }
+    int n=two_dimension_switch ? 2 : 3;
+    int count=n*(n+1)/2;
+    if (tensor_order == 3) {
+        count+=n*(n+1)*(n+2)/6;
+    }
+    return count;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the indices of the component c of the tensors (see tensor_count()), e.g., "xz" or "xyy".
+ ********************************************************************************************************************************************
+ */
+string tensor_name(int c) {
+    const char* axes=two_dimension_switch ? "xz" : "xyz";
+    int n=two_dimension_switch ? 2 : 3;
+    for (int i=0; i<n; i++) {
+        for (int j=i; j<n; j++) {
+            if (c-- == 0) {
+                return string(1, axes[i])+axes[j];
+            }
+        }
+    }
+    for (int i=0; i<n; i++) {
+        for (int j=i; j<n; j++) {
+            for (int k=j; k<n; k++) {
+                if (c-- == 0) {
+                    return string(1, axes[i])+axes[j]+axes[k];
+                }
+            }
+        }
+    }
+    return "";
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the products of the components of a row of velocity increments to the sums of the tensors.
+ *
+ * \param T stores the sums of the components of the tensors, in the order of tensor_name().
+ * \param d stores the rows of the components of the increments, \f$ N_z \f$ elements apart.
+ * \param n is the length of the rows.
+ * \param ncomp is the number of components of the velocity field.
+ ********************************************************************************************************************************************
+ */
+inline void add_tensor(double* T, const double* d, int n, int ncomp) {
+    int c=0;
+    for (int i=0; i<ncomp; i++) {
+        for (int j=i; j<ncomp; j++) {
+            const double *a=d+long(i)*Nz, *b=d+long(j)*Nz;
+            double s=0;
+            for (int k=0; k<n; k++) {
+                s+=a[k]*b[k];
+            }
+            T[c++]+=s;
+        }
+    }
+    for (int i=0; i<ncomp and tensor_order==3; i++) {
+        for (int j=i; j<ncomp; j++) {
+            for (int l=j; l<ncomp; l++) {
+                const double *a=d+long(i)*Nz, *b=d+long(j)*Nz, *e=d+long(l)*Nz;
+                double s=0;
+                for (int k=0; k<n; k++) {
+                    s+=a[k]*b[k]*e[k];
+                }
+                T[c++]+=s;
+            }
         }
-        else {
-            if (longitudinal) {
-                SFunc_long_2D(V1_2D, V3_2D);
-            } 
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add a row of velocity increments to the sums of a variant (see add_row()), and to its tensors if any.
+ *
+ *          The tensors are summed over the whole domain, also when the rows are split at the boundaries of the sub-blocks.
+ *
+ * \param v is the variant.
+ * \param dpll, dperp are the rows of longitudinal and transverse increments.
+ * \param du stores the rows of the components of the increments, \f$ N_z \f$ elements apart (used only with tensors).
+ * \param t is a scratch row.
+ * \param n is the length of the rows.
+ * \param block is the sub-block of the base points of the rows.
+ * \param ncomp is the number of components of the velocity field.
+ ********************************************************************************************************************************************
+ */
+inline void add_velocity_row(lag_variant& v, const double* dpll, const double* dperp, const double* du, double* t, int n, int block,
+                             int ncomp) {
+    add_row(v, dpll, dperp, t, n, block);
+    if (v.T != NULL) {
+        add_tensor(v.T, du, n, ncomp);
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to reset the sums of the tensors of all the slots of a displacement vector and to attach them to its variants.
+ *
+ * \param Sten stores the sums of the tensors, tensor_count() components per slot, or is NULL.
+ * \param v stores the variants computed.
+ * \param nv is the number of variants computed.
+ ********************************************************************************************************************************************
+ */
+void set_tensor(double* Sten, lag_variant v[4], int nv) {
+    if (Sten == NULL) {
+        return;
+    }
+    for (int p=0; p<lag_signs()*tensor_count(); p++) {
+        Sten[p]=0;
+    }
+    for (int n=0; n<nv; n++) {
+        v[n].T=Sten+v[n].slot*tensor_count();
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to normalize the sums of the tensors by the numbers of pairs of the variants, and to fill the slots of the variants
+ *          that were not computed (see finish_variants()).
+ *
+ * \param y, z are the (nonnegative) \f$ y \f$ and \f$ z \f$ components of the displacement vector in grid units.
+ * \param Sten stores the sums of the tensors, or is NULL.
+ * \param v stores the variants computed.
+ * \param nv is the number of variants computed.
+ ********************************************************************************************************************************************
+ */
+void finish_tensor(int y, int z, double* Sten, const lag_variant v[4], int nv) {
+    if (Sten == NULL) {
+        return;
+    }
+    int nt=tensor_count();
+    for (int n=0; n<nv; n++) {
+        for (int p=0; p<nt and v[n].count>0; p++) {
+            v[n].T[p]/=v[n].count;
+        }
+    }
+    for (int s=0; s<lag_signs(); s++) {
+        int c=computed_slot(s, y, z);
+        for (int p=0; p<nt and c != s; p++) {
+            Sten[s*nt+p]=Sten[c*nt+p];
+        }
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the contribution of a pair of \f$ x \f$-planes to the velocity structure functions of a 3D field.
+ *
+ *          The planes are the \f$ (y,z) \f$ planes at \f$ x \f$ and \f$ x + l_x \f$, each with \f$ N_y \times N_z \f$ points. The increments
+ *          are computed row by row along \f$ z \f$ without temporary 3D arrays, and the powers are added to the sums (the sums are not
+ *          normalized). With a mask, only the segments of valid pairs given by mask_segments are visited. The transverse structure
+ *          functions are computed only if S2 is not NULL. With block_switch, the powers are added to the records of the sub-blocks of
+ *          the base points \f$ (i_1, y, z) \f$ instead.
+ *
+ *          The sign variants of the displacement vector are computed together: the variants \f$ (\pm l_y, \pm l_z) \f$ pair the rows
+ *          \f$ y \f$ and \f$ y + |l_y| \f$ of the two planes in the four possible ways, so that the four rows are loaded once for all the
+ *          variants.
+ *
+ * \param u1 stores the pointers to the three velocity components on the first plane.
+ * \param u2 stores the pointers to the three velocity components on the second plane.
+ * \param i1, i2 are the \f$ x \f$ indices of the two planes.
+ * \param v stores the variants of the displacement vector, whose sums and numbers of pairs are updated.
+ * \param nv is the number of variants.
+ * \param rows is a scratch buffer of \f$ 3 N_z \f$ elements, or \f$ 6 N_z \f$ elements if the variants have tensors.
+ ********************************************************************************************************************************************
+ */
+void SF_velocity_planes_3D(const double* const u1[3], const double* const u2[3], int i1, int i2, lag_variant* v, int nv,
+                           double* rows) {
+    if (nv == 0) {
+        return;
+    }
+    int y=abs(v[0].y), z=abs(v[0].z);
+    int nz=Nz-z;
+    double *dpll=rows, *dperp=rows+Nz, *t=rows+2*Nz, *du_row=rows+3*Nz;
+    for (int j=0; j<Ny-y; j++) {
+        for (int s=0; s<nv; s++) {
+            //A negative component swaps the roles of the two rows (or of the two points of a row)
+            int j1=(v[s].y < 0) ? j+y : j, j2=(v[s].y < 0) ? j : j+y;
+            int k1=(v[s].z < 0) ? z : 0, k2=(v[s].z < 0) ? 0 : z;
+            long a=long(j1)*Nz+k1;
+            long b=long(j2)*Nz+k2;
+            long r1=long(i1)*Ny+j1, r2=long(i2)*Ny+j2;
+            mask_segments seg((v[s].z < 0) ? r2 : r1, (v[s].z < 0) ? r1 : r2, z, nz, k1);
+            const double* e=v[s].e;
+            int n=0, ka, kb, block=0;
+            while (seg.next(ka, kb)) {
+                int next=block_index(i1, j1, k1+ka);
+                if (next != block and n > 0) {
+                    add_velocity_row(v[s], dpll, dperp, du_row, t, n, block, 3);
+                    n=0;
+                }
+                block=next;
+                for (int k=ka; k<kb; k++) {
+                    double du=u2[0][b+k]-u1[0][a+k];
+                    double dv=u2[1][b+k]-u1[1][a+k];
+                    double dw=u2[2][b+k]-u1[2][a+k];
+                    double pll=du*e[0]+dv*e[1]+dw*e[2];
+                    dpll[n+k-ka]=pll;
+                    if (v[s].T != NULL) {
+                        du_row[n+k-ka]=du;
+                        du_row[Nz+n+k-ka]=dv;
+                        du_row[2*Nz+n+k-ka]=dw;
+                    }
+                    if (v[s].S2 != NULL) {
+                        du-=pll*e[0];
+                        dv-=pll*e[1];
+                        dw-=pll*e[2];
+                        dperp[n+k-ka]=sqrt(du*du+dv*dv+dw*dw);
+                    }
+                }
+                n+=kb-ka;
+            }
+            add_velocity_row(v[s], dpll, dperp, du_row, t, n, block, 3);
+        }
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the powers of the rows of increments of all the scalar fields to the sums of a variant.
+ *
+ * \param v is the variant of the first field; the variant of the field \f$ f \f$ is v[f*nv].
+ * \param nv is the number of variants per field.
+ * \param d stores the rows of increments of the fields, \f$ N_z \f$ elements apart.
+ * \param t is a scratch row.
+ * \param n is the length of the rows.
+ * \param block is the sub-block of the base points of the rows.
+ ********************************************************************************************************************************************
+ */
+inline void add_scalar_rows(lag_variant* v, int nv, const double* d, double* t, int n, int block) {
+    for (int f=0; f<scalar_count; f++) {
+        add_row(v[f*nv], d+long(f)*Nz, NULL, t, n, block);
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the contribution of a pair of \f$ x \f$-planes to the structure functions of the 3D scalar fields.
+ *
+ *          The sign variants of the displacement vector are computed together as in SF_velocity_planes_3D(). The segments of valid pairs
+ *          of a row are found once for all the scalar fields, whose increments are stored one row after the other.
+ *
+ * \param T1 stores the pointers to the scalar fields on the first plane.
+ * \param T2 stores the pointers to the scalar fields on the second plane.
+ * \param i1, i2 are the \f$ x \f$ indices of the two planes.
+ * \param v stores the variants of the displacement vector for every field (see set_scalar_variants()), whose sums and numbers of pairs
+ *        are updated.
+ * \param nv is the number of variants per field.
+ * \param rows is a scratch buffer of \f$ (n_f + 1) N_z \f$ elements for \f$ n_f \f$ scalar fields.
+ ********************************************************************************************************************************************
+ */
+void SF_scalar_planes_3D(const double* const* T1, const double* const* T2, int i1, int i2, lag_variant* v, int nv, double* rows) {
+    if (nv == 0) {
+        return;
+    }
+    int y=abs(v[0].y), z=abs(v[0].z);
+    int nz=Nz-z;
+    double *d=rows, *t=rows+long(scalar_count)*Nz;
+    for (int j=0; j<Ny-y; j++) {
+        for (int s=0; s<nv; s++) {
+            int j1=(v[s].y < 0) ? j+y : j, j2=(v[s].y < 0) ? j : j+y;
+            int k1=(v[s].z < 0) ? z : 0, k2=(v[s].z < 0) ? 0 : z;
+            long a=long(j1)*Nz+k1;
+            long b=long(j2)*Nz+k2;
+            long r1=long(i1)*Ny+j1, r2=long(i2)*Ny+j2;
+            mask_segments seg((v[s].z < 0) ? r2 : r1, (v[s].z < 0) ? r1 : r2, z, nz, k1);
+            int n=0, ka, kb, block=0;
+            while (seg.next(ka, kb)) {
+                int next=block_index(i1, j1, k1+ka);
+                if (next != block and n > 0) {
+                    add_scalar_rows(v+s, nv, d, t, n, block);
+                    n=0;
+                }
+                block=next;
+                for (int f=0; f<scalar_count; f++) {
+                    const double *f1=T1[f]+a+ka, *f2=T2[f]+b+ka;
+                    double *dn=d+long(f)*Nz+n;
+                    for (int k=0; k<kb-ka; k++) {
+                        dn[k]=f2[k]-f1[k];
+                    }
+                }
+                n+=kb-ka;
+            }
+            add_scalar_rows(v+s, nv, d, t, n, block);
+        }
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the velocity structure functions of a 3D field for one displacement vector (and its sign variants with
+ *          signed lags).
+ *
+ *          The transverse structure functions are computed only if Sperp is not NULL.
+ *
+ * \param Ux is a 3D array representing the x-component of velocity field
+ * \param Uy is a 3D array representing the y-component of velocity field
+ * \param Uz is a 3D array representing the z-component of velocity field
+ * \param Wx, Wy, Wz are the components of the velocity field at the second point of the pairs (the same arrays as Ux, Uy, Uz, except
+ *        for the space-time structure functions).
+ * \param x, y, z are the components of the displacement vector in grid units.
+ * \param Spll stores the longitudinal structure functions of orders \f$ q_1 \f$ to \f$ q_2 \f$ of every slot of lag_signs().
+ * \param Sperp stores the transverse structure functions of orders \f$ q_1 \f$ to \f$ q_2 \f$ of every slot, or is NULL.
+ * \param Sten stores the tensors of the velocity increments of every slot (see tensor_count()), or is NULL.
+ * \param Np stores the number of pairs of points (inside the mask) of every slot.
+ * \param B stores the records of the sub-blocks with block_switch, or is NULL.
+ * \param rows is a scratch buffer of \f$ 3 N_z \f$ elements, or \f$ 6 N_z \f$ elements with tensors.
+ *
+ * \return  The number of pairs of points of the variants computed.
+ ********************************************************************************************************************************************
+ */
+long SF_velocity_lag_3D(Array<double,3> Ux, Array<double,3> Uy, Array<double,3> Uz, Array<double,3> Wx, Array<double,3> Wy,
+                        Array<double,3> Wz, int x, int y, int z, double* Spll, double* Sperp, double* Sten, double* Np, double* B,
+                        double* rows) {
+    lag_variant v[4];
+    int nv=set_variants(x, y, z, Spll, Sperp, B, v);
+    set_tensor(Sten, v, nv);
+
+    long plane=long(Ny)*Nz;
+    for (int i=0; i<Nx-x and nv>0; i++) {
+        const double* u1[3]={Ux.data()+i*plane, Uy.data()+i*plane, Uz.data()+i*plane};
+        const double* u2[3]={Wx.data()+(i+x)*plane, Wy.data()+(i+x)*plane, Wz.data()+(i+x)*plane};
+        SF_velocity_planes_3D(u1, u2, i, i+x, v, nv, rows);
+    }
+    finish_tensor(y, z, Sten, v, nv);
+    return finish_variants(y, z, Spll, Sperp, Np, v, nv);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the velocity structure functions of a 2D field for one displacement vector (and its sign variant with
+ *          signed lags).
+ *
+ * \param Ux is a 2D array representing the x-component of velocity field
+ * \param Uz is a 2D array representing the z-component of velocity field
+ * \param Wx, Wz are the components of the velocity field at the second point of the pairs (the same arrays as Ux, Uz, except for the
+ *        space-time structure functions).
+ * \param x, z are the components of the displacement vector in grid units.
+ * \param Spll stores the longitudinal structure functions of orders \f$ q_1 \f$ to \f$ q_2 \f$ of every slot of lag_signs().
+ * \param Sperp stores the transverse structure functions of orders \f$ q_1 \f$ to \f$ q_2 \f$ of every slot, or is NULL.
+ * \param Sten stores the tensors of the velocity increments of every slot (see tensor_count()), or is NULL.
+ * \param Np stores the number of pairs of points (inside the mask) of every slot.
+ * \param B stores the records of the sub-blocks with block_switch, or is NULL.
+ * \param rows is a scratch buffer of \f$ 3 N_z \f$ elements, or \f$ 5 N_z \f$ elements with tensors.
+ *
+ * \return  The number of pairs of points of the variants computed.
+ ********************************************************************************************************************************************
+ */
+long SF_velocity_lag_2D(Array<double,2> Ux, Array<double,2> Uz, Array<double,2> Wx, Array<double,2> Wz, int x, int z, double* Spll,
+                        double* Sperp, double* Sten, double* Np, double* B, double* rows) {
+    lag_variant v[4];
+    int nv=set_variants(x, 0, z, Spll, Sperp, B, v);
+    set_tensor(Sten, v, nv);
+    int nz=Nz-z;
+    double *dpll=rows, *dperp=rows+Nz, *t=rows+2*Nz, *du_row=rows+3*Nz;
+
+    const double *ux=Ux.data(), *uz=Uz.data(), *wx=Wx.data(), *wz=Wz.data();
+    for (int i=0; i<Nx-x; i++) {
+        for (int s=0; s<nv; s++) {
+            int k1=(v[s].z < 0) ? z : 0, k2=(v[s].z < 0) ? 0 : z;
+            long a=long(i)*Nz+k1;
+            long b=long(i+x)*Nz+k2;
+            mask_segments seg((v[s].z < 0) ? i+x : i, (v[s].z < 0) ? i : i+x, z, nz, k1);
+            double ex=v[s].e[0], ez=v[s].e[2];
+            int n=0, ka, kb, block=0;
+            while (seg.next(ka, kb)) {
+                int next=block_index(i, 0, k1+ka);
+                if (next != block and n > 0) {
+                    add_velocity_row(v[s], dpll, dperp, du_row, t, n, block, 2);
+                    n=0;
+                }
+                block=next;
+                for (int k=ka; k<kb; k++) {
+                    double du=wx[b+k]-ux[a+k];
+                    double dw=wz[b+k]-uz[a+k];
+                    double pll=du*ex+dw*ez;
+                    dpll[n+k-ka]=pll;
+                    if (Sten != NULL) {
+                        du_row[n+k-ka]=du;
+                        du_row[Nz+n+k-ka]=dw;
+                    }
+                    if (Sperp != NULL) {
+                        du-=pll*ex;
+                        dw-=pll*ez;
+                        dperp[n+k-ka]=sqrt(du*du+dw*dw);
+                    }
+                }
+                n+=kb-ka;
+            }
+            add_velocity_row(v[s], dpll, dperp, du_row, t, n, block, 2);
+        }
+    }
+    finish_tensor(0, z, Sten, v, nv);
+    return finish_variants(0, z, Spll, Sperp, Np, v, nv);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to set the sign variants of a displacement vector for all the scalar fields (see set_variants()).
+ *
+ *          The variants of the field \f$ f \f$ are v[f*nv] to v[f*nv+nv-1], and its sums are stored after those of the previous fields,
+ *          lag_signs() \f$ (q_2-q_1+1) \f$ elements apart. The records of the sub-blocks are shared by all the fields.
+ *
+ * \param x, y, z are the (nonnegative) components of the displacement vector in grid units.
+ * \param St stores the sums for the structure functions of all the fields.
+ * \param B stores the records of the sub-blocks with block_switch, or is NULL.
+ * \param v stores the variants to be computed, 4 per field.
+ *
+ * \return  The number of variants per field.
+ ********************************************************************************************************************************************
+ */
+int set_scalar_variants(int x, int y, int z, double* St, double* B, lag_variant* v) {
+    int stride=lag_signs()*(q2-q1+1);
+    int nv=set_variants(x, y, z, St, NULL, B, v);
+    for (int f=1; f<scalar_count; f++) {
+        set_variants(x, y, z, St+f*stride, NULL, NULL, v+f*nv);
+        for (int n=0; n<nv; n++) {
+            v[f*nv+n].B=B;
+            v[f*nv+n].field=f;
+        }
+    }
+    return nv;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to normalize the sums of all the scalar fields (see finish_variants()).
+ *
+ * \return  The number of pairs of points of the variants computed, counted once for all the fields.
+ ********************************************************************************************************************************************
+ */
+long finish_scalar_variants(int y, int z, double* St, double* Np, const lag_variant* v, int nv) {
+    int stride=lag_signs()*(q2-q1+1);
+    long count=finish_variants(y, z, St, NULL, Np, v, nv);
+    for (int f=1; f<scalar_count; f++) {
+        finish_variants(y, z, St+f*stride, NULL, Np, v+f*nv, nv);
+    }
+    return count;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the structure functions of the 3D scalar fields for one displacement vector (and its sign variants with
+ *          signed lags).
+ *
+ * \param T stores the 3D arrays of the scalar fields.
+ * \param W stores the scalar fields at the second point of the pairs (the same arrays as T, except for the space-time structure
+ *        functions).
+ * \param x, y, z are the components of the displacement vector in grid units.
+ * \param St stores the structure functions of orders \f$ q_1 \f$ to \f$ q_2 \f$ of every slot of lag_signs(), one field after the
+ *        other.
+ * \param Np stores the number of pairs of points (inside the mask) of every slot.
+ * \param B stores the records of the sub-blocks with block_switch, or is NULL.
+ * \param rows is a scratch buffer of \f$ (n_f + 1) N_z \f$ elements for \f$ n_f \f$ scalar fields.
+ *
+ * \return  The number of pairs of points of the variants computed.
+ ********************************************************************************************************************************************
+ */
+long SF_scalar_lag_3D(const Array<double,3>* T, const Array<double,3>* W, int x, int y, int z, double* St, double* Np, double* B,
+                      double* rows) {
+    vector<lag_variant> v(4*scalar_count);
+    int nv=set_scalar_variants(x, y, z, St, B, v.data());
+
+    long plane=long(Ny)*Nz;
+    vector<const double*> T1(scalar_count), T2(scalar_count);
+    for (int i=0; i<Nx-x and nv>0; i++) {
+        for (int f=0; f<scalar_count; f++) {
+            T1[f]=T[f].data()+i*plane;
+            T2[f]=W[f].data()+(i+x)*plane;
+        }
+        SF_scalar_planes_3D(T1.data(), T2.data(), i, i+x, v.data(), nv, rows);
+    }
+    return finish_scalar_variants(y, z, St, Np, v.data(), nv);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the structure functions of the 2D scalar fields for one displacement vector (and its sign variant with
+ *          signed lags).
+ *
+ * \param T stores the 2D arrays of the scalar fields.
+ * \param W stores the scalar fields at the second point of the pairs (the same arrays as T, except for the space-time structure
+ *        functions).
+ * \param x, z are the components of the displacement vector in grid units.
+ * \param St stores the structure functions of orders \f$ q_1 \f$ to \f$ q_2 \f$ of every slot of lag_signs(), one field after the
+ *        other.
+ * \param Np stores the number of pairs of points (inside the mask) of every slot.
+ * \param B stores the records of the sub-blocks with block_switch, or is NULL.
+ * \param rows is a scratch buffer of \f$ (n_f + 1) N_z \f$ elements for \f$ n_f \f$ scalar fields.
+ *
+ * \return  The number of pairs of points of the variants computed.
+ ********************************************************************************************************************************************
+ */
+long SF_scalar_lag_2D(const Array<double,2>* T, const Array<double,2>* W, int x, int z, double* St, double* Np, double* B,
+                      double* rows) {
+    vector<lag_variant> v(4*scalar_count);
+    int nv=set_scalar_variants(x, 0, z, St, B, v.data());
+    int nz=Nz-z;
+    double *d=rows, *t=rows+long(scalar_count)*Nz;
+
+    for (int i=0; i<Nx-x; i++) {
+        for (int s=0; s<nv; s++) {
+            int k1=(v[s].z < 0) ? z : 0, k2=(v[s].z < 0) ? 0 : z;
+            long a=long(i)*Nz+k1;
+            long b=long(i+x)*Nz+k2;
+            mask_segments seg((v[s].z < 0) ? i+x : i, (v[s].z < 0) ? i : i+x, z, nz, k1);
+            int n=0, ka, kb, block=0;
+            while (seg.next(ka, kb)) {
+                int next=block_index(i, 0, k1+ka);
+                if (next != block and n > 0) {
+                    add_scalar_rows(&v[s], nv, d, t, n, block);
+                    n=0;
+                }
+                block=next;
+                for (int f=0; f<scalar_count; f++) {
+                    const double *field=T[f].data(), *second=W[f].data();
+                    double *dn=d+long(f)*Nz+n;
+                    for (int k=ka; k<kb; k++) {
+                        dn[k-ka]=second[b+k]-field[a+k];
+                    }
+                }
+                n+=kb-ka;
+            }
+            add_scalar_rows(&v[s], nv, d, t, n, block);
+        }
+    }
+    return finish_scalar_variants(0, z, St, Np, v.data(), nv);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the contribution of a group of grid lines to the structure functions of the axes only mode.
+ *
+ *          A line starts at a point of the boundary and follows the direction \f$ \mathbf{n} \f$ of the displacement vectors across the
+ *          domain. The group is made of adjacent lines (consecutive in \f$ z \f$), which are copied into a contiguous buffer in one sweep,
+ *          so that every cache line of the field is used entirely even when the lines are strided in memory. All the displacements
+ *          \f$ m \mathbf{n} \f$ are then computed from the buffer, with unit-stride loops for every \f$ m \f$. The sums are not normalized.
+ *
+ * \param f stores the pointers to the components of the field (the scalar field first for scalars; NULL for a missing component).
+ * \param start is the offset of the first point of the first line.
+ * \param step is the offset between consecutive points of a line.
+ * \param len is the number of points of every line.
+ * \param nlines is the number of lines of the group.
+ * \param e is the unit vector along \f$ \mathbf{n} \f$.
+ * \param L is the number of displacements \f$ m \f$ to be computed.
+ * \param Spll stores the sums for the longitudinal (or scalar) structure functions, \f$ q_2-q_1+1 \f$ orders per displacement.
+ * \param Sperp stores the sums for the transverse structure functions, or is NULL.
+ * \param buf is a scratch buffer of \f$ 3 \times \f$ nlines \f$ \times \f$ len elements.
+ * \param rows is a scratch buffer of \f$ 3 \times \f$ len elements.
+ *
+ * \return  The number of pairs of points.
+ ********************************************************************************************************************************************
+ */
+long SF_axes_lines(const double* const f[3], long start, long step, int len, int nlines, const double e[3], int L,
+                   double* Spll, double* Sperp, double* buf, double* rows) {
+    int ncomp=scalar_switch ? 1 : 3;
+    int nq=q2-q1+1;
+    for (int c=0; c<ncomp; c++) {
+        double* b=buf+long(c)*nlines*len;
+        for (int t=0; t<len; t++) {
+            long o=start+t*step;
+            for (int l=0; l<nlines; l++) {
+                b[long(l)*len+t]=(f[c]==NULL) ? 0 : f[c][o+l];
+            }
+        }
+    }
+
+    long count=0;
+    double *dpll=rows, *dperp=rows+len, *t=rows+2*len;
+    for (int l=0; l<nlines; l++) {
+        const double* u=buf+long(l)*len;
+        const double* v=u+long(nlines)*len;
+        const double* w=v+long(nlines)*len;
+        for (int m=1; m<min(L, len); m++) {
+            int n=len-m;
+            if (scalar_switch) {
+                for (int k=0; k<n; k++) {
+                    dpll[k]=u[k+m]-u[k];
+                }
+            }
             else {
-                SFunc2D(V1_2D, V3_2D);
+                for (int k=0; k<n; k++) {
+                    double du=u[k+m]-u[k];
+                    double dv=v[k+m]-v[k];
+                    double dw=w[k+m]-w[k];
+                    double pll=du*e[0]+dv*e[1]+dw*e[2];
+                    dpll[k]=pll;
+                    if (Sperp != NULL) {
+                        du-=pll*e[0];
+                        dv-=pll*e[1];
+                        dw-=pll*e[2];
+                        dperp[k]=sqrt(du*du+dv*dv+dw*dw);
+                    }
+                }
             }
+            add_powers(dpll, t, n, Spll+m*nq);
+            if (Sperp != NULL) {
+                add_powers(dperp, t, n, Sperp+m*nq);
+            }
+            count+=n;
         }
     }
-    
+    return count;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to open the dataset of an input field for reading it plane by plane.
+ *
+ *          The hdf5 file should have only one dataset, and the names of the hdf5 file and the dataset must be identical.
+ *
+ * \param   fold is the name of the folder in which the input files are kept.
+ * \param   file is a string storing the name of the file to be read.
+ * \param   file_id stores the identifier of the opened file, to be closed by the caller.
+ *
+ * \return  The identifier of the dataset, to be closed by the caller.
+ ********************************************************************************************************************************************
+ */
+hid_t open_field(string fold, string file, hid_t& file_id) {
+    file_id = H5Fopen((fold+file+".h5").c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    hid_t dataset = -1;
+    if (file_id >= 0) {
+        dataset = H5Dopen2(file_id, file.c_str(), H5P_DEFAULT);
+    }
+    if (dataset < 0) {
+        cerr<<"ERROR! Unable to open the dataset "<<file<<" in "<<fold+file+".h5. Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+    return dataset;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to read the \f$ (y,z) \f$ plane at a given \f$ x \f$ index of a 3D field using a hyperslab selection.
+ *
+ *          Since the fields are stored in row-major order, the plane is a contiguous block of the dataset.
+ *
+ * \param   dataset is the identifier of the dataset.
+ * \param   i is the \f$ x \f$ index of the plane.
+ * \param   plane stores the \f$ N_y \times N_z \f$ values of the plane.
+ ********************************************************************************************************************************************
+ */
+void read_plane(hid_t dataset, int i, double* plane) {
+    hsize_t start[3]={hsize_t(i), 0, 0};
+    hsize_t count[3]={1, hsize_t(Ny), hsize_t(Nz)};
+    hid_t filespace=H5Dget_space(dataset);
+    H5Sselect_hyperslab(filespace, H5S_SELECT_SET, start, NULL, count, NULL);
+    hid_t memspace=H5Screate_simple(3, count, NULL);
+    herr_t status=H5Dread(dataset, H5T_NATIVE_DOUBLE, memspace, filespace, H5P_DEFAULT, plane);
+    H5Sclose(memspace);
+    H5Sclose(filespace);
+    if (status < 0) {
+        cerr<<"ERROR! Unable to read the plane "<<i<<" of an input field. Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to decide whether a point is inside the mask.
+ *
+ * \param   v is the value of the mask field (or of the scalar field for the conditional structure functions) at the point.
+ ********************************************************************************************************************************************
+ */
+inline bool in_mask(double v) {
+    if (mask_condition==1) {
+        return v > mask_threshold;
+    }
+    if (mask_condition==2) {
+        return v < mask_threshold;
+    }
+    return v != 0;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to append the runs of the points inside the mask of consecutive rows along \f$ z \f$ to the skip indices.
+ *
+ * \param   v stores the values of the mask field on the rows.
+ * \param   nrows is the number of rows.
+ ********************************************************************************************************************************************
+ */
+void append_mask_runs(const double* v, long nrows) {
+    for (long r=0; r<nrows; r++) {
+        const double* row=v+r*Nz;
+        int k=0;
+        while (k < Nz) {
+            while (k < Nz and not in_mask(row[k])) {
+                k++;
+            }
+            if (k == Nz) {
+                break;
+            }
+            int first=k;
+            while (k < Nz and in_mask(row[k])) {
+                k++;
+            }
+            mask_runs.push_back(first);
+            mask_runs.push_back(k);
+        }
+        mask_rows.push_back(mask_runs.size());
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to read the mask and to build the skip indices.
+ *
+ *          The mask is read from in/mask.h5 (or from the scalar field T.Fr.h5 of the input folder for the conditional structure functions), plane by plane
+ *          for 3D fields. Only the runs of consecutive points inside the mask along \f$ z \f$ are kept, so that the memory needed is small
+ *          for sparse masks and the structure functions skip the points outside the mask instead of multiplying them by zero.
+ ********************************************************************************************************************************************
+ */
+void read_mask() {
+    string name=(mask_condition==0) ? "mask" : "T.Fr";
+    string fold=(mask_condition==0) ? "in/" : in_folder;
+    mask_runs.clear();
+    mask_rows.assign(1, 0);
+    if (two_dimension_switch) {
+        Array<double,2> M(Nx, Nz);
+        read_2D(M, fold, name);
+        append_mask_runs(M.data(), Nx);
+    }
+    else {
+        hid_t file_id;
+        hid_t dataset=open_field(fold, name, file_id);
+        vector<double> plane(long(Ny)*Nz);
+        for (int i=0; i<Nx; i++) {
+            read_plane(dataset, i, plane.data());
+            append_mask_runs(plane.data(), Ny);
+        }
+        H5Dclose(dataset);
+        H5Fclose(file_id);
+    }
+
+    if (rank_mpi==0) {
+        long inside=0;
+        for (size_t r=0; r<mask_runs.size(); r+=2) {
+            inside+=mask_runs[r+1]-mask_runs[r];
+        }
+        long points=long(Nx)*(two_dimension_switch ? 1 : Ny)*Nz;
+        cout<<"Mask read from "<<name<<".h5: "<<100.0*inside/points<<"% of the points inside, in "<<mask_runs.size()/2<<" runs along z\n";
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to calculate the structure functions of 3D fields that are streamed from the disk instead of being held in memory.
+ *
+ *          The input fields are read as \f$ (y,z) \f$ planes, i.e., slabs of unit thickness along \f$ x \f$, which are contiguous in the
+ *          hdf5 files. The \f$ l_x \f$ values of the block of the processor are grouped into passes. In a pass with displacements
+ *          \f$ l_x^{min} \f$ to \f$ l_x^{max} \f$, a window of the planes \f$ x + l_x^{min} \f$ to \f$ x + l_x^{max} \f$ slides along
+ *          \f$ x \f$ together with the base plane \f$ x \f$, so that every plane is read once for the window and once as base plane
+ *          (only once if \f$ l_x^{min} = 0 \f$). The sums of every displacement vector are accumulated as the planes go by and normalized
+ *          at the end. The passes are made as wide as the memory budget allows, which minimizes the number of times the files are read.
+ ********************************************************************************************************************************************
+ */
+void SF_out_of_core_3D() {
+    vector<string> names;
+    if (scalar_switch) {
+        names=scalar_names;
+    }
     else {
+        names.push_back("U.V1r");
+        names.push_back("U.V2r");
+        names.push_back("U.V3r");
+    }
+    int ncomp=names.size();
+    int nq=q2-q1+1;
+    bool perp=(not scalar_switch) and (not longitudinal);
+
+    if (rank_mpi==0) {
         if (scalar_switch) {
-            SF_scalar_3D(T); 
+            cout<<"\nComputing S(lx, ly, lz) using 3D scalar field data streamed from the disk..\n";
+        }
+        else if (perp) {
+            cout<<"\nComputing longitudinal and transverse S(lx, ly, lz) using 3D velocity field data streamed from the disk..\n";
         }
         else {
-            if (longitudinal) {
-                SFunc_long_3D(V1, V2, V3);
-            }
-            else {
-                SFunc3D(V1, V2, V3);
+            cout<<"\nComputing longitudinal S(lx, ly, lz) using 3D velocity field data streamed from the disk..\n";
+        }
+    }
+
+    Array<int,1> X, Y, Z;
+    compute_index_list(X, Y, Z, rank_mpi);
+    int nlx=X.size(), nly=Y.size(), nlz=Z.size();
+    Array<double,4> S1(nlx, nly, nlz, scalar_count*nq);
+    Array<double,4> S2;
+    Array<double,4> Sten(nlx, nly, nlz, tensor_count());
+    Array<double,4> Np(nlx, nly, nlz, 1);
+    S1=0;
+    Sten=0;
+    Np=0;
+    if (perp) {
+        S2.resize(nlx, nly, nlz, nq);
+        S2=0;
+    }
+
+    //Number of planes (of all the components) that fit in the memory budget besides the sums
+    long plane=long(Ny)*Nz;
+    double result_bytes=8.0*(S1.size()+S2.size()+Sten.size()+Np.size());
+    long max_planes=long((memory_budget*1024*1024-result_bytes)/(8.0*plane*ncomp));
+    if (max_planes < 2) {
+        cerr<<"ERROR! The memory budget of "<<memory_budget<<" MB is too small to hold two planes of the input fields on processor "<<rank_mpi<<". Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+
+    vector<hid_t> file_ids(ncomp), datasets(ncomp);
+    for (int c=0; c<ncomp; c++) {
+        datasets[c]=open_field(in_folder, names[c], file_ids[c]);
+    }
+
+    long planes_read=0;
+    int passes=0;
+    int s=0;
+    while (s < nlx) {
+        //Widest pass starting at X(s) that fits in the budget
+        int e=s;
+        while (e+1 < nlx and X(e+1)-X(s)+1+(X(s)>0 ? 1 : 0) <= max_planes) {
+            e++;
+        }
+        int xmin=X(s), xmax=X(e), W=xmax-xmin+1;
+        vector<double> window(long(ncomp)*W*plane);
+        vector<double> base(xmin>0 ? ncomp*plane : 0);
+        long n_lags=long(e-s+1)*nly*nlz;
+
+        #pragma omp parallel
+        {
+            vector<double> rows((scalar_switch ? scalar_count+1 : (tensor_switch ? 6 : 3))*long(Nz));
+            vector<const double*> u1(ncomp), u2(ncomp);
+            vector<lag_variant> v(scalar_count);
+            for (int i=0; i<Nx-xmin; i++) {
+                #pragma omp single
+                {
+                    int first=(i==0) ? xmin : i+xmax;
+                    for (int p=first; p<=min(i+xmax, Nx-1); p++) {
+                        for (int c=0; c<ncomp; c++) {
+                            read_plane(datasets[c], p, &window[(long(c)*W+p%W)*plane]);
+                        }
+                        planes_read++;
+                    }
+                    if (xmin>0) {
+                        for (int c=0; c<ncomp; c++) {
+                            read_plane(datasets[c], i, &base[c*plane]);
+                        }
+                        planes_read++;
+                    }
+                }
+
+                #pragma omp for schedule(dynamic)
+                for (long c=0; c<n_lags; c++) {
+                    int m=s+c/(nly*nlz), j=(c/nlz)%nly, k=c%nlz;
+                    int x=X(m), y=Y(j), z=Z(k);
+                    if (i+x >= Nx or (x==0 and y==0 and z==0)) {
+                        continue;
+                    }
+                    for (int d=0; d<ncomp; d++) {
+                        u1[d]=(xmin>0) ? &base[d*plane] : &window[(long(d)*W+i%W)*plane];
+                        u2[d]=&window[(long(d)*W+(i+x)%W)*plane];
+                    }
+                    //One variant per scalar field (see set_scalar_variants()), or a single one for the velocity field
+                    for (int f=0; f<scalar_count; f++) {
+                        v[f].y=y;
+                        v[f].z=z;
+                        unit_vector(x, y, z, v[f].e);
+                        v[f].slot=0;
+                        v[f].S1=&S1(m,j,k,f*nq);
+                        v[f].S2=perp ? &S2(m,j,k,0) : NULL;
+                        v[f].count=0;
+                        v[f].B=NULL;
+                        v[f].field=f;
+                        v[f].T=tensor_switch ? &Sten(m,j,k,0) : NULL;
+                    }
+                    if (scalar_switch) {
+                        SF_scalar_planes_3D(u1.data(), u2.data(), i, i+x, v.data(), 1, rows.data());
+                    }
+                    else {
+                        SF_velocity_planes_3D(u1.data(), u2.data(), i, i+x, v.data(), 1, rows.data());
+                    }
+                    Np(m,j,k,0)+=v[0].count;
+                }
             }
         }
+        passes++;
+        s=e+1;
     }
-}
 
+    for (int c=0; c<ncomp; c++) {
+        H5Dclose(datasets[c]);
+        H5Fclose(file_ids[c]);
+    }
 
-/**
-*************************************************************************************************************************************
-*\brief     Function to write the structure function arrays to the disk.
-*************************************************************************************************************************************
-*/
-void write_SFs() {
-    if (rank_mpi==0){
-        mkdir("out",0777);
-        int p1 = q1;
-        while (p1 <= q2) {
-            string name = int_to_str(p1);
-            if (two_dimension_switch) {
-                cout<<"\nWriting "<<p1<<" order SF as function of lx and lz\n";
-                if (scalar_switch){
-                    write_3D(SF_Grid2D_scalar,"SF_Grid_scalar"+name, p1);
-                }
-                else {
-                    write_3D(SF_Grid2D_pll,"SF_Grid_pll"+name, p1);    
-                    if (not longitudinal) {
-                        write_3D(SF_Grid2D_perp, "SF_Grid_perp"+name, p1);
-                    }
+    //Normalize the sums by the number of pairs
+    for (int i=0; i<nlx; i++) {
+        for (int j=0; j<nly; j++) {
+            for (int k=0; k<nlz; k++) {
+                double count=Np(i,j,k,0);
+                if (count==0) {
+                    continue;
                 }
-                cout<<"\nWriting completed\n";
-            }
-            else {
-                cout<<"\nWriting "<<p1<<" order SF as function of lx, ly, and ly\n";
-                if (scalar_switch){
-                    write_4D(SF_Grid_scalar,"SF_Grid_scalar"+name, p1);
+                S1(i,j,k,Range::all())/=count;
+                if (perp) {
+                    S2(i,j,k,Range::all())/=count;
                 }
-                else {
-                    write_4D(SF_Grid_pll,"SF_Grid_pll"+name, p1);    
-                    if (not longitudinal) {
-                        write_4D(SF_Grid_perp, "SF_Grid_perp"+name, p1);
-                    }
+                if (tensor_switch) {
+                    Sten(i,j,k,Range::all())/=count;
                 }
-                cout<<"\nWriting completed\n";
+                pair_count+=long(count);
             }
-            p1++;
+        }
+    }
+
+    long max_planes_read, max_passes=passes, all_max_passes;
+    MPI_Reduce(&planes_read, &max_planes_read, 1, MPI_LONG, MPI_MAX, 0, comm_SF);
+    MPI_Reduce(&max_passes, &all_max_passes, 1, MPI_LONG, MPI_MAX, 0, comm_SF);
+    if (rank_mpi==0) {
+        cout<<"Out-of-core schedule: at most "<<all_max_passes<<" passes and "<<max_planes_read<<" planes read per processor ("
+            <<double(max_planes_read)/Nx<<" times the input fields)\n";
+    }
+
+    if (cyl_switch) {
+        count_cylindrical(X, Y, Z, Np);
+        bin_cylindrical(X, Y, Z, S1, Np, scalar_switch ? SF_cyl_scalar : SF_cyl_pll);
+        if (perp) {
+            bin_cylindrical(X, Y, Z, S2, Np, SF_cyl_perp);
+        }
+    }
+    if (harmonic_switch) {
+        project_harmonics(X, Y, Z, S1, scalar_switch ? SF_harm_scalar : SF_harm_pll);
+        if (perp) {
+            project_harmonics(X, Y, Z, S2, SF_harm_perp);
+        }
+    }
+
+    if (mask_switch) {
+        gather_SF(Np, SF_Grid_count);
+    }
+    if (tensor_switch) {
+        gather_SF(Sten, SF_Grid_tensor);
+    }
+    if (scalar_switch) {
+        gather_SF(S1, SF_Grid_scalar);
+    }
+    else {
+        gather_SF(S1, SF_Grid_pll);
+        if (perp) {
+            gather_SF(S2, SF_Grid_perp);
         }
     }
 }
 
 /**
-*************************************************************************************************************************************
-*\brief     Function to test the correctness of the code.
-*************************************************************************************************************************************
-*/
-void test_cases() {
-    cout<<"\nCOMMENCING TESTING OF THE CODE.\n";
-    if(rank_mpi==0){
-        if (scalar_switch){
-            if (two_dimension_switch){
-                SCALAR_TEST_CASE_2D();
-            }
-            else{
-                SCALAR_TEST_CASE_3D();
-            }
+ ********************************************************************************************************************************************
+ * \brief   Function returning the number of lattices of displacement vectors of the progressive mode, and 1 otherwise.
+ *
+ *          The lattice of level \f$ m \f$ has the spacing \f$ 2^m \f$ grid points, from the coarsest one that has a nonzero displacement
+ *          to the full grid of level 0.
+ ********************************************************************************************************************************************
+ */
+int progress_levels() {
+    if (not progress_switch) {
+        return 1;
+    }
+    int lmax=max(max(Nx/2, Ny/2), Nz/2)-1;
+    int n=1;
+    for (int spacing=2; spacing<=lmax; spacing*=2) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the level of a displacement vector: the level of the coarsest lattice containing it, i.e., the largest
+ *          \f$ m \f$ such that \f$ 2^m \f$ divides all its components (the coarsest level for the zero displacement vector).
+ *
+ * \param x, y, z are the (nonnegative) components of the displacement vector in grid units.
+ ********************************************************************************************************************************************
+ */
+int lag_level(int x, int y, int z) {
+    int level=progress_levels()-1;
+    int l[3]={x, y, z};
+    for (int d=0; d<3; d++) {
+        if (l[d] == 0) {
+            continue;
         }
-        else{
-            if (two_dimension_switch){
-                VECTOR_TEST_CASE_2D();
-            }
-            else{
-                VECTOR_TEST_CASE_3D();
+        int m=0;
+        while (m < level and l[d]%(2<<m) == 0) {
+            m++;
+        }
+        level=m;
+    }
+    return level;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to order the displacement vectors of a processor from the coarsest lattice to the finest one.
+ *
+ *          All the processors go through the same levels, so that they can collect the structure functions after every level. Without
+ *          the progressive mode, the order is the natural one in a single level.
+ *
+ * \param X, Y, Z are the displacement vectors of the processor along \f$ x, y, z \f$; the vector \f$ c \f$ is
+ *        \f$ (X(i), Y(j), Z(k)) \f$ with \f$ c = (i n_y + j) n_z + k \f$.
+ * \param order stores the indices \f$ c \f$ of the displacement vectors, level after level.
+ * \param levels stores the start of every level in order, followed by the number of displacement vectors.
+ ********************************************************************************************************************************************
+ */
+void progressive_order(Array<int,1> X, Array<int,1> Y, Array<int,1> Z, vector<long>& order, vector<long>& levels) {
+    int nly=Y.size(), nlz=Z.size();
+    long n_lags=long(X.size())*nly*nlz;
+    int nlevels=progress_levels();
+    order.clear();
+    levels.assign(1, 0);
+    for (int level=nlevels-1; level>=0; level--) {
+        for (long c=0; c<n_lags; c++) {
+            int i=c/(nly*nlz), j=(c/nlz)%nly, k=c%nlz;
+            if (nlevels == 1 or lag_level(X(i), Y(j), Z(k)) == level) {
+                order.push_back(c);
             }
         }
+        levels.push_back(order.size());
     }
-    
 }
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function deciding whether the structure functions are collected after a level: always after the last one, and in the
+ *          progressive mode when progress_interval has elapsed since the last output. The decision of rank 0 is broadcast.
+ *
+ * \param l is the index of the level (from 0 for the coarsest one).
+ * \param nlevels is the number of levels.
+ ********************************************************************************************************************************************
+ */
+bool progress_due(int l, int nlevels) {
+    if (l == nlevels-1) {
+        return true;
+    }
+    int due=0;
+    if (rank_mpi==0) {
+        due=(MPI_Wtime()-progress_time >= progress_interval);
+    }
+    MPI_Bcast(&due, 1, MPI_INT, 0, comm_SF);
+    return due;
+}
 
 /**
-*************************************************************************************************************************************
-*\brief     Function to obtain the \$ x \$ and \$ y \$ ranks of the processor.
-*
-*
-*\param     rank is the rank of the processor.
-*\param     py is the number of processors in \$ y \$ direction.
-*\param     rankx is the \$ x \$ rank of the processor.
-*\param     ranky is the \$ y \$ rank of the processor.
-* 
-*************************************************************************************************************************************
-*/
-void get_rank(int rank, int py, int& rankx, int& ranky){
-    ranky=rank%py;
-    rankx=(rank-ranky)/py;
+ ********************************************************************************************************************************************
+ * \brief   Function to record the level completed after the structure functions have been collected, and to write the intermediate
+ *          output if it is not the last level.
+ *
+ * \param l is the index of the level (from 0 for the coarsest one).
+ * \param nlevels is the number of levels.
+ ********************************************************************************************************************************************
+ */
+void finish_level(int l, int nlevels) {
+    progress_level=nlevels-1-l;
+    if (l == nlevels-1) {
+        return;
+    }
+    if (rank_mpi==0) {
+        cout<<"\nWriting the intermediate structure functions of the lattice of spacing "<<(1<<progress_level)<<" grid points\n";
+    }
+    reduce_binned();
+    write_SFs();
+    if (rank_mpi==0) {
+        progress_time=MPI_Wtime();
+    }
 }
 
 /**
-*************************************************************************************************************************************
-*\brief     Function to allocate the index list along a given direction for a particular rank.
-*           
-*     
-*
-* \param    index_list stores the list of indices.
-* \param    Nx is half of the number of points along the given direction.
-* \param    px is the number of processors along the given direction.
-* \param    rank is the \$ x \$ or \$ y \$ rank of the processor.
-*************************************************************************************************************************************
-*/
-void compute_index_list(Array<int,1>& index_list, int Nx, int px, int rank){
-    int list_size=Nx/px;
-    index_list.resize(list_size);
-    for (int i=0; i<list_size; i+=2){
-        index_list(i)=rank+i*px;
-        if (px!=Nx) {
-          index_list(i+1)=Nx-1-index_list(i);
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the displacement vectors of a processor level after level, shared among the OpenMP threads, and to
+ *          collect the structure functions after the levels selected by progress_due() (see progressive_order()).
+ *
+ * \param X, Y, Z are the displacement vectors of the processor along \f$ x, y, z \f$.
+ * \param nrows is the size of the buffer of rows of every thread.
+ * \param lag computes the displacement vector of index \f$ c \f$ (see progressive_order()) with the buffer of rows of the thread, and
+ *        returns its number of pairs of points.
+ * \param collect bins and gathers the structure functions computed so far.
+ ********************************************************************************************************************************************
+ */
+template <class Lag, class Collect>
+void compute_levels(Array<int,1> X, Array<int,1> Y, Array<int,1> Z, long nrows, Lag lag, Collect collect) {
+    vector<long> order, levels;
+    progressive_order(X, Y, Z, order, levels);
+    long pairs=0;
+    for (size_t l=0; l+1<levels.size(); l++) {
+        #pragma omp parallel reduction(+:pairs)
+        {
+            vector<double> rows(nrows);
+            #pragma omp for schedule(dynamic)
+            for (long n=levels[l]; n<levels[l+1]; n++) {
+                pairs+=lag(order[n], rows);
+            }
+        }
+        if (not progress_due(l, levels.size()-1)) {
+            continue;
         }
+        clear_binned();
+        collect();
+        finish_level(l, levels.size()-1);
     }
+    pair_count+=pairs;
 }
 
-
-
 /**
-*************************************************************************************************************************************
-*\brief     Function to distribute load equally among all the MPI processors.
-*           
-*           
-* \param    index_list stores the matrix of the indices for different ranks.
-* \param    Nx is the number of points along \$ x \$ direction.
-* \param    Ny is the number of points along \$ y \$ (or \$ z \$) direction. 
-*************************************************************************************************************************************
-*/
-void compute_index_list(Array<int,3>& index_list, int Nx, int Ny){
-    int list_size=(Nx*Ny)/(4*P);
-    index_list.resize(list_size,2,P);
+ ********************************************************************************************************************************************
+ * \brief   Function to calculate the longitudinal and transverse structure functions for a 3D velocity field.
+ *
+ *          Every processor computes the block of displacement vectors given by compute_index_list(), with the displacement vectors of the
+ *          block shared among the OpenMP threads. The blocks are collected at rank 0 at the end, and after the coarser lattices of
+ *          displacement vectors in the progressive mode (see progressive_order()).
+ *
+ * \param Ux is a 3D array representing the x-component of velocity field
+ * \param Uy is a 3D array representing the y-component of velocity field
+ * \param Uz is a 3D array representing the z-component of velocity field
+ * \param Wx, Wy, Wz are the components of the velocity field at the second point of the pairs (the same arrays as Ux, Uy, Uz, except
+ *        for the space-time structure functions).
+ ********************************************************************************************************************************************
+ */
+void SFunc3D(
+        Array<double,3> Ux,
+        Array<double,3> Uy,
+        Array<double,3> Uz,
+        Array<double,3> Wx,
+        Array<double,3> Wy,
+        Array<double,3> Wz)
+{
+	if (rank_mpi==0) {
+        cout<<"\nComputing longitudinal and transverse S(lx, ly, lz) using 3D velocity field data..\n";
+    }
+    Array<int,1> X, Y, Z;
+    compute_index_list(X, Y, Z, rank_mpi);
+    int nlx=X.size(), nly=Y.size(), nlz=Z.size();
+    Array<double,4> Spll(nlx, nly, nlz, lag_signs()*(q2-q1+1));
+    Array<double,4> Sperp(nlx, nly, nlz, lag_signs()*(q2-q1+1));
+    Array<double,4> Sten(nlx, nly, nlz, lag_signs()*tensor_count());
+    Array<double,4> Np(nlx, nly, nlz, lag_signs());
+    Array<double,4> B(nlx, nly, nlz, block_switch ? block_number()*block_record() : 0);
+    //The displacement vectors of the lattices not computed yet are zero in the intermediate outputs
+    if (progress_switch) {
+        Spll=0;
+        Sperp=0;
+        Sten=0;
+        Np=0;
+        B=0;
+    }
 
-    int py=(P/px);
-    Array<int,1> x;
-    Array<int,1> y;
-    
-    int rankx,ranky;
-    int nx=Nx/(2*px),ny=Ny/(2*py);
+    compute_levels(X, Y, Z, (tensor_switch ? 6 : 3)*Nz, [&](long c, vector<double>& rows) {
+        Array<double,3> ux=numa_local(Ux), uy=numa_local(Uy), uz=numa_local(Uz);
+        Array<double,3> wx=numa_local(Wx), wy=numa_local(Wy), wz=numa_local(Wz);
+        int i=c/(nly*nlz), j=(c/nlz)%nly, k=c%nlz;
+        return SF_velocity_lag_3D(ux, uy, uz, wx, wy, wz, X(i), Y(j), Z(k), &Spll(i,j,k,0), &Sperp(i,j,k,0),
+                                  tensor_switch ? &Sten(i,j,k,0) : NULL, &Np(i,j,k,0), block_switch ? &B(i,j,k,0) : NULL,
+                                  rows.data());
+    }, [&]() {
+        if (cyl_switch) {
+            count_cylindrical(X, Y, Z, Np);
+            bin_cylindrical(X, Y, Z, Spll, Np, SF_cyl_pll);
+            bin_cylindrical(X, Y, Z, Sperp, Np, SF_cyl_perp);
+        }
+        if (harmonic_switch) {
+            project_harmonics(X, Y, Z, Spll, SF_harm_pll);
+            project_harmonics(X, Y, Z, Sperp, SF_harm_perp);
+        }
 
-    
-    for (int rank_id=0; rank_id<P; rank_id++){
-        get_rank(rank_id, py, rankx, ranky);
-        compute_index_list(x, Nx/2, px, rankx);
-        compute_index_list(y, Ny/2, py, ranky);
-        for (int i=0; i<nx; i++){
-            index_list(Range(ny*i,(i+1)*ny-1),0,rank_id)=x(i);
-            index_list(Range(ny*i,(i+1)*ny-1),1,rank_id)=y(Range::all());
+        if (mask_switch) {
+            gather_SF(Np, SF_Grid_count);
         }
+        if (block_switch) {
+            gather_SF(B, SF_Grid_blocks);
+        }
+        if (tensor_switch) {
+            gather_SF(Sten, SF_Grid_tensor);
+        }
+        gather_SF(Spll, SF_Grid_pll);
+        gather_SF(Sperp, SF_Grid_perp);
+    });
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to calculate only the longitudinal structure functions for a 3D velocity field.
+ *
+ * \param Ux is a 3D array representing the x-component of velocity field
+ * \param Uy is a 3D array representing the y-component of velocity field
+ * \param Uz is a 3D array representing the z-component of velocity field
+ * \param Wx, Wy, Wz are the components of the velocity field at the second point of the pairs (the same arrays as Ux, Uy, Uz, except
+ *        for the space-time structure functions).
+ ********************************************************************************************************************************************
+ */
+void SFunc_long_3D(
+        Array<double,3> Ux,
+        Array<double,3> Uy,
+        Array<double,3> Uz,
+        Array<double,3> Wx,
+        Array<double,3> Wy,
+        Array<double,3> Wz)
+{
+    if (rank_mpi==0) {
+        cout<<"\nComputing longitudinal S(lx, ly, lz) using 3D velocity field data..\n";
+    }
+    Array<int,1> X, Y, Z;
+    compute_index_list(X, Y, Z, rank_mpi);
+    int nlx=X.size(), nly=Y.size(), nlz=Z.size();
+    Array<double,4> Spll(nlx, nly, nlz, lag_signs()*(q2-q1+1));
+    Array<double,4> Sten(nlx, nly, nlz, lag_signs()*tensor_count());
+    Array<double,4> Np(nlx, nly, nlz, lag_signs());
+    Array<double,4> B(nlx, nly, nlz, block_switch ? block_number()*block_record() : 0);
+    //The displacement vectors of the lattices not computed yet are zero in the intermediate outputs
+    if (progress_switch) {
+        Spll=0;
+        Sten=0;
+        Np=0;
+        B=0;
     }
 
+    compute_levels(X, Y, Z, (tensor_switch ? 6 : 3)*Nz, [&](long c, vector<double>& rows) {
+        Array<double,3> ux=numa_local(Ux), uy=numa_local(Uy), uz=numa_local(Uz);
+        Array<double,3> wx=numa_local(Wx), wy=numa_local(Wy), wz=numa_local(Wz);
+        int i=c/(nly*nlz), j=(c/nlz)%nly, k=c%nlz;
+        return SF_velocity_lag_3D(ux, uy, uz, wx, wy, wz, X(i), Y(j), Z(k), &Spll(i,j,k,0), NULL,
+                                  tensor_switch ? &Sten(i,j,k,0) : NULL, &Np(i,j,k,0), block_switch ? &B(i,j,k,0) : NULL,
+                                  rows.data());
+    }, [&]() {
+        if (cyl_switch) {
+            count_cylindrical(X, Y, Z, Np);
+            bin_cylindrical(X, Y, Z, Spll, Np, SF_cyl_pll);
+        }
+        if (harmonic_switch) {
+            project_harmonics(X, Y, Z, Spll, SF_harm_pll);
+        }
 
+        if (mask_switch) {
+            gather_SF(Np, SF_Grid_count);
+        }
+        if (block_switch) {
+            gather_SF(B, SF_Grid_blocks);
+        }
+        if (tensor_switch) {
+            gather_SF(Sten, SF_Grid_tensor);
+        }
+        gather_SF(Spll, SF_Grid_pll);
+    });
 }
 
 
 
+
 /**
  ********************************************************************************************************************************************
- * \brief   Test function to validate the calculation of structure functions of 3D velocity field data.
- *
- *          This function validates the calculation of the structure functions computed using 3D velocity field data. The velocity field is
- *          generated as \f$ \mathbf{u} = x \hat{x} + y \hat{y} + z \hat{z} \f$. For such field, the velocity structure functions of order
- *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_y, l_z) = (\sqrt{l_x^2 + l_y^2 + l_z^2})^q \f$. In this function, the theoretical values
- *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values
- *          is less than \f$1 \times 10^{-10} \f$, the test is passed.
+ * \brief   Function to calculate the longitudinal and transverse structure functions for a 2D velocity field.
  *
+ *        
+ * \param Ux is a 2D array representing the x-component of velocity field
+ * \param Uz is a 2D array representing the z-component of velocity field
+ * \param Wx, Wz are the components of the velocity field at the second point of the pairs (the same arrays as Ux, Uz, except for the
+ *        space-time structure functions).
  ********************************************************************************************************************************************
  */
-void VECTOR_TEST_CASE_3D()
-{	
-    double epsilon=1e-10;
-    double err1 = 0, err2 = 0;
-    double max = 0;
-	Array<double,3> test1,test2;
+ void SFunc2D(
+         Array<double,2> Ux,
+         Array<double,2> Uz,
+         Array<double,2> Wx,
+         Array<double,2> Wz)
+ {
+     if (rank_mpi==0) {
+         cout<<"\nComputing longitudinal and transverse S(lx, lz) using 2D velocity field data..\n";
+     }
+    Array<int,1> X, Y, Z;
+    compute_index_list(X, Y, Z, rank_mpi);
+    int nlx=X.size(), nlz=Z.size();
+    Array<double,3> Spll(nlx, nlz, lag_signs()*(q2-q1+1));
+    Array<double,3> Sperp(nlx, nlz, lag_signs()*(q2-q1+1));
+    Array<double,3> Sten(nlx, nlz, lag_signs()*tensor_count());
+    Array<double,3> Np(nlx, nlz, lag_signs());
+    Array<double,3> B(nlx, nlz, block_switch ? block_number()*block_record() : 0);
+    //The displacement vectors of the lattices not computed yet are zero in the intermediate outputs
+    if (progress_switch) {
+        Spll=0;
+        Sperp=0;
+        Sten=0;
+        Np=0;
+        B=0;
+    }
 
-	if (longitudinal==true){
-		test1.resize(Nx/2,Ny/2,Nz/2);
+    compute_levels(X, Y, Z, (tensor_switch ? 5 : 3)*Nz, [&](long c, vector<double>& rows) {
+        Array<double,2> ux=numa_local(Ux), uz=numa_local(Uz), wx=numa_local(Wx), wz=numa_local(Wz);
+        int i=c/nlz, k=c%nlz;
+        return SF_velocity_lag_2D(ux, uz, wx, wz, X(i), Z(k), &Spll(i,k,0), &Sperp(i,k,0),
+                                  tensor_switch ? &Sten(i,k,0) : NULL, &Np(i,k,0), block_switch ? &B(i,k,0) : NULL,
+                                  rows.data());
+    }, [&]() {
+        if (cyl_switch) {
+            count_cylindrical(X, Y, Z, Np);
+            bin_cylindrical(X, Y, Z, Spll, Np, SF_cyl_pll);
+            bin_cylindrical(X, Y, Z, Sperp, Np, SF_cyl_perp);
+        }
 
-		for (int order=0 ; order<=q2-q1; order++){
-			string name=int_to_str(order+q1);
-			read_3D(test1,"out/","SF_Grid_pll"+name);
-			for (int i=0; i<test1.extent(0); i++){
-				double lx=dx*i;
-				for (int j=0; j<test1.extent(1); j++){
-					double ly=dy*j;
-					for (int k=0; k<test1.extent(2); k++){
-						double lz=dz*k;
-                        if (lx*lx + ly*ly + lz*lz > epsilon) {
-                            err1 = abs((test1(i,j,k)-pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.))/pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.));
-                        }
-                        else {
-                            err1 = abs(test1(i,j,k));
-                        }
+        if (mask_switch) {
+            gather_SF(Np, SF_Grid2D_count);
+        }
+        if (block_switch) {
+            gather_SF(B, SF_Grid2D_blocks);
+        }
+        if (tensor_switch) {
+            gather_SF(Sten, SF_Grid2D_tensor);
+        }
+        gather_SF(Spll, SF_Grid2D_pll);
+        gather_SF(Sperp, SF_Grid2D_perp);
+    });
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to calculate only the longitudinal structure functions for a 2D velocity field.
+ *
+ *         
+ * \param Ux is a 2D array representing the x-component of velocity field
+ * \param Uz is a 2D array representing the z-component of velocity field
+ * \param Wx, Wz are the components of the velocity field at the second point of the pairs (the same arrays as Ux, Uz, except for the
+ *        space-time structure functions).
+ ********************************************************************************************************************************************
+ */
+void SFunc_long_2D(
+         Array<double,2> Ux,
+         Array<double,2> Uz,
+         Array<double,2> Wx,
+         Array<double,2> Wz)
+ {
+     if (rank_mpi==0) {
+         cout<<"\nComputing longitudinal S(lx, lz) using 2D velocity field data..\n";
+     }
+    Array<int,1> X, Y, Z;
+    compute_index_list(X, Y, Z, rank_mpi);
+    int nlx=X.size(), nlz=Z.size();
+    Array<double,3> Spll(nlx, nlz, lag_signs()*(q2-q1+1));
+    Array<double,3> Sten(nlx, nlz, lag_signs()*tensor_count());
+    Array<double,3> Np(nlx, nlz, lag_signs());
+    Array<double,3> B(nlx, nlz, block_switch ? block_number()*block_record() : 0);
+    //The displacement vectors of the lattices not computed yet are zero in the intermediate outputs
+    if (progress_switch) {
+        Spll=0;
+        Sten=0;
+        Np=0;
+        B=0;
+    }
 
-                        if (err1 > max) {
-                            max = err1;
-                        }
+    compute_levels(X, Y, Z, (tensor_switch ? 5 : 3)*Nz, [&](long c, vector<double>& rows) {
+        Array<double,2> ux=numa_local(Ux), uz=numa_local(Uz), wx=numa_local(Wx), wz=numa_local(Wz);
+        int i=c/nlz, k=c%nlz;
+        return SF_velocity_lag_2D(ux, uz, wx, wz, X(i), Z(k), &Spll(i,k,0), NULL,
+                                  tensor_switch ? &Sten(i,k,0) : NULL, &Np(i,k,0), block_switch ? &B(i,k,0) : NULL,
+                                  rows.data());
+    }, [&]() {
+        if (cyl_switch) {
+            count_cylindrical(X, Y, Z, Np);
+            bin_cylindrical(X, Y, Z, Spll, Np, SF_cyl_pll);
+        }
 
+        if (mask_switch) {
+            gather_SF(Np, SF_Grid2D_count);
+        }
+        if (block_switch) {
+            gather_SF(B, SF_Grid2D_blocks);
+        }
+        if (tensor_switch) {
+            gather_SF(Sten, SF_Grid2D_tensor);
+        }
+        gather_SF(Spll, SF_Grid2D_pll);
+    });
+}
 
-					}
-				}
-			}
-		}
 
-	}
-	else{
-        cout<<"\nTESTING BOTH TRANSVERSE AND LONGITUDINAL\n";
-		test1.resize(Nx/2,Ny/2,Nz/2);
-		test2.resize(Nx/2,Ny/2,Nz/2);
-		for (int order=0 ; order<=q2-q1; order++){
-			string name=int_to_str(order+q1);
 
-			read_3D(test1,"out/","SF_Grid_pll"+name);
-			read_3D(test2,"out/","SF_Grid_perp"+name);
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to calculate structure functions for 3D scalar fields.
+ *
+ * \param T stores the 3D arrays representing the scalar fields
+ * \param W stores the scalar fields at the second point of the pairs (the same arrays as T, except for the space-time structure
+ *        functions).
+ ********************************************************************************************************************************************
+ */
 
 
-			for (int i=0; i<test1.extent(0); i++){
-				double lx=dx*i;
-				for (int j=0; j<test1.extent(1); j++){
-					double ly=dy*j;
-					for (int k=0; k<test1.extent(2); k++){
-						double lz=dz*k;
-						if (lx*lx + ly*ly + lz*lz > epsilon) {
-                            err1 = abs((test1(i,j,k)-pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.))/pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.));
-                        }
-                        else {
-                            err1 = abs(test1(i,j,k));
-                        }
-                        err2 = abs(test2(i,j,k));
-                        if (err1 > max) {
-                            max = err1;
-                            
-                        }
+void SF_scalar_3D(
+         vector<Array<double,3> > T,
+         vector<Array<double,3> > W)
+ {
+     if (rank_mpi==0) {
+         cout<<"\nComputing S(lx, ly, lz) using 3D scalar field data..\n";
+     }
+    Array<int,1> X, Y, Z;
+    compute_index_list(X, Y, Z, rank_mpi);
+    int nlx=X.size(), nly=Y.size(), nlz=Z.size();
+    Array<double,4> St(nlx, nly, nlz, scalar_count*lag_signs()*(q2-q1+1));
+    Array<double,4> Np(nlx, nly, nlz, lag_signs());
+    Array<double,4> B(nlx, nly, nlz, block_switch ? block_number()*block_record() : 0);
+    //The displacement vectors of the lattices not computed yet are zero in the intermediate outputs
+    if (progress_switch) {
+        St=0;
+        Np=0;
+        B=0;
+    }
 
-                        if (err2 > max) {
-                            max = err2;
-                    
-                        }
+    compute_levels(X, Y, Z, (scalar_count+1)*Nz, [&](long c, vector<double>& rows) {
+        vector<Array<double,3> > t(scalar_count), w(scalar_count);
+        for (int f=0; f<scalar_count; f++) {
+            t[f].reference(numa_local(T[f]));
+            w[f].reference(numa_local(W[f]));
+        }
+        int i=c/(nly*nlz), j=(c/nlz)%nly, k=c%nlz;
+        return SF_scalar_lag_3D(t.data(), w.data(), X(i), Y(j), Z(k), &St(i,j,k,0), &Np(i,j,k,0),
+                                block_switch ? &B(i,j,k,0) : NULL, rows.data());
+    }, [&]() {
+        if (cyl_switch) {
+            count_cylindrical(X, Y, Z, Np);
+            bin_cylindrical(X, Y, Z, St, Np, SF_cyl_scalar);
+        }
+        if (harmonic_switch) {
+            project_harmonics(X, Y, Z, St, SF_harm_scalar);
+        }
 
-					}
-				}
-			}
+        if (mask_switch) {
+            gather_SF(Np, SF_Grid_count);
+        }
+        if (block_switch) {
+            gather_SF(B, SF_Grid_blocks);
+        }
+        gather_SF(St, SF_Grid_scalar);
+    });
+ }
 
-		}
-	}
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to calculate structure functions for 2D scalar fields.
+ *
+ *
+ * \param T stores the 2D arrays representing the scalar fields
+ * \param W stores the scalar fields at the second point of the pairs (the same arrays as T, except for the space-time structure
+ *        functions).
+ ********************************************************************************************************************************************
+ */
+void SF_scalar_2D(vector<Array<double,2> > T, vector<Array<double,2> > W)
+ {
+     if (rank_mpi==0) {
+         cout<<"\nComputing S(lx, lz) using 2D scalar field data..\n";
+     }
+    Array<int,1> X, Y, Z;
+    compute_index_list(X, Y, Z, rank_mpi);
+    int nlx=X.size(), nlz=Z.size();
+    Array<double,3> St(nlx, nlz, scalar_count*lag_signs()*(q2-q1+1));
+    Array<double,3> Np(nlx, nlz, lag_signs());
+    Array<double,3> B(nlx, nlz, block_switch ? block_number()*block_record() : 0);
+    //The displacement vectors of the lattices not computed yet are zero in the intermediate outputs
+    if (progress_switch) {
+        St=0;
+        Np=0;
+        B=0;
+    }
 
+    compute_levels(X, Y, Z, (scalar_count+1)*Nz, [&](long c, vector<double>& rows) {
+        vector<Array<double,2> > t(scalar_count), w(scalar_count);
+        for (int f=0; f<scalar_count; f++) {
+            t[f].reference(numa_local(T[f]));
+            w[f].reference(numa_local(W[f]));
+        }
+        int i=c/nlz, k=c%nlz;
+        return SF_scalar_lag_2D(t.data(), w.data(), X(i), Z(k), &St(i,k,0), &Np(i,k,0), block_switch ? &B(i,k,0) : NULL,
+                                rows.data());
+    }, [&]() {
+        if (cyl_switch) {
+            count_cylindrical(X, Y, Z, Np);
+            bin_cylindrical(X, Y, Z, St, Np, SF_cyl_scalar);
+        }
 
-	if (max > epsilon){
-		cout<<"\n\nVECTOR_3D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
-	}
-	else{
-		cout<<"\n\nVECTOR_3D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
-	}
+        if (mask_switch) {
+            gather_SF(Np, SF_Grid2D_count);
+        }
+        if (block_switch) {
+            gather_SF(B, SF_Grid2D_blocks);
+        }
+        gather_SF(St, SF_Grid2D_scalar);
+    });
+ }
 
-    cout<<"MAXIMUM PERCENTAGE ERROR: "<<max<<endl<<endl;
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to set the directions of the axes only mode and to allocate the structure functions.
+ *
+ *          The directions are the coordinate axes, to which the face and body diagonals of the grid are added if requested.
+ ********************************************************************************************************************************************
+ */
+void setup_axes() {
+    //Directions coded as 4 n_x + 2 n_y + n_z: the coordinate axes first, then the face and body diagonals
+    int all_codes[7]={4, 2, 1, 6, 5, 3, 7};
+    vector<int> codes;
+    for (int c=0; c<7; c++) {
+        int n=all_codes[c];
+        if (two_dimension_switch and ((n>>1)&1)) {
+            continue;
+        }
+        if (c<3 or diagonals) {
+            codes.push_back(n);
+        }
+    }
+
+    int ndir=codes.size();
+    axes_dirs.resize(ndir, 3);
+    int Lmax=0;
+    for (int d=0; d<ndir; d++) {
+        axes_dirs(d, 0)=(codes[d]>>2)&1;
+        axes_dirs(d, 1)=(codes[d]>>1)&1;
+        axes_dirs(d, 2)=codes[d]&1;
+        Lmax=max(Lmax, axes_lags(d));
+    }
 
+    if (rank_mpi==0) {
+        if (scalar_switch) {
+            SF_axes_scalar.resize(ndir, Lmax, q2-q1+1);
+            SF_axes_scalar=0;
+        }
+        else {
+            SF_axes_pll.resize(ndir, Lmax, q2-q1+1);
+            SF_axes_pll=0;
+            if (not longitudinal) {
+                SF_axes_perp.resize(ndir, Lmax, q2-q1+1);
+                SF_axes_perp=0;
+            }
+        }
+    }
 }
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the number of displacements of a direction of the axes only mode.
+ *
+ * \param d is the index of the direction.
+ *
+ * \return  The number of displacements \f$ m \f$ (including \f$ m = 0 \f$), \f$ N/2 \f$ for the smallest \f$ N \f$ along the direction.
+ ********************************************************************************************************************************************
+ */
+int axes_lags(int d) {
+    int N[3]={Nx, Ny, Nz};
+    int L=-1;
+    for (int a=0; a<3; a++) {
+        if (axes_dirs(d, a) and (L<0 or N[a]/2<L)) {
+            L=N[a]/2;
+        }
+    }
+    return L;
+}
 
 /**
  ********************************************************************************************************************************************
- * \brief   Test function to validate the calculation of structure functions of 2D velocity field data.
+ * \brief   Function to name a direction of the axes only mode, as used for the output files.
  *
- *          This function validates the calculation of the structure functions computed using 2D velocity field data. The velocity field is
- *          generated as \f$ \mathbf{u} = x \hat{x} + z \hat{z} \f$. For such field, the velocity structure functions of order
- *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_z) = (\sqrt{l_x^2 + l_z^2})^q \f$. In this function, the analytically obtained  values
- *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
-            than \f$1 \times 10^{-10} \f$, the test is passed.
+ * \param d is the index of the direction.
  *
+ * \return  "SF_axis_" followed by the axis for the coordinate axes, and "SF_diag_" followed by the axes spanned for the diagonals.
  ********************************************************************************************************************************************
  */
-void VECTOR_TEST_CASE_2D()
-{	
-	double epsilon=1e-10;
-	double max=0;
-	double err1=0, err2 = 0;
-    Array<double,2> test1,test2;
-	int count=0;
+string axes_name(int d) {
+    string name;
+    for (int a=0; a<3; a++) {
+        if (axes_dirs(d, a)) {
+            name+=char('x'+a);
+        }
+    }
+    return (name.size()==1 ? "SF_axis_" : "SF_diag_")+name;
+}
 
-	if (longitudinal==true){
-		test1.resize(Nx/2,Nz/2);
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to calculate the structure functions only for the displacements along the coordinate axes (and diagonals).
+ *
+ *          For every direction \f$ \mathbf{n} \f$, the grid is covered by lines along \f$ \mathbf{n} \f$, and all the displacements
+ *          \f$ m \mathbf{n} \f$ are computed line by line by SF_axes_lines(), which reads every point of the field once per direction. The
+ *          lines are dealt to the processors cyclically and shared among the threads; the sums are reduced and normalized at rank 0.
+ ********************************************************************************************************************************************
+ */
+void SF_axes() {
+    if (rank_mpi==0) {
+        cout<<"\nComputing the structure functions along the "<<(diagonals ? "coordinate axes and diagonals" : "coordinate axes")<<"..\n";
+    }
+    int ny=two_dimension_switch ? 1 : Ny;
+    int N[3]={Nx, ny, Nz};
+    int Nmax=max(Nx, max(ny, Nz));
+    int nq=q2-q1+1;
+    bool perp=(not scalar_switch) and (not longitudinal);
+
+    const double* f[3]={NULL, NULL, NULL};
+    if (scalar_switch) {
+        f[0]=two_dimension_switch ? T_2D.data() : T.data();
+    }
+    else if (two_dimension_switch) {
+        f[0]=V1_2D.data();
+        f[2]=V3_2D.data();
+    }
+    else {
+        f[0]=V1.data();
+        f[1]=V2.data();
+        f[2]=V3.data();
+    }
 
-		for (int order=0 ; order<=q2-q1; order++){
-			string name=int_to_str(order+q1);
-			read_2D(test1,"out/","SF_Grid_pll"+name);
-			for (int i=0; i<test1.extent(0); i++){
-				double lx=dx*i;
-				for (int k=0; k<test1.extent(1); k++){
-					double lz=dz*k;
-                    if ((lx*lx + lz*lz)>epsilon) {
-                        err1 = abs((test1(i,k)-pow(lx*lx+lz*lz,(order+q1)/2.))/pow(lx*lx+lz*lz,(order+q1)/2.));
-                    }
-                    else {
-                        err1 =  abs(test1(i,k));
+    int ndir=axes_dirs.extent(0);
+    int Lmax=0;
+    for (int d=0; d<ndir; d++) {
+        Lmax=max(Lmax, axes_lags(d));
+    }
+    Array<double,3> S1(ndir, Lmax, nq), S2(ndir, Lmax, nq);
+    S1=0;
+    S2=0;
+    long pairs=0;
+
+    for (int d=0; d<ndir; d++) {
+        int n[3]={axes_dirs(d, 0), axes_dirs(d, 1), axes_dirs(d, 2)};
+        int L=axes_lags(d);
+        long step=n[0]*long(ny)*Nz+n[1]*long(Nz)+n[2];
+        double e[3];
+        unit_vector(n[0], n[1], n[2], e);
+        //Lines along directions without z are grouped by 8 consecutive z, i.e. one cache line
+        int group=n[2] ? 1 : 8;
+        long n_starts=long(Nx)*ny;
+
+        #pragma omp parallel reduction(+:pairs)
+        {
+            vector<double> buf(3*group*Nmax), rows(3*Nmax);
+            vector<double> s1(L*nq, 0.0), s2(perp ? L*nq : 0, 0.0);
+            const double* g[3]={numa_local(f[0]), numa_local(f[1]), numa_local(f[2])};
+            #pragma omp for schedule(dynamic, 16)
+            for (long c=rank_mpi; c<n_starts; c+=P) {
+                int i=c/ny, j=c%ny;
+                //A line starts where a step backwards leaves the domain
+                bool edge=(n[0] and i==0) or (n[1] and j==0);
+                if (not edge and not n[2]) {
+                    continue;
+                }
+                int kmax=edge ? Nz : 1;
+                for (int k=0; k<kmax; k+=group) {
+                    int p[3]={i, j, k};
+                    int len=Nmax;
+                    for (int a=0; a<3; a++) {
+                        if (n[a]) {
+                            len=min(len, N[a]-p[a]);
+                        }
                     }
-
-                    if (err1 > max) {
-                        max=err1;
+                    pairs+=SF_axes_lines(g, (long(i)*ny+j)*Nz+k, step, len, min(group, Nz-k), e, L,
+                                         s1.data(), perp ? s2.data() : NULL, buf.data(), rows.data());
+                }
+            }
+            #pragma omp critical
+            {
+                for (int m=0; m<L; m++) {
+                    for (int q=0; q<nq; q++) {
+                        S1(d, m, q)+=s1[m*nq+q];
+                        if (perp) {
+                            S2(d, m, q)+=s2[m*nq+q];
+                        }
                     }
+                }
+            }
+        }
+    }
+    pair_count+=pairs;
 
-				}
-			}
-		}
+    Array<double,3> result=scalar_switch ? SF_axes_scalar : SF_axes_pll;
+    if (rank_mpi==0) {
+        MPI_Reduce(S1.data(), result.data(), S1.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        if (perp) {
+            MPI_Reduce(S2.data(), SF_axes_perp.data(), S2.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        }
+        //Normalize by the number of pairs of every displacement
+        for (int d=0; d<ndir; d++) {
+            for (int m=1; m<axes_lags(d); m++) {
+                double count=1;
+                for (int a=0; a<3; a++) {
+                    count*=N[a]-m*axes_dirs(d, a);
+                }
+                result(d, m, Range::all())/=count;
+                if (perp) {
+                    SF_axes_perp(d, m, Range::all())/=count;
+                }
+            }
+        }
+    }
+    else {
+        MPI_Reduce(S1.data(), NULL, S1.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        if (perp) {
+            MPI_Reduce(S2.data(), NULL, S2.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        }
+    }
+}
 
-	}
-	else{
-		test1.resize(Nx/2,Nz/2);
-		test2.resize(Nx/2,Nz/2);
-		for (int order=0 ; order<=q2-q1; order++){
-			string name=int_to_str(order+q1);
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the number of columns of the particles: the coordinates (\f$ x, z \f$ in 2D and \f$ x, y, z \f$ in 3D),
+ *          followed by the values of the scalar fields or by the velocity components.
+ ********************************************************************************************************************************************
+ */
+int particle_columns() {
+    int nd=two_dimension_switch ? 2 : 3;
+    return nd+(scalar_switch ? scalar_count : nd);
+}
 
-			read_2D(test1,"out/","SF_Grid_pll"+name);
-			read_2D(test2,"out/","SF_Grid_perp"+name);
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to read the particles from the dataset particle_file of the file particle_file.h5 of the input folder, a 2D array with
+ *          one row of particle_columns() elements per particle.
+ ********************************************************************************************************************************************
+ */
+void read_particles() {
+    hid_t file_id;
+    hid_t dataset=open_field(in_folder, particle_file, file_id);
+    hid_t space=H5Dget_space(dataset);
+    hsize_t dims[2]={0, 0};
+    if (H5Sget_simple_extent_ndims(space) != 2) {
+        cerr<<"ERROR! The dataset "<<particle_file<<" of the particles has to be a 2D array. Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+    H5Sget_simple_extent_dims(space, dims, NULL);
+    if (int(dims[1]) != particle_columns()) {
+        cerr<<"ERROR! The dataset "<<particle_file<<" has "<<dims[1]<<" columns instead of "<<particle_columns()<<". Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+    particle_data.resize(dims[0]*dims[1]);
+    if (dims[0] > 0) {
+        H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, particle_data.data());
+    }
+    H5Sclose(space);
+    H5Dclose(dataset);
+    H5Fclose(file_id);
+    if (rank_mpi==0) {
+        cout<<"Read "<<dims[0]<<" particles from "<<particle_file<<".h5\n";
+    }
+}
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the structure functions of scattered particles as functions of the separation \f$ r = |\mathbf{l}| \f$.
+ *
+ *          The particles are sorted into cubic cells of the size of the maximum separation, so that the pairs closer than the maximum
+ *          separation are found in the same cell or in neighbouring cells. Only the occupied cells are stored, in the order of their
+ *          coordinates, and the neighbours of a cell are found by binary search, so that the memory is proportional to the number of
+ *          particles whatever the extent of the particles compared with the maximum separation. Every pair of cells is visited once, from
+ *          the cell of lower coordinates, which takes \f$ O(N n + N \log N) \f$ operations for \f$ N \f$ particles with \f$ n \f$
+ *          neighbours each. The occupied cells are distributed cyclically over the processors, and over their threads. The powers of the increments are summed in equal bins of
+ *          \f$ r \f$ up to the maximum separation, and normalized by the number of pairs of every bin at rank 0.
+ *
+ *          The longitudinal increment does not depend on the order of the two particles. For the scalar increments, the displacement
+ *          vector points to the particle of larger \f$ x \f$ (then \f$ y \f$ and \f$ z \f$), as \f$ l_x \ge 0 \f$ on the grid.
+ ********************************************************************************************************************************************
+ */
+void SF_particles() {
+    if (rank_mpi==0) {
+        cout<<"\nComputing S(r) using the particles..\n";
+    }
+    int nd=two_dimension_switch ? 2 : 3;
+    int nc=particle_columns();
+    int nq=q2-q1+1;
+    long n=particle_data.size()/nc;
+    bool perp=(not scalar_switch) and (not longitudinal);
+    int nv=scalar_switch ? scalar_count : 1;
+
+    //Lower corner of the bounding box of the particles
+    double lo[3]={0, 0, 0}, hi[3]={0, 0, 0};
+    for (int a=0; a<nd; a++) {
+        lo[a]=hi[a]=(n > 0) ? particle_data[a] : 0;
+    }
+    for (long i=0; i<n; i++) {
+        for (int a=0; a<nd; a++) {
+            lo[a]=min(lo[a], particle_data[i*nc+a]);
+            hi[a]=max(hi[a], particle_data[i*nc+a]);
+        }
+    }
+    for (int a=0; a<nd; a++) {
+        if (not (std::isfinite(lo[a]) and std::isfinite(hi[a]))) {
+            cerr<<"ERROR! The coordinates of the particles have to be finite. Aborting..\n";
+            MPI_Abort(comm_SF, 1);
+        }
+        if ((hi[a]-lo[a])/particle_rmax > 1e15) {
+            cerr<<"ERROR! The extent of the particles is more than 1e15 times max_separation. Aborting..\n";
+            MPI_Abort(comm_SF, 1);
+        }
+    }
 
-			for (int i=0; i<test1.extent(0); i++){
-				double lx=dx*i;
+    //Cell coordinates of every particle, with y = 0 for 2D particles
+    int axis[3]={0, (nd == 3) ? 1 : -1, nd-1};
+    vector<long> cell_of(3*n, 0);
+    for (long i=0; i<n; i++) {
+        for (int a=0; a<3; a++) {
+            if (axis[a] >= 0) {
+                cell_of[3*i+a]=long((particle_data[i*nc+axis[a]]-lo[axis[a]])/particle_rmax);
+            }
+        }
+    }
 
-				for (int k=0; k<test1.extent(1); k++){
-					double lz=dz*k;
-                    if ((lx*lx + lz*lz)>epsilon) {
-                        err1 = abs((test1(i,k)-pow(lx*lx+lz*lz,(order+q1)/2.))/pow(lx*lx+lz*lz,(order+q1)/2.));
-                    }
-                    else {
-                        err1 =  abs(test1(i,k));
-                    }
+    //Sort the particles by cell into a copy, and list the coordinates of the occupied cells and the start of their particles
+    vector<long> index(n);
+    for (long i=0; i<n; i++) {
+        index[i]=i;
+    }
+    const long* key=cell_of.data();
+    sort(index.begin(), index.end(), [key](long i, long j) {
+        return lexicographical_compare(key+3*i, key+3*i+3, key+3*j, key+3*j+3);
+    });
+    vector<double> sorted(particle_data.size());
+    vector<long> cells, start;
+    for (long p=0; p<n; p++) {
+        long i=index[p];
+        if (p == 0 or not equal(key+3*i, key+3*i+3, key+3*index[p-1])) {
+            cells.insert(cells.end(), key+3*i, key+3*i+3);
+            start.push_back(p);
+        }
+        memcpy(&sorted[p*nc], &particle_data[i*nc], nc*sizeof(double));
+    }
+    start.push_back(n);
+    long n_cells=start.size()-1;
+
+    //Index of the occupied cell of given coordinates, or -1 if the cell is empty
+    auto find_cell=[&cells, n_cells](const long* c) {
+        long first=0, last=n_cells;
+        while (first < last) {
+            long middle=(first+last)/2;
+            if (lexicographical_compare(&cells[3*middle], &cells[3*middle]+3, c, c+3)) {
+                first=middle+1;
+            }
+            else {
+                last=middle;
+            }
+        }
+        return (first < n_cells and equal(c, c+3, &cells[3*first])) ? first : -1L;
+    };
+
+    //Neighbouring cells of higher coordinates, the cell itself being visited separately
+    vector<int> stencil;
+    for (int a=-1; a<=1; a++) {
+        for (int b=-1; b<=1; b++) {
+            for (int c=-1; c<=1; c++) {
+                if ((nd == 2 and b != 0) or (a < 0) or (a == 0 and b < 0) or (a == 0 and b == 0 and c <= 0)) {
+                    continue;
+                }
+                stencil.push_back(a);
+                stencil.push_back(b);
+                stencil.push_back(c);
+            }
+        }
+    }
 
-                    err2 = abs(test2(i,k));
+    int width=nv*nq;
+    Array<double,2> S1(particle_bins, width), S2(particle_bins, perp ? nq : 0);
+    Array<double,1> Np(particle_bins);
+    S1=0;
+    S2=0;
+    Np=0;
+    double rmax2=particle_rmax*particle_rmax;
+    long pairs=0;
 
-                    if (err1 > max) {
-                        max = err1;
+    #pragma omp parallel reduction(+:pairs)
+    {
+        vector<double> s1(particle_bins*width, 0.0), s2(perp ? particle_bins*nq : 0, 0.0), np(particle_bins, 0.0);
+        vector<double> d(nv);
+
+        #pragma omp for schedule(dynamic, 16)
+        for (long c=rank_mpi; c<n_cells; c+=P) {
+            for (int m=-1; m<int(stencil.size())/3; m++) {
+                long c2=c;
+                if (m >= 0) {
+                    long neighbour[3]={cells[3*c]+stencil[3*m], cells[3*c+1]+stencil[3*m+1], cells[3*c+2]+stencil[3*m+2]};
+                    c2=find_cell(neighbour);
+                    if (c2 < 0) {
+                        continue;
                     }
-                    if (err2 > max) {
-                        max = err2;
+                }
+                for (long p=start[c]; p<start[c+1]; p++) {
+                    const double* u1=&sorted[p*nc];
+                    for (long p2=(m < 0) ? p+1 : start[c2]; p2<start[c2+1]; p2++) {
+                        const double* u2=&sorted[p2*nc];
+                        double l[3], r2=0;
+                        for (int a=0; a<nd; a++) {
+                            l[a]=u2[a]-u1[a];
+                            r2+=l[a]*l[a];
+                        }
+                        if (r2 > rmax2 or r2 == 0) {
+                            continue;
+                        }
+                        double r=sqrt(r2);
+                        int b=min(int(r/particle_rmax*particle_bins), particle_bins-1);
+                        double dperp=0;
+                        if (scalar_switch) {
+                            //Orient the pair along the first nonzero component of the displacement
+                            int a=0;
+                            while (l[a] == 0) {
+                                a++;
+                            }
+                            double sign=(l[a] > 0) ? 1 : -1;
+                            for (int f=0; f<nv; f++) {
+                                d[f]=sign*(u2[nd+f]-u1[nd+f]);
+                            }
+                        }
+                        else {
+                            double du[3], pll=0;
+                            for (int a=0; a<nd; a++) {
+                                du[a]=u2[nd+a]-u1[nd+a];
+                                pll+=du[a]*l[a]/r;
+                            }
+                            d[0]=pll;
+                            for (int a=0; a<nd and perp; a++) {
+                                du[a]-=pll*l[a]/r;
+                                dperp+=du[a]*du[a];
+                            }
+                            dperp=sqrt(dperp);
+                        }
+                        for (int f=0; f<nv; f++) {
+                            double t=int_pow(d[f], q1);
+                            for (int q=0; q<nq; q++) {
+                                s1[b*width+f*nq+q]+=t;
+                                t*=d[f];
+                            }
+                        }
+                        if (perp) {
+                            double t=int_pow(dperp, q1);
+                            for (int q=0; q<nq; q++) {
+                                s2[b*nq+q]+=t;
+                                t*=dperp;
+                            }
+                        }
+                        np[b]++;
+                        pairs++;
                     }
+                }
+            }
+        }
+        #pragma omp critical
+        {
+            for (int b=0; b<particle_bins; b++) {
+                for (int q=0; q<width; q++) {
+                    S1(b, q)+=s1[b*width+q];
+                }
+                for (int q=0; q<nq and perp; q++) {
+                    S2(b, q)+=s2[b*nq+q];
+                }
+                Np(b)+=np[b];
+            }
+        }
+    }
+    pair_count+=pairs;
 
-				}
-			}
-		}
-	}
-
+    if (rank_mpi==0) {
+        Array<double,2> result=scalar_switch ? SF_particles_scalar : SF_particles_pll;
+        MPI_Reduce(S1.data(), result.data(), S1.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        if (perp) {
+            MPI_Reduce(S2.data(), SF_particles_perp.data(), S2.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        }
+        MPI_Reduce(Np.data(), SF_particles_count.data(), Np.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        //Normalize by the number of pairs of every bin
+        for (int b=0; b<particle_bins; b++) {
+            double count=SF_particles_count(b);
+            if (count > 0) {
+                result(b, Range::all())/=count;
+                if (perp) {
+                    SF_particles_perp(b, Range::all())/=count;
+                }
+            }
+        }
+    }
+    else {
+        MPI_Reduce(S1.data(), NULL, S1.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        if (perp) {
+            MPI_Reduce(S2.data(), NULL, S2.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+        }
+        MPI_Reduce(Np.data(), NULL, Np.size(), MPI_DOUBLE, MPI_SUM, 0, comm_SF);
+    }
+}
 
-	if (max > epsilon){
-		cout<<"\n\nVECTOR_2D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
-	}
-	else{
-		cout<<"\n\nVECTOR_2D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
-	}
+/**
+ ********************************************************************************************************************************************
+ * \brief   Structure describing an array of the structure functions that is averaged over the ensemble of snapshots.
+ ********************************************************************************************************************************************
+ */
+struct ensemble_array {
+    string name;    //!< Name of the array in the accumulator file.
+    double* data;   //!< Values of the array (contiguous).
+    long n;         //!< Number of values.
+};
 
-    cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add an array to the list of the arrays averaged over the ensemble if it is allocated on this processor.
+ ********************************************************************************************************************************************
+ */
+void add_ensemble_array(vector<ensemble_array>& list, string name, double* data, long n) {
+    if (n > 0) {
+        ensemble_array a={name, data, n};
+        list.push_back(a);
+    }
+}
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to list the arrays of the structure functions (and of the numbers of pairs of points inside the mask) allocated on
+ *          this processor, which are averaged over the ensemble.
+ *
+ *          The numbers of pairs of the cylindrical bins are fixed by the grid and are not averaged.
+ ********************************************************************************************************************************************
+ */
+vector<ensemble_array> ensemble_arrays() {
+    vector<ensemble_array> list;
+    add_ensemble_array(list, "SF_Grid_pll", SF_Grid_pll.data(), SF_Grid_pll.size());
+    add_ensemble_array(list, "SF_Grid_perp", SF_Grid_perp.data(), SF_Grid_perp.size());
+    add_ensemble_array(list, "SF_Grid_scalar", SF_Grid_scalar.data(), SF_Grid_scalar.size());
+    add_ensemble_array(list, "SF_Grid2D_pll", SF_Grid2D_pll.data(), SF_Grid2D_pll.size());
+    add_ensemble_array(list, "SF_Grid2D_perp", SF_Grid2D_perp.data(), SF_Grid2D_perp.size());
+    add_ensemble_array(list, "SF_Grid2D_scalar", SF_Grid2D_scalar.data(), SF_Grid2D_scalar.size());
+    add_ensemble_array(list, "SF_Grid_count", SF_Grid_count.data(), SF_Grid_count.size());
+    add_ensemble_array(list, "SF_Grid2D_count", SF_Grid2D_count.data(), SF_Grid2D_count.size());
+    add_ensemble_array(list, "SF_Grid_blocks", SF_Grid_blocks.data(), SF_Grid_blocks.size());
+    add_ensemble_array(list, "SF_Grid2D_blocks", SF_Grid2D_blocks.data(), SF_Grid2D_blocks.size());
+    add_ensemble_array(list, "SF_Grid_tensor", SF_Grid_tensor.data(), SF_Grid_tensor.size());
+    add_ensemble_array(list, "SF_Grid2D_tensor", SF_Grid2D_tensor.data(), SF_Grid2D_tensor.size());
+    add_ensemble_array(list, "SF_cyl_pll", SF_cyl_pll.data(), SF_cyl_pll.size());
+    add_ensemble_array(list, "SF_cyl_perp", SF_cyl_perp.data(), SF_cyl_perp.size());
+    add_ensemble_array(list, "SF_cyl_scalar", SF_cyl_scalar.data(), SF_cyl_scalar.size());
+    add_ensemble_array(list, "SF_harm_pll", SF_harm_pll.data(), SF_harm_pll.size());
+    add_ensemble_array(list, "SF_harm_perp", SF_harm_perp.data(), SF_harm_perp.size());
+    add_ensemble_array(list, "SF_harm_scalar", SF_harm_scalar.data(), SF_harm_scalar.size());
+    add_ensemble_array(list, "SF_axes_pll", SF_axes_pll.data(), SF_axes_pll.size());
+    add_ensemble_array(list, "SF_axes_perp", SF_axes_perp.data(), SF_axes_perp.size());
+    add_ensemble_array(list, "SF_axes_scalar", SF_axes_scalar.data(), SF_axes_scalar.size());
+    return list;
 }
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to list the parameters of the run that the accumulator file of the ensemble must match, with their values.
+ ********************************************************************************************************************************************
+ */
+void ensemble_parameters(vector<string>& keys, vector<double>& values) {
+    const char* names[16]={"Nx", "Ny", "Nz", "Lx", "Ly", "Lz", "q1", "q2", "scalar_switch", "scalar_count", "2D_switch",
+                           "Only_longitudinal", "signed_switch", "mask_switch", "mask_condition", "mask_threshold"};
+    double all[16]={double(Nx), double(Ny), double(Nz), Lx, Ly, Lz, double(q1), double(q2), double(scalar_switch),
+                    double(scalar_switch ? scalar_names.size() : 0), double(two_dimension_switch), double(longitudinal),
+                    double(signed_switch), double(mask_switch), double(mask_switch ? mask_condition : 0), mask_switch ? mask_threshold : 0};
+    keys.assign(names, names+16);
+    values.assign(all, all+16);
+}
 
 /**
  ********************************************************************************************************************************************
- * \brief   Test function to validate the calculation of structure functions of 2D scalar field data.
+ * \brief   Function to read the running sums of an interrupted ensemble from the accumulator file (rank 0 only).
  *
- *          This function validates the calculation of the structure functions computed using 2D scalar field data. The scalar field is
- *          generated as \f$ \theta = x + z \f$. For such field, the structure functions of order
- *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_z) = (l_x^2 + l_z^2)^q \f$. In this function, the theoretical values
- *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
- *          than \f$1 \times 10^{-10} \f$, the test is passed.
+ *          The parameters stored as attributes of the file (see ensemble_parameters()) must be those of the run, so that the sums of
+ *          other orders, grids, domains, lags, or masks are never resumed.
  *
+ * \param   arrays lists the arrays averaged over the ensemble; the file must store the same arrays with the same sizes.
+ * \param   done is set to 1 for the snapshots already accumulated.
  ********************************************************************************************************************************************
  */
-void SCALAR_TEST_CASE_2D()
-{	double epsilon=1e-10;
-	double max=0;
-	double err=0;
-	Array<double,2> test1;
-	int count=0;
-	test1.resize(Nx/2,Nz/2);
-	for (int order=0 ; order<=q2-q1; order++){
-		string name=int_to_str(order+q1);
+void read_ensemble_file(const vector<ensemble_array>& arrays, vector<char>& done) {
+    hid_t file_id=-1;
+    H5E_BEGIN_TRY {
+        file_id=H5Fopen(ensemble_file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    } H5E_END_TRY;
+    bool valid=(file_id >= 0);
+
+    vector<string> keys;
+    vector<double> values;
+    ensemble_parameters(keys, values);
+    for (size_t k=0; k<keys.size() and valid; k++) {
+        double stored;
+        hid_t attribute=(H5Aexists(file_id, keys[k].c_str()) > 0) ? H5Aopen(file_id, keys[k].c_str(), H5P_DEFAULT) : -1;
+        valid=(attribute >= 0) and H5Aread(attribute, H5T_NATIVE_DOUBLE, &stored) >= 0 and stored == values[k];
+        if (attribute >= 0) {
+            H5Aclose(attribute);
+        }
+        if (not valid) {
+            cerr<<"ERROR! The parameter "<<keys[k]<<" of the accumulator file "<<ensemble_file<<" differs from that of the run. Aborting..\n";
+            MPI_Abort(comm_SF, 1);
+        }
+    }
 
-		read_2D(test1,"out/","SF_Grid_scalar"+name);
+    hid_t dataset=valid ? H5Dopen2(file_id, "snapshots", H5P_DEFAULT) : -1;
+    ensemble_log.clear();
+    if (dataset >= 0) {
+        hid_t space=H5Dget_space(dataset);
+        ensemble_log.resize(H5Sget_simple_extent_npoints(space));
+        H5Sclose(space);
+        if (not ensemble_log.empty()) {
+            valid=H5Dread(dataset, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, ensemble_log.data()) >= 0;
+        }
+        H5Dclose(dataset);
+    }
+    else {
+        valid=false;
+    }
+    for (size_t i=0; i<ensemble_log.size() and valid; i++) {
+        valid=(ensemble_log[i] >= 0 and ensemble_log[i] < int(done.size()) and not done[ensemble_log[i]]);
+        if (valid) {
+            done[ensemble_log[i]]=1;
+        }
+    }
 
+    for (size_t a=0; a<arrays.size() and valid; a++) {
+        string names[2]={arrays[a].name+"/mean", arrays[a].name+"/M2"};
+        double* sums[2]={ensemble_mean[a].data(), ensemble_M2[a].data()};
+        for (int m=0; m<2 and valid; m++) {
+            dataset=H5Lexists(file_id, arrays[a].name.c_str(), H5P_DEFAULT) > 0 ? H5Dopen2(file_id, names[m].c_str(), H5P_DEFAULT) : -1;
+            if (dataset < 0) {
+                valid=false;
+                break;
+            }
+            hid_t space=H5Dget_space(dataset);
+            valid=(H5Sget_simple_extent_npoints(space) == arrays[a].n)
+                  and H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, sums[m]) >= 0;
+            H5Sclose(space);
+            H5Dclose(dataset);
+        }
+    }
+    if (file_id >= 0) {
+        H5Fclose(file_id);
+    }
 
+    if (not valid) {
+        cerr<<"ERROR! The accumulator file "<<ensemble_file<<" does not match the parameters of the ensemble. Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+    ensemble_n=ensemble_log.size();
+}
 
-		for (int i=0; i<test1.extent(0); i++){
-			double lx=dx*i;
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to store the running sums of the ensemble in the accumulator file after a snapshot (rank 0 only).
+ *
+ *          The file stores the parameters of the run as attributes, the running mean and the sum of squared deviations of every array
+ *          as the datasets "mean" and "M2" of a group named after the array, and the indices of the accumulated snapshots in the
+ *          dataset "snapshots". The whole file is written to a temporary file, which then replaces the accumulator file, so that the
+ *          sums and the list of snapshots are always updated together, even if the job is killed while writing.
+ *
+ * \param   arrays lists the arrays averaged over the ensemble.
+ * \param   s is the index of the snapshot just accumulated.
+ ********************************************************************************************************************************************
+ */
+void write_ensemble_file(const vector<ensemble_array>& arrays, int s) {
+    mkdir("out",0777);
+    ensemble_log.push_back(s);
+    string temporary=ensemble_file+".tmp";
+    hid_t file_id=H5Fcreate(temporary.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file_id < 0) {
+        cerr<<"ERROR! Unable to create the accumulator file "<<temporary<<". Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
 
-			for (int k=0; k<test1.extent(1); k++){
-				double lz=dz*k;
-				if (abs(lx+lz)>epsilon){
-					err=abs((test1(i,k)-pow(lx+lz,(order+q1)))/pow(lx+lz,(order+q1)));
+    herr_t status=0;
+    vector<string> keys;
+    vector<double> values;
+    ensemble_parameters(keys, values);
+    for (size_t k=0; k<keys.size(); k++) {
+        status|=write_attribute(file_id, keys[k].c_str(), values[k]);
+    }
+    hsize_t n=ensemble_log.size();
+    status|=write_dataset(file_id, "snapshots", H5T_NATIVE_INT, ensemble_log.data(), 1, &n);
+    for (size_t a=0; a<arrays.size(); a++) {
+        hid_t group=H5Gcreate2(file_id, arrays[a].name.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        if (group < 0) {
+            status=-1;
+            continue;
+        }
+        n=arrays[a].n;
+        status|=write_dataset(group, "mean", H5T_NATIVE_DOUBLE, ensemble_mean[a].data(), 1, &n);
+        status|=write_dataset(group, "M2", H5T_NATIVE_DOUBLE, ensemble_M2[a].data(), 1, &n);
+        H5Gclose(group);
+    }
+    status|=H5Fclose(file_id);
+    if (status < 0 or rename(temporary.c_str(), ensemble_file.c_str()) != 0) {
+        cerr<<"ERROR! Unable to update the accumulator file "<<ensemble_file<<". Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+}
 
-				}
-				else{
-					err=abs(test1(i,k));
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to average the structure functions over the snapshots of the ensemble.
+ *
+ *          The snapshots are read one after another from their folders, and their structure functions are computed as usual. Rank 0
+ *          updates the running mean and the sum of squared deviations of every value with Welford's algorithm, which is stable for many
+ *          snapshots, and stores them in the accumulator file after every snapshot. Only these two arrays are kept, not the structure
+ *          functions of every snapshot. If the accumulator file exists, the snapshots it lists are skipped, so that an interrupted job
+ *          resumes where it stopped. At the end, the structure function arrays hold the means of the ensemble.
+ ********************************************************************************************************************************************
+ */
+void SF_ensemble() {
+    int ns=snapshots.size();
+    vector<char> done(ns, 0);
+    vector<ensemble_array> arrays=ensemble_arrays();
+    ensemble_n=0;
+    ensemble_log.clear();
 
-				}
+    if (rank_mpi==0) {
+        ensemble_mean.assign(arrays.size(), vector<double>());
+        ensemble_M2.assign(arrays.size(), vector<double>());
+        for (size_t a=0; a<arrays.size(); a++) {
+            ensemble_mean[a].assign(arrays[a].n, 0);
+            ensemble_M2[a].assign(arrays[a].n, 0);
+        }
+        if (access(ensemble_file.c_str(), F_OK) == 0) {
+            read_ensemble_file(arrays, done);
+            cout<<"\nResuming the ensemble from "<<ensemble_file<<" with "<<ensemble_n<<" of "<<ns<<" snapshots accumulated\n";
+        }
+    }
+    MPI_Bcast(done.data(), ns, MPI_CHAR, 0, comm_SF);
 
-                if (err>max) {
-                    max = err;
+    for (int s=0; s<ns; s++) {
+        if (done[s]) {
+            continue;
+        }
+        in_folder=snapshots[s];
+        if (rank_mpi==0) {
+            cout<<"\nSnapshot "<<s+1<<" of "<<ns<<": "<<in_folder<<endl;
+        }
+        Read_fields();
+        for (size_t a=0; a<arrays.size(); a++) {
+            memset(arrays[a].data, 0, arrays[a].n*sizeof(double));
+        }
+        calc_SFs();
+
+        if (rank_mpi==0) {
+            ensemble_n++;
+            for (size_t a=0; a<arrays.size(); a++) {
+                double* mean=ensemble_mean[a].data();
+                double* M2=ensemble_M2[a].data();
+                for (long i=0; i<arrays[a].n; i++) {
+                    double x=arrays[a].data[i];
+                    double delta=x-mean[i];
+                    mean[i]+=delta/ensemble_n;
+                    M2[i]+=delta*(x-mean[i]);
                 }
-                
+            }
+            write_ensemble_file(arrays, s);
+        }
+    }
+    in_folder="in/";
 
-			}
-            
-		}
-	}
-	if (max > epsilon){
-		cout<<"\n\nSCALAR_2D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
-	}
-	else{
-		cout<<"\n\nSCALAR_2D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
-	}
+    if (rank_mpi==0) {
+        for (size_t a=0; a<arrays.size(); a++) {
+            memcpy(arrays[a].data, ensemble_mean[a].data(), arrays[a].n*sizeof(double));
+        }
+        cout<<"\nStructure functions averaged over "<<ensemble_n<<" snapshots\n";
+    }
+}
 
-	cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the standard errors of the means of the ensemble, \f$ \sqrt{M_2 / (n (n-1))} \f$ for \f$ n \f$ snapshots, in
+ *          the same layout as the structure functions, to files with the suffix "_err".
+ ********************************************************************************************************************************************
+ */
+void write_ensemble_errors() {
+    if (rank_mpi!=0) {
+        return;
+    }
+    if (ensemble_n < 2) {
+        cout<<"\nWARNING: The standard errors need at least two snapshots; they are set to zero.\n";
+    }
+    vector<ensemble_array> arrays=ensemble_arrays();
+    for (size_t a=0; a<arrays.size(); a++) {
+        for (long i=0; i<arrays[a].n; i++) {
+            arrays[a].data[i]=(ensemble_n < 2) ? 0 : sqrt(ensemble_M2[a][i]/(double(ensemble_n)*(ensemble_n-1)));
+        }
+    }
+    out_suffix="_err";
+    write_SFs();
+    out_suffix="";
+    for (size_t a=0; a<arrays.size(); a++) {
+        memcpy(arrays[a].data, ensemble_mean[a].data(), arrays[a].n*sizeof(double));
+    }
 }
 
 /**
  ********************************************************************************************************************************************
- * \brief   Test function to validate the calculation of structure functions of 3D scalar field data.
- *
- *          This function validates the calculation of the structure functions computed using 3D scalar field data. The scalar field is
- *          generated as \f$ \theta = x + y + z \f$. For such field, the structure functions of order
- *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_y, l_z) = (l_x^2 + l_y^2 + l_z^2)^q \f$. In this function, the theoretical values
- *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
- *          than \f$1 \times 10^{-10} \f$, the test is passed.
+ * \brief   Function to compute the space-time structure functions \f$ S(\mathbf{l}, \tau) \f$ over a sliding window of snapshots.
  *
+ *          The snapshots are read one after another, each exactly once, and the last time_window of them are kept in memory. A new
+ *          snapshot is paired with every snapshot of the window: the earlier snapshot gives the first point of the pairs and the new one
+ *          the second point for the time lag \f$ \tau \f$, and the other way round for \f$ -\tau \f$, i.e., the increments are
+ *          \f$ \mathbf{u}(\mathbf{x}+\mathbf{l}, t+\tau) - \mathbf{u}(\mathbf{x}, t) \f$ for both signs of \f$ \tau \f$. The structure
+ *          functions of every pair of snapshots are summed over the time origins at rank 0 and divided by the numbers of origins at the
+ *          end. The structure function arrays then hold the time lag 0, and write_space_time() writes the other time lags.
  ********************************************************************************************************************************************
  */
-void SCALAR_TEST_CASE_3D(){
-
-	double epsilon=1e-10;
-	double max=0;
-	double err=0;
-    Array<double,3> test1;
-	int count=0;
-	test1.resize(Nx/2,Ny/2,Nz/2);
-	for (int order=0 ; order<=q2-q1; order++){
-		string name=int_to_str(order+q1);
-		read_3D(test1,"out/","SF_Grid_scalar"+name);
-		for (int i=0; i<test1.extent(0); i++){
-			double lx=dx*i;
-			for (int j=0; j<test1.extent(1); j++){
-				double ly=dy*j;
-				for (int k=0; k<test1.extent(2); k++){
-					double lz=dz*k;
-					if (abs(lx+ly+lz)>epsilon){
-						err=abs((test1(i,j,k)-pow(lx+ly+lz,(order+q1)))/pow(lx+ly+lz,(order+q1)));
+void SF_space_time() {
+    int ns=time_snapshots.size();
+    vector<ensemble_array> arrays=ensemble_arrays();
+    vector<snapshot_fields> window(time_window);
 
-					}
-					else{
-						err=abs(test1(i,j,k));
+    if (rank_mpi==0) {
+        time_sums.assign(arrays.size(), vector<double>());
+        for (size_t a=0; a<arrays.size(); a++) {
+            time_sums[a].assign(arrays[a].n*(2*time_window-1), 0);
+        }
+    }
 
-					}
+    for (int s=0; s<ns; s++) {
+        in_folder=time_snapshots[s];
+        if (rank_mpi==0) {
+            cout<<"\nSnapshot "<<s+1<<" of "<<ns<<": "<<in_folder<<endl;
+        }
+        //The new snapshot replaces the oldest one of the window, and is read into new memory since the window keeps the previous one
+        window[s%time_window]=snapshot_fields();
+        vector<Array<double,3>*> fields3D=fields_3D();
+        vector<Array<double,2>*> fields2D=fields_2D();
+        for (size_t f=0; f<fields3D.size(); f++) {
+            fields3D[f]->reference(Array<double,3>());
+        }
+        for (size_t f=0; f<fields2D.size(); f++) {
+            fields2D[f]->reference(Array<double,2>());
+        }
+        Read_fields();
+        window[s%time_window]=current_fields();
+
+        for (int tau=0; tau<time_window and tau<=s; tau++) {
+            const snapshot_fields& earlier=window[(s-tau)%time_window];
+            const snapshot_fields& later=window[s%time_window];
+            for (int sign=1; sign>=-1; sign-=2) {
+                if (tau==0 and sign<0) {
+                    continue;
+                }
+                time_lag=sign*tau;
+                for (size_t a=0; a<arrays.size(); a++) {
+                    memset(arrays[a].data, 0, arrays[a].n*sizeof(double));
+                }
+                if (sign>0) {
+                    calc_SFs(earlier, later);
+                }
+                else {
+                    calc_SFs(later, earlier);
+                }
 
-                    if (err>max) {
-                        max=err;
+                if (rank_mpi==0) {
+                    for (size_t a=0; a<arrays.size(); a++) {
+                        double* sum=time_sums[a].data()+(time_lag+time_window-1)*arrays[a].n;
+                        for (long i=0; i<arrays[a].n; i++) {
+                            sum[i]+=arrays[a].data[i];
+                        }
                     }
-				}
-			}
-		}
-	}
-	if (max > epsilon){
-		cout<<"\n\nSCALAR_3D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
-	}
-	else{
-		cout<<"\n\nSCALAR_3D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
+                }
+            }
+        }
+    }
+    time_lag=0;
+    in_folder="in/";
 
-	}
+    if (rank_mpi==0) {
+        for (size_t a=0; a<arrays.size(); a++) {
+            for (int tau=1-time_window; tau<time_window; tau++) {
+                double* sum=time_sums[a].data()+(tau+time_window-1)*arrays[a].n;
+                for (long i=0; i<arrays[a].n; i++) {
+                    sum[i]/=ns-abs(tau);
+                }
+            }
+            memcpy(arrays[a].data, time_sums[a].data()+(time_window-1)*arrays[a].n, arrays[a].n*sizeof(double));
+        }
+        cout<<"\nSpace-time structure functions of "<<ns<<" snapshots with time lags up to "<<time_window-1<<" snapshots\n";
+    }
+}
 
-    cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the space-time structure functions of the nonzero time lags \f$ \tau \f$, in the same layout as the structure
+ *          functions, to files with the suffix "_tau" followed by \f$ \tau \f$ in snapshots.
+ ********************************************************************************************************************************************
+ */
+void write_space_time() {
+    if (rank_mpi!=0) {
+        return;
+    }
+    vector<ensemble_array> arrays=ensemble_arrays();
+    for (int tau=1-time_window; tau<time_window; tau++) {
+        if (tau == 0) {
+            continue;
+        }
+        for (size_t a=0; a<arrays.size(); a++) {
+            memcpy(arrays[a].data, time_sums[a].data()+(tau+time_window-1)*arrays[a].n, arrays[a].n*sizeof(double));
+        }
+        out_suffix="_tau"+int_to_str(tau);
+        write_SFs();
+    }
+    out_suffix="";
+    for (size_t a=0; a<arrays.size(); a++) {
+        memcpy(arrays[a].data, time_sums[a].data()+(time_window-1)*arrays[a].n, arrays[a].n*sizeof(double));
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to read the 3D fields of the planes mode: the scalar fields, or the velocity components along \f$ x \f$ and \f$ y \f$,
+ *          which are the components in the planes.
+ ********************************************************************************************************************************************
+ */
+void read_plane_fields() {
+    if (rank_mpi==0){
+        cout<<"Reading the 3D fields of the planes from the hdf5 files\n";
+    }
+    if (scalar_switch) {
+        T.resize(plane_grid[0], plane_grid[1], plane_grid[2]);
+        read_3D(T, in_folder, scalar_names[0]);
+        T_more.resize(scalar_count-1);
+        for (int f=1; f<scalar_count; f++) {
+            T_more[f-1].resize(plane_grid[0], plane_grid[1], plane_grid[2]);
+            read_3D(T_more[f-1], in_folder, scalar_names[f]);
+        }
+    }
+    else {
+        V1.resize(plane_grid[0], plane_grid[1], plane_grid[2]);
+        V2.resize(plane_grid[0], plane_grid[1], plane_grid[2]);
+        read_3D(V1, in_folder, "U.V1r");
+        read_3D(V2, in_folder, "U.V2r");
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the 2D structure functions of the planes \f$ (x, y) \f$ of the 3D fields, read once.
+ *
+ *          The planes are copied one after another into the 2D fields, with \f$ y \f$ as the second direction, and their structure
+ *          functions are computed by the 2D kernels, the displacement vectors of a plane being shared among all the processors and their
+ *          threads. Rank 0 stores the structure functions of every plane in the arrays SF_planes_pll, SF_planes_perp, or
+ *          SF_planes_scalar.
+ ********************************************************************************************************************************************
+ */
+void SF_planes() {
+    T_more_2D.resize(scalar_count-1);
+    for (size_t n=0; n<planes.size(); n++) {
+        int k=planes[n];
+        if (rank_mpi==0) {
+            cout<<"\nPlane "<<n+1<<" of "<<planes.size()<<" at z index "<<k<<endl;
+        }
+        if (scalar_switch) {
+            T_2D.resize(Nx, Nz);
+            T_2D=T(Range::all(), Range::all(), k);
+            for (int f=1; f<scalar_count; f++) {
+                T_more_2D[f-1].resize(Nx, Nz);
+                T_more_2D[f-1]=T_more[f-1](Range::all(), Range::all(), k);
+            }
+        }
+        else {
+            V1_2D.resize(Nx, Nz);
+            V3_2D.resize(Nx, Nz);
+            V1_2D=V1(Range::all(), Range::all(), k);
+            V3_2D=V2(Range::all(), Range::all(), k);
+        }
+        calc_SFs();
 
+        if (rank_mpi==0) {
+            if (scalar_switch) {
+                SF_planes_scalar(Range::all(), Range::all(), n, Range::all())=SF_Grid2D_scalar;
+            }
+            else {
+                SF_planes_pll(Range::all(), Range::all(), n, Range::all())=SF_Grid2D_pll;
+                if (not longitudinal) {
+                    SF_planes_perp(Range::all(), Range::all(), n, Range::all())=SF_Grid2D_perp;
+                }
+            }
+        }
+    }
 }
 
-
-
 /**
  ********************************************************************************************************************************************
- * \brief   Function to convert an integer type value to string.
- *
- *
- * \param   number is the integer value of to be converted.
- *
- * \return  The value as a string.
- *
+ * \brief   Function to parse a list of CPUs in the format of the Linux sysfs, e.g. "0-3,8-11".
  ********************************************************************************************************************************************
  */
-string int_to_str(int number)
-{
-    stringstream ss;
-
-    ss << number;
-
-    return ss.str();
+vector<int> parse_cpulist(string list) {
+    vector<int> cpus;
+    stringstream ss(list);
+    string range;
+    while (getline(ss, range, ',')) {
+        int first, last;
+        char dash;
+        stringstream rs(range);
+        if (not (rs>>first)) {
+            continue;
+        }
+        last=(rs>>dash>>last) ? last : first;
+        for (int c=first; c<=last; c++) {
+            cpus.push_back(c);
+        }
+    }
+    return cpus;
 }
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to compute the time elapsed.
- *
- *          This function computes the time elapsed in seconds between a start point and an end point during the execution of the
- *          program
- *
- * \param start_t is the time corresponding to the start point
- * \param end_t is the time corresponding to the end point
- * \param elapsed stores the time elapsed in seconds
+ * \brief   Function to compute the NUMA node of every CPU from /sys/devices/system/node; all the CPUs are on node 0 if the information
+ *          is not available.
  ********************************************************************************************************************************************
  */
-void compute_time_elapsed(timeval start_t, timeval end_t, double& elapsed){
-    long elapsed_2 = (end_t.tv_sec-start_t.tv_sec)*1000000u + end_t.tv_usec-start_t.tv_usec;
-    elapsed=elapsed_2/1.0e6;
+vector<int> cpu_nodes() {
+    vector<int> node(CPU_SETSIZE, 0);
+    numa_nodes=1;
+    for (int n=0; n<1024; n++) {
+        ifstream file(("/sys/devices/system/node/node"+int_to_str(n)+"/cpulist").c_str());
+        string list;
+        if (not (file and getline(file, list))) {
+            continue;
+        }
+        vector<int> cpus=parse_cpulist(list);
+        for (size_t c=0; c<cpus.size(); c++) {
+            if (cpus[c] < CPU_SETSIZE) {
+                node[cpus[c]]=n;
+            }
+        }
+        numa_nodes=max(numa_nodes, n+1);
+    }
+    return node;
 }
 
-
-
 /**
  ********************************************************************************************************************************************
- * \brief   Function to write the structure functions as function of \f$ (l_x,l_y,l_z) \f$ as a 3D hdf5 file.
- *
- *          This function reads the structure functions as a 4D array of dimensions \f$ (l_x \times l_y \times l_z \times p)\f$, where \f$ p \f$ is the order of the number of orders of
- *          structure function.
- *          The structure functions of different orders are then stored as separate 3D hdf5 files.
+ * \brief   Function to pin the MPI processes and their threads to the cores, to record the NUMA node of every thread, and to report
+ *          the placement at startup.
  *
- * \param   A is the 4D array representing the structure functions.
- * \param   file is the name of the hdf5 file and the dataset in which the structure functions are stored.
- * \param   q is the order of the structure function to be stored.
+ *          If the MPI launcher gives the same CPUs to all the processes of a node, these CPUs are split into equal consecutive parts,
+ *          one per process; otherwise every process keeps the CPUs given by the launcher. Within the CPUs of a process, the threads are
+ *          pinned to consecutive CPUs (compact), or to CPUs taken from the NUMA nodes in turn (spread), so that the threads of a process
+ *          use the memory controllers of all the sockets.
  ********************************************************************************************************************************************
  */
-void write_4D(Array<double,4> A, string file,int q) {
-  int nx=A(Range::all(),0,0,0).size();
-  int ny=A(0,Range::all(),0,0).size();
-  int nz=A(0,0,Range::all(),0).size();
-  Array<double,3> temp(nx,ny,nz);
-  temp(Range::all(),Range::all(),Range::all())=(A(Range::all(),Range::all(),Range::all(),q-q1));
-  h5::File f("out/"+file+".h5", "w");
-  h5::Dataset ds = f.create_dataset(file, h5::shape(nx,ny,nz), "double");
-  ds << temp.data();
+void setup_numa() {
+    vector<int> node=cpu_nodes();
+    int nthreads=omp_get_max_threads();
+
+    if (numa_pinning > 0) {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+
+        MPI_Comm local;
+        int local_rank, local_size;
+        MPI_Comm_split_type(comm_SF, MPI_COMM_TYPE_SHARED, rank_mpi, MPI_INFO_NULL, &local);
+        MPI_Comm_rank(local, &local_rank);
+        MPI_Comm_size(local, &local_size);
+        vector<cpu_set_t> sets(local_size);
+        MPI_Allgather(&allowed, sizeof(allowed), MPI_BYTE, sets.data(), sizeof(allowed), MPI_BYTE, local);
+        MPI_Comm_free(&local);
+        bool shared=true;
+        for (int r=0; r<local_size; r++) {
+            shared=shared and CPU_EQUAL(&sets[r], &allowed);
+        }
+
+        vector<int> cpus;
+        for (int c=0; c<CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &allowed)) {
+                cpus.push_back(c);
+            }
+        }
+        if (shared and local_size > 1) {
+            int n=cpus.size();
+            int first=long(local_rank)*n/local_size, last=max(long(local_rank+1)*n/local_size, long(first+1));
+            cpus=vector<int>(cpus.begin()+first, cpus.begin()+last);
+        }
+        if (numa_pinning==2) {
+            //Take the CPUs from the NUMA nodes in turn
+            vector< vector<int> > by_node(numa_nodes);
+            for (size_t c=0; c<cpus.size(); c++) {
+                by_node[node[cpus[c]]].push_back(cpus[c]);
+            }
+            size_t deepest=0;
+            for (int n=0; n<numa_nodes; n++) {
+                deepest=max(deepest, by_node[n].size());
+            }
+            cpus.clear();
+            for (size_t i=0; i<deepest; i++) {
+                for (int n=0; n<numa_nodes; n++) {
+                    if (i < by_node[n].size()) {
+                        cpus.push_back(by_node[n][i]);
+                    }
+                }
+            }
+        }
+
+        #pragma omp parallel
+        {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpus[omp_get_thread_num()%cpus.size()], &one);
+            sched_setaffinity(0, sizeof(one), &one);
+        }
+    }
+
+    //Record where the threads run
+    vector<int> thread_cpu(nthreads, -1);
+    thread_node.assign(nthreads, 0);
+    #pragma omp parallel
+    {
+        int t=omp_get_thread_num();
+        int cpu=sched_getcpu();
+        thread_cpu[t]=cpu;
+        thread_node[t]=(cpu >= 0 and cpu < CPU_SETSIZE) ? node[cpu] : 0;
+    }
+
+    const int width=1024;
+    stringstream report;
+    report<<"Rank "<<rank_mpi<<": threads on CPUs";
+    for (int t=0; t<nthreads; t++) {
+        report<<(t ? "," : " ")<<thread_cpu[t];
+    }
+    report<<" (NUMA nodes";
+    for (int t=0; t<nthreads; t++) {
+        report<<(t ? "," : " ")<<thread_node[t];
+    }
+    report<<")";
+    string line=report.str().substr(0, width-1);
+    vector<char> lines(rank_mpi==0 ? long(width)*P : 0);
+    char buffer[width]={0};
+    strncpy(buffer, line.c_str(), width-1);
+    MPI_Gather(buffer, width, MPI_CHAR, lines.data(), width, MPI_CHAR, 0, comm_SF);
+    if (rank_mpi==0) {
+        const char* pinning[3]={"none", "compact", "spread"};
+        const char* placement[3]={"default", "interleave", "replicate"};
+        cout<<"\nNUMA nodes: "<<numa_nodes<<", pinning: "<<pinning[numa_pinning]<<", placement of the fields: "
+            <<placement[numa_placement]<<endl;
+        for (int r=0; r<P; r++) {
+            cout<<lines.data()+long(r)*width<<endl;
+        }
+    }
 }
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to write the structure functions as function of lx,lz as a 2D hdf5 file.
- *
- *          This function reads the structure functions as a 3D array of dimensions \f$ (l_x \times l_z \times p) \f$, where \f$ p \f$ is the number of orders of the structure function.
- *          The structure functions of different orders are then stored as separate 2D hdf5 files.
+ * \brief   Function to touch the pages of a newly allocated array in turn by all the threads, so that the pages are interleaved among
+ *          the NUMA nodes of the threads by the first touch policy of the operating system.
  *
- * \param   A is the 3D array representing the structure functions.
- * \param   file is the name of the hdf5 file and the dataset in which the structure functions are stored.
- * \param   q is the order of the structure function to be stored.
+ * \param   A is the pointer to the array.
+ * \param   n is the number of values.
  ********************************************************************************************************************************************
  */
-void write_3D(Array<double,3> A, string file,int q) {
-  int nx=A(Range::all(),0,0).size();
-  int nz=A(0,Range::all(),0).size();
-  Array<double,2> temp(nx,nz);
-  temp(Range::all(),Range::all())=(A(Range::all(),Range::all(),q-q1));
-  h5::File f("out/"+file+".h5", "w");
-  h5::Dataset ds = f.create_dataset(file, h5::shape(nx,nz), "double");
-  ds << temp.data();
+void first_touch(double* A, long n) {
+    long page=max(long(sysconf(_SC_PAGESIZE)/sizeof(double)), 1L);
+    long pages=(n+page-1)/page;
+    #pragma omp parallel for schedule(static, 1)
+    for (long p=0; p<pages; p++) {
+        memset(A+p*page, 0, min(page, n-p*page)*sizeof(double));
+    }
 }
 
-
-
 /**
  ********************************************************************************************************************************************
- * \brief   Function to read a 2D field from an hdf5 file.
- *
- *          This function reads an hdf5 file containing a 2D field, which can be the \f$ x \f$ or \f$ z \f$ component of a 2D velocity field. The dimensions of the
- *          2D field is \f$(N_x \times N_z)\f$, where \f$N_x\f$ and \f$N_z\f$ are the number of gridpoints in \f$ x \f$ and \f$ z \f$ directions respectively.
- *          The hdf5 file should have only
- *          one dataset, and the names of the hdf5 file and the dataset must be identical. This function makes use of the H5SI library for reading the
- *          hdf5 file.
- *
- * \param   A is the 2D array to store the field that is read from the file.
- * \param   fold is the name of the folder in which the input files are kept.
- * \param   file is a string storing the name of the file to be read.
+ * \brief   Function returning the 3D input fields: the scalar fields and the velocity components (empty if not used).
  ********************************************************************************************************************************************
  */
-void read_2D(Array<double,2> A, string fold, string file) {
-  h5::File f(fold+file+".h5", "r");
-  f[file] >> A.data();
+vector<Array<double,3>*> fields_3D() {
+    vector<Array<double,3>*> fields;
+    fields.push_back(&T);
+    for (size_t f=0; f<T_more.size(); f++) {
+        fields.push_back(&T_more[f]);
+    }
+    fields.push_back(&V1);
+    fields.push_back(&V2);
+    fields.push_back(&V3);
+    return fields;
 }
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to read a 3D field from an hdf5 file.
- *
- *          This function reads an hdf5 file containing a 4D field, which can be the \f$ x \f$, \f$ y \f$, or \f$ z \f$ component of a 3D velocity field. The dimensions of the
- *          3D field is \f$(N_x \times N_y \times N_z)\f$, where \f$N_x\f$, \f$N_y\f$, and \f$N_z\f$ are the number of gridpoints in \f$ x \f$, \f$ y \f$, and \f$ z \f$ directions
- *          respectively. The hdf5 file should
- *          have only one dataset, and the names of the hdf5 file and the dataset must be identical. This function makes use of the H5SI library for
- *          reading the hdf5 file.
- *
- * \param A is the 3D array to store the field that is read from the file.
- * \param fold is the name of the folder in which the input files are kept.
- * \param file is a string storing the name of the file to be read.
+ * \brief   Function returning the 2D input fields: the scalar fields and the velocity components (empty if not used).
  ********************************************************************************************************************************************
  */
-void read_3D(Array<double,3> A, string fold, string file) {
-  h5::File f(fold+file+".h5", "r");
-  f[file] >> A.data();
+vector<Array<double,2>*> fields_2D() {
+    vector<Array<double,2>*> fields;
+    fields.push_back(&T_2D);
+    for (size_t f=0; f<T_more_2D.size(); f++) {
+        fields.push_back(&T_more_2D[f]);
+    }
+    fields.push_back(&V1_2D);
+    fields.push_back(&V3_2D);
+    return fields;
 }
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to open the yaml file and parse the parameters.
+ * \brief   Function to copy the input fields to every NUMA node that runs threads of this processor.
  *
- *          The function opens the parameters.yaml file and parses the simulation parameters into its member variables that are publicly
- *          accessible.
+ *          The copy of a node is allocated and filled by the first thread of the node, so that its pages are local to the node. The
+ *          replicas of the previous fields (of a previous snapshot) are freed first.
  ********************************************************************************************************************************************
  */
-void get_Inputs() {
-    YAML::Node para;
-    ifstream para_yaml,input_field;
-    string para_path="in/para.yaml";
-    para_yaml.open(para_path.c_str());
-  
-    if (para_yaml.is_open())
-    {
-      try
-      {
-        YAML::Parser parser(para_yaml);
-        parser.GetNextDocument(para);
-      }
-      catch(YAML::ParserException& e)
-      {
-        cerr << "Global::Parse: Error reading parameter file: \n" << e.what() << endl;
-      }
-  
-    }
-    else
-    {
-      cerr << "Global::Parse: Unable to open '" + para_path + "'." << endl;
-      h5::finalize();
-      MPI_Finalize();
-      exit(1);
+void replicate_fields() {
+    for (size_t f=0; f<replicas.size(); f++) {
+        for (size_t n=0; n<replicas[f].copies.size(); n++) {
+            delete[] replicas[f].copies[n];
+        }
     }
-    para["program"]["scalar_switch"]>>scalar_switch;
-    para["program"]["Only_longitudinal"]>>longitudinal;
-    para["program"]["2D_switch"]>>two_dimension_switch;
-    para["grid"]["Nx"]>>Nx;
-    para["grid"]["Ny"]>>Ny;
-    para["grid"]["Nz"]>>Nz;
-    para["domain_dimension"]["Lx"]>>Lx;
-    para["domain_dimension"]["Ly"]>>Ly;
-    para["domain_dimension"]["Lz"]>>Lz;
-  
-    para["structure_function"]["q1"]>>q1;
-    para["structure_function"]["q2"]>>q2;
-    para["test"]["test_switch"]>>test_switch;
-  
-    if (Nx==1){dx=0;}
-    else{
-      dx=Lx/double(Nx-1);}
-    if (Ny==1){dy=0;}
-    else{
-      dy=Ly/double(Ny-1);}
-    if (Nz==1){dz=0;}
-    else{
-      dz=Lz/double(Nz-1);
-  }
-
-  if (rank_mpi==0) {
-    cout<<"\nNumber of processors in x direction: "<<px<<endl;
-    if (two_dimension_switch) {
-        cout<<"Number of processors in z direction: "<<P/px<<endl;
+    replicas.clear();
+
+    vector<Array<double,3>*> fields3D=fields_3D();
+    vector<Array<double,2>*> fields2D=fields_2D();
+    vector<long> sizes;
+    for (size_t f=0; f<fields3D.size(); f++) {
+        if (fields3D[f]->size() > 0) {
+            field_replicas r={fields3D[f]->data(), vector<double*>(numa_nodes, (double*)NULL)};
+            replicas.push_back(r);
+            sizes.push_back(fields3D[f]->size());
+        }
     }
-    else {
-        cout<<"Number of processors in y direction: "<<P/px<<endl;
+    for (size_t f=0; f<fields2D.size(); f++) {
+        if (fields2D[f]->size() > 0) {
+            field_replicas r={fields2D[f]->data(), vector<double*>(numa_nodes, (double*)NULL)};
+            replicas.push_back(r);
+            sizes.push_back(fields2D[f]->size());
+        }
     }
-  }  
 
-  if (px > P) {
-        if (rank_mpi==0) {
-            cout<<"ERROR! Number of processors in x direction has to be less than or equal to the total number of processors! Aborting.."<<endl;
-        }
-        h5::finalize();
-        MPI_Finalize();
-        exit(1);
+    vector<int> first(numa_nodes, -1);
+    for (int t=thread_node.size()-1; t>=0; t--) {
+        first[thread_node[t]]=t;
     }
-    if (Nx/2%px != 0) {
-        if (rank_mpi==0){
-            cout<<"ERROR! Number of processors in x direction should be less or equal to Nx/2 and some power of 2\n Aborting...\n";
+    #pragma omp parallel
+    {
+        int t=omp_get_thread_num();
+        int n=(t < int(thread_node.size())) ? thread_node[t] : 0;
+        if (first[n]==t) {
+            for (size_t f=0; f<replicas.size(); f++) {
+                double* copy=new double[sizes[f]];
+                memcpy(copy, replicas[f].field, sizes[f]*sizeof(double));
+                replicas[f].copies[n]=copy;
+            }
         }
-        h5::finalize();
-        MPI_Finalize();
-        exit(1);
     }
+}
 
-    int N2;
-
-    if (two_dimension_switch) {
-        N2 = Nz;
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return the replica of an input field on the NUMA node of the calling thread, or the field itself if it is not
+ *          replicated.
+ ********************************************************************************************************************************************
+ */
+const double* numa_local(const double* A) {
+    int t=omp_get_thread_num();
+    if (replicas.empty() or t >= int(thread_node.size())) {
+        return A;
     }
-    else {
-        N2 = Ny;
+    for (size_t f=0; f<replicas.size(); f++) {
+        if (replicas[f].field==A and replicas[f].copies[thread_node[t]] != NULL) {
+            return replicas[f].copies[thread_node[t]];
+        }
     }
+    return A;
+}
 
-    if (N2/2%(P/px) != 0) {
-        if (rank_mpi==0){
-            cout<<"ERROR! Number of processors in y (or z) direction should be less or equal to Ny/2 (or Nz/2) and some power of 2\n Aborting...\n";
-        }
-        h5::finalize();
-        MPI_Finalize();
-        exit(1);
-    }  
-  
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return a 3D input field on the NUMA node of the calling thread (see numa_local(const double*)).
+ ********************************************************************************************************************************************
+ */
+Array<double,3> numa_local(Array<double,3> A) {
+    const double* local=numa_local(A.data());
+    if (local==A.data()) {
+        return A;
+    }
+    return Array<double,3>(const_cast<double*>(local), A.shape(), neverDeleteData);
 }
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return a 2D input field on the NUMA node of the calling thread (see numa_local(const double*)).
+ ********************************************************************************************************************************************
+ */
+Array<double,2> numa_local(Array<double,2> A) {
+    const double* local=numa_local(A.data());
+    if (local==A.data()) {
+        return A;
+    }
+    return Array<double,2>(const_cast<double*>(local), A.shape(), neverDeleteData);
+}
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to generate an idealized 3D velocity field.
+ * \brief   Function to allocate the memory of an input field of n values.
  *
- *          This function generates the following 3D velocity field.
- *          \f$u_x = x, \quad u_y = y, \quad u_z = z\f$.
+ *          With shared_switch, the memory is a shared memory window of the processes of the node, allocated by the first of them, and
+ *          the returned pointer is the view of this process; otherwise the memory is allocated by new.
  *
- * \param Ux is a 3D array representing the x-component of 3D velocity field.
- * \param Uy is a 3D array representing the y-component of 3D velocity field.
- * \param Uz is a 3D array representing the z-component of 3D velocity field.
+ * \param   n is the number of values of the field.
+ *
+ * \return  The pointer to the memory of the field.
  ********************************************************************************************************************************************
  */
-void Read_Init(Array<double,3>& Ux, Array<double,3>& Uy, Array<double,3>& Uz){
-  if (rank_mpi==0)
-  {cout<<"\nGenerating the 3D velocity field: U = [x, y, z] \n";
-  }
-  for (int i=0; i<Nx; i++){
-      for (int j=0; j<Ny; j++){
-        for (int k=0; k<Nz; k++){
-            Ux(i, j, k) = i*dx;
-            Uy(i, j, k) = j*dy;
-            Uz(i, j, k) = k*dz;
-          }
+double* allocate_field(long n) {
+    if (not shared_switch) {
+        return NULL;
+    }
+    if (node_comm==MPI_COMM_NULL) {
+        int node_size;
+        MPI_Comm_split_type(comm_SF, MPI_COMM_TYPE_SHARED, rank_mpi, MPI_INFO_NULL, &node_comm);
+        MPI_Comm_rank(node_comm, &node_rank);
+        MPI_Comm_size(node_comm, &node_size);
+        if (rank_mpi==0) {
+            cout<<"Input fields shared by the "<<node_size<<" processors of the node of rank 0\n";
         }
     }
-    if (rank_mpi==0)
-    {cout<<"\nField has been generated.\n";
+    double* base;
+    MPI_Win win;
+    MPI_Aint size=(node_rank==0) ? MPI_Aint(n)*sizeof(double) : 0;
+    if (MPI_Win_allocate_shared(size, sizeof(double), MPI_INFO_NULL, node_comm, &base, &win) != MPI_SUCCESS) {
+        cerr<<"ERROR! Unable to allocate the shared memory of the input fields. Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+    int disp_unit;
+    MPI_Win_shared_query(win, 0, &size, &disp_unit, &base);
+    field_windows.push_back(win);
+    MPI_Win_fence(0, win);
+    return base;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to allocate a 3D input field, in the shared memory of the node with shared_switch.
+ ********************************************************************************************************************************************
+ */
+void allocate_field(Array<double,3>& A, int n0, int n1, int n2) {
+    double* memory=allocate_field(long(n0)*n1*n2);
+    if (memory==NULL) {
+        A.resize(n0, n1, n2);
+    }
+    else {
+        A.reference(Array<double,3>(memory, shape(n0, n1, n2), neverDeleteData));
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to allocate a 2D input field, in the shared memory of the node with shared_switch.
+ ********************************************************************************************************************************************
+ */
+void allocate_field(Array<double,2>& A, int n0, int n1) {
+    double* memory=allocate_field(long(n0)*n1);
+    if (memory==NULL) {
+        A.resize(n0, n1);
+    }
+    else {
+        A.reference(Array<double,2>(memory, shape(n0, n1), neverDeleteData));
     }
 }
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to generate an idealized 2D velocity field.
- *
- *          This function generates the following 2D velocity field.
- *          \f$u_x = x, \quad u_z = z\f$.
- *
- * \param Ux is a 2D array representing the x-component of 2D velocity field.
- * \param Uz is a 2D array representing the z-component of 2D velocity field.
+ * \brief   Function to free the shared memory windows of the input fields (of the previous snapshot in the ensemble mode).
  ********************************************************************************************************************************************
  */
-void Read_Init(Array<double,2>& Ux, Array<double,2>& Uz){
-	if (rank_mpi==0){
-		cout<<"\nGenerating the 2D velocity field: U = [x, z] \n";
-	}
-    for (int i=0;i<Nx;i++){
-      for (int k=0;k<Nz;k++){
-          Ux(i, k) = i*dx;
-          Uz(i, k) = k*dz;
-       }
-  }
-  if (rank_mpi==0)
-    {cout<<"\nField has been generated.\n";
+void free_shared_fields() {
+    for (size_t w=0; w<field_windows.size(); w++) {
+        MPI_Win_free(&field_windows[w]);
     }
+    field_windows.clear();
 }
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to generate an idealized 2D scalar field.
- *
- *          This function generates the following 2D scalar field.
- *          \f$\theta = x + z \f$
- *
- * \param T is a 2D array representing the x-component of 2D velocity field.
+ * \brief   Function returning the 64-bit FNV-1a hash of a buffer, continued from the hash h of the previous buffers.
  ********************************************************************************************************************************************
  */
-void Read_Init(Array<double,2>& T) {
-	if (rank_mpi==0){
-		cout<<"\nGenerating the scalar field: T = x + z \n";
-	}
-    for (int i=0;i<Nx;i++){
-      for (int k=0;k<Nz;k++){
-          T(i, k) = i*dx + k*dz;
-       }
-  }
-  if (rank_mpi==0)
-    {cout<<"\nField has been generated.\n";
+unsigned long long fnv_hash(const char* data, size_t n, unsigned long long h=14695981039346656037ULL) {
+    for (size_t i=0; i<n; i++) {
+        h=(h^(unsigned char)data[i])*1099511628211ULL;
     }
+    return h;
 }
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to generate an idealized 3D scalar field.
+ * \brief   Function returning a hash in hexadecimal, as used for the names in the cache.
+ ********************************************************************************************************************************************
+ */
+string hex_hash(unsigned long long h) {
+    char key[32];
+    snprintf(key, sizeof(key), "%016llx", h);
+    return key;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the identity of an input file for the cache, without reading its data: the size, the modification time
+ *          (in nanoseconds), and the inode of the file, and the type and the dimensions of the dataset from its object header.
  *
- *          This function generates the following 2D scalar field.
- *          \f$\theta = x + y + z \f$
+ *          A file rewritten in place, or replaced, changes its identity, so that the hash of its contents is computed again.
  *
- * \param T is a 3D array representing the x-component of 2D velocity field.
+ * \param   path is the name of the file.
+ * \param   name is the name of the dataset.
  ********************************************************************************************************************************************
  */
-void Read_Init(Array<double,3>& T) {
-	if (rank_mpi==0){
-		cout<<"\nGenerating the scalar field: T = x + y + z \n";
-	}
-    for (int i=0;i<Nx;i++){
-      for (int j=0;j<Ny;j++){
-          for (int k=0;k<Nz;k++){
-              T(i, j, k) = i*dx + j*dy + k*dz;
-          }
-      }
-  }
-  if (rank_mpi==0)
-    {cout<<"\nField has been generated.\n";
+string file_identity(string path, string name) {
+    struct stat info;
+    hid_t file_id=-1, dataset=-1;
+    if (stat(path.c_str(), &info) == 0) {
+        H5E_BEGIN_TRY {
+            file_id=H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+            dataset=(file_id < 0) ? -1 : H5Dopen2(file_id, name.c_str(), H5P_DEFAULT);
+        } H5E_END_TRY;
     }
+    if (dataset < 0) {
+        cerr<<"ERROR! Unable to open the dataset "<<name<<" of the input file "<<path<<" for the cache. Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+    ostringstream identity;
+    identity<<path<<" "<<info.st_size<<" "<<info.st_mtim.tv_sec<<"."<<info.st_mtim.tv_nsec<<" "<<info.st_ino;
+    hid_t type=H5Dget_type(dataset);
+    hid_t space=H5Dget_space(dataset);
+    hsize_t dims[8];
+    int rank=H5Sget_simple_extent_dims(space, dims, NULL);
+    identity<<" "<<H5Tget_class(type)<<" "<<H5Tget_size(type);
+    for (int d=0; d<rank and d<8; d++) {
+        identity<<" "<<dims[d];
+    }
+    H5Sclose(space);
+    H5Tclose(type);
+    H5Dclose(dataset);
+    H5Fclose(file_id);
+    return identity.str();
 }
 
-
-
 /**
  ********************************************************************************************************************************************
- * \brief   Function to calculate the longitudinal and transverse structure functions for a 3D velocity field.
+ * \brief   Function returning the hash of the contents of an input file for the cache.
  *
+ *          The hash of the contents is computed once and stored in the group "files" of the cache under the hash of the identity of the
+ *          file (see file_identity()). As long as the identity is unchanged, the stored hash is used without reading the file; otherwise
+ *          the file is read and hashed again, so that a rewritten input never serves stale values, while a copied or touched input with
+ *          the same contents still hits the cache.
  *
- * \param Ux is a 3D array representing the x-component of velocity field
- * \param Uy is a 3D array representing the y-component of velocity field
- * \param Uz is a 3D array representing the z-component of velocity field
+ * \param   cache_id is the identifier of the cache file, or negative if there is no cache file.
+ * \param   path is the name of the file.
+ * \param   name is the name of the dataset.
  ********************************************************************************************************************************************
  */
-void SFunc3D(
-        Array<double,3> Ux,
-        Array<double,3> Uy,
-        Array<double,3> Uz)
-{
-	if (rank_mpi==0) {
-        cout<<"\nComputing longitudinal and transverse S(lx, ly, lz) using 3D velocity field data..\n";
+string file_hash(hid_t cache_id, string path, string name) {
+    string identity=file_identity(path, name);
+    string link="files/"+hex_hash(fnv_hash(identity.data(), identity.size()));
+    unsigned long long h=0;
+    if (cache_id >= 0 and H5Lexists(cache_id, "files", H5P_DEFAULT) > 0 and H5Lexists(cache_id, link.c_str(), H5P_DEFAULT) > 0) {
+        hid_t dataset=H5Dopen2(cache_id, link.c_str(), H5P_DEFAULT);
+        H5Dread(dataset, H5T_NATIVE_ULLONG, H5S_ALL, H5S_ALL, H5P_DEFAULT, &h);
+        H5Dclose(dataset);
+        return hex_hash(h);
     }
-    int c_per_proc = Nx*Ny/(4*P);
-
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Ny);
-    Array<double,3> dUx;
-    Array<double,3> dUy;
-    Array<double,3> dUz;
-    Array<double,3> dUpll;
-    
-    for (int ix=0; ix<c_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int y=index_list(ix, 1, rank_mpi);
-  		for(int z=0; z<Nz/2; z++){
-            
-  			dUx.resize(Nx-x,Ny-y,Nz-z);
-  			dUy.resize(Nx-x,Ny-y,Nz-z);
-  			dUz.resize(Nx-x,Ny-y,Nz-z);
-            dUpll.resize(Nx-x,Ny-y,Nz-z);
-        		
-        	int count=(Nx-x)*(Ny-y)*(Nz-z);
-        	double lx=x*dx;
-        	double ly=y*dy;
-        	double lz=z*dz;
-
-        	double r=sqrt(lx*lx+ly*ly+lz*lz);
-        	dUx(Range::all(),Range::all(),Range::all())=Ux(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Ux(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-        	dUy(Range::all(),Range::all(),Range::all())=Uy(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Uy(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-        	dUz(Range::all(),Range::all(),Range::all())=Uz(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Uz(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-        		
-        	
-            dUpll=(lx*dUx+ly*dUy+lz*dUz)/r;
-        
-        	dUx=dUx-dUpll*lx/r;
-        	dUy=dUy-dUpll*ly/r;
-        	dUz=dUz-dUpll*lz/r;
-
-            
-        	dUx=pow(dUx*dUx+dUy*dUy+dUz*dUz,0.5);
-            
-        	for (int p=0; p<=q2-q1; p++){
-        		double Spll = sum(pow(dUpll(Range::all(),Range::all(),Range::all()),q1+p))/(count);
-        		double Sperp =sum(pow(dUx(Range::all(),Range::all(),Range::all()),q1+p))/(count);
-                Array<int, 1> X, Y, Z, p_arr;
-                Array<double, 1> Spll_arr, Sperp_arr;
-                
-                if (rank_mpi==0) {
-                    X.resize(P);
-                    Y.resize(P);
-                    Z.resize(P);
-                    p_arr.resize(P);
-                    Spll_arr.resize(P);
-                    Sperp_arr.resize(P);
-                }
-        
-                MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&y, 1, MPI_INT, Y.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&Spll, 1, MPI_DOUBLE, Spll_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-                MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&Sperp, 1, MPI_DOUBLE, Sperp_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-
-                if (rank_mpi==0) {
-                    for (int i=0; i<P; i++) {
-                        SF_Grid_pll(X(i), Y(i), Z(i), p_arr(i)) = Spll_arr(i);
-                        SF_Grid_perp(X(i), Y(i), Z(i), p_arr(i)) = Sperp_arr(i);
-                    } 
-                }
 
-        	}
-  		}
-  	}
-    if (rank_mpi==0) {
-        SF_Grid_pll(0,0,0,Range::all())=0;
-        SF_Grid_perp(0,0,0,Range::all())=0;
+    FILE* file=fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        cerr<<"ERROR! Unable to read the input file "<<path<<" for the cache. Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+    vector<char> buffer(1<<20);
+    size_t n;
+    h=fnv_hash(NULL, 0);
+    while ((n=fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+        h=fnv_hash(buffer.data(), n, h);
     }
+    fclose(file);
+    cache_hashes.push_back(make_pair(link, h));
+    return hex_hash(h);
 }
 
-
 /**
  ********************************************************************************************************************************************
- * \brief   Function to calculate only the longitudinal structure functions for a 3D velocity field.
+ * \brief   Function returning the name of the group of the cache for the current inputs and parameters.
  *
- * \param Ux is a 3D array representing the x-component of velocity field
- * \param Uy is a 3D array representing the y-component of velocity field
- * \param Uz is a 3D array representing the z-component of velocity field
+ *          The name is the hash of the parameters that change the structure functions of a displacement vector (the grid, the domain,
+ *          the kind of fields, and the mask), followed by the names of the datasets and the hashes of the contents of the input files
+ *          (see file_hash()), so that the orders computed from other fields or parameters are never served.
  ********************************************************************************************************************************************
  */
-void SFunc_long_3D(
-        Array<double,3> Ux,
-        Array<double,3> Uy,
-        Array<double,3> Uz)
-{
-if (rank_mpi==0) {
-        cout<<"\nComputing longitudinal S(lx, ly, lz) using 3D velocity field data..\n";
+string cache_group() {
+    ostringstream para;
+    para.precision(17);
+    para<<Nx<<" "<<Ny<<" "<<Nz<<" "<<Lx<<" "<<Ly<<" "<<Lz<<" "<<two_dimension_switch<<" "<<scalar_switch;
+    vector<string> names;
+    if (scalar_switch) {
+        names=scalar_names;
     }
-    
-    int c_per_proc = Nx*Ny/(4*P);
-
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Ny);
-    Array<double,3> dUx;
-    Array<double,3> dUy;
-    Array<double,3> dUz;
-    Array<double,3> dUpll;
-    
-    for (int ix=0; ix<c_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int y=index_list(ix, 1, rank_mpi);
-  		for(int z=0; z<Nz/2; z++){
-  			dUx.resize(Nx-x,Ny-y,Nz-z);
-			dUy.resize(Nx-x,Ny-y,Nz-z);
-  			dUz.resize(Nx-x,Ny-y,Nz-z);
-            dUpll.resize(Nx-x,Ny-y,Nz-z);
-        		
-    		int count=(Nx-x)*(Ny-y)*(Nz-z);
-    		double lx=x*dx;
-    		double ly=y*dy;
-    		double lz=z*dz;
-
-    		double r=sqrt(lx*lx+ly*ly+lz*lz);
-    		dUx(Range::all(),Range::all(),Range::all())=Ux(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Ux(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-    		dUy(Range::all(),Range::all(),Range::all())=Uy(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Uy(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-    		dUz(Range::all(),Range::all(),Range::all())=Uz(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Uz(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-
-            dUpll=(lx*dUx+ly*dUy+lz*dUz)/r;
-        		
-
-    		for (int p=0; p<=q2-q1; p++){
-    			double Spll = sum(pow(dUpll(Range::all(),Range::all(),Range::all()),q1+p))/(count);
-                Array<int, 1> X, Y, Z, p_arr;
-                Array<double, 1> Spll_arr;
-                
-                if (rank_mpi==0) {
-                    X.resize(P);
-                    Y.resize(P);
-                    Z.resize(P);
-                    p_arr.resize(P);
-                    Spll_arr.resize(P);
-                }
-        
-                MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&y, 1, MPI_INT, Y.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&Spll, 1, MPI_DOUBLE, Spll_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-                MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-                if (rank_mpi==0) {
-                    for (int i=0; i<P; i++) {
-                        SF_Grid_pll(X(i), Y(i), Z(i), p_arr(i)) = Spll_arr(i);
-                    }
-                }
-
-    		}
-  		}
-  	}
-    if (rank_mpi==0) {
-  	    SF_Grid_pll(0,0,0,Range::all())=0;
+    else {
+        names.push_back("U.V1r");
+        if (not two_dimension_switch) {
+            names.push_back("U.V2r");
+        }
+        names.push_back("U.V3r");
+    }
+    hid_t cache_id=-1;
+    H5E_BEGIN_TRY {
+        cache_id=(access(cache_file.c_str(), F_OK) == 0) ? H5Fopen(cache_file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT) : -1;
+    } H5E_END_TRY;
+    cache_hashes.clear();
+    for (size_t f=0; f<names.size(); f++) {
+        para<<" "<<names[f]<<" "<<file_hash(cache_id, in_folder+names[f]+".h5", names[f]);
     }
+    if (mask_switch) {
+        para<<" mask "<<mask_condition<<" "<<mask_threshold<<" ";
+        para<<((mask_condition==0) ? file_hash(cache_id, "in/mask.h5", "mask") : file_hash(cache_id, in_folder+"T.Fr.h5", "T.Fr"));
+    }
+    if (cache_id >= 0) {
+        H5Fclose(cache_id);
+    }
+    string text=para.str();
+    return hex_hash(fnv_hash(text.data(), text.size()));
 }
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to list the arrays of the structure functions stored in the cache, with their names in the cache.
+ ********************************************************************************************************************************************
+ */
+vector<ensemble_array> cache_arrays() {
+    vector<ensemble_array> list;
+    add_ensemble_array(list, "pll", SF_Grid_pll.data(), SF_Grid_pll.size());
+    add_ensemble_array(list, "perp", SF_Grid_perp.data(), SF_Grid_perp.size());
+    add_ensemble_array(list, "scalar", SF_Grid_scalar.data(), SF_Grid_scalar.size());
+    add_ensemble_array(list, "pll", SF_Grid2D_pll.data(), SF_Grid2D_pll.size());
+    add_ensemble_array(list, "perp", SF_Grid2D_perp.data(), SF_Grid2D_perp.size());
+    add_ensemble_array(list, "scalar", SF_Grid2D_scalar.data(), SF_Grid2D_scalar.size());
+    return list;
+}
 
-
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the number of displacement vectors of the grid, \f$ (N_x/2)(N_y/2)(N_z/2) \f$.
+ ********************************************************************************************************************************************
+ */
+long cache_points() {
+    return long(Nx/2)*(two_dimension_switch ? 1 : Ny/2)*(Nz/2);
+}
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to calculate the longitudinal and transverse structure functions for a 2D velocity field.
+ * \brief   Function returning the name of the dataset of the cache that serves an array, or an empty string if there is none.
  *
- *        
- * \param Ux is a 2D array representing the x-component of velocity field
- * \param Uz is a 2D array representing the z-component of velocity field
+ *          The datasets of the signed lags have the prefix "signed_"; they also serve the runs without signed lags.
+ *
+ * \param   file_id is the identifier of the cache file, or negative if there is no cache file.
+ * \param   name is the name of the array in the cache, followed by "_q" and the order for the structure functions.
  ********************************************************************************************************************************************
  */
- void SFunc2D(
-         Array<double,2> Ux,
-         Array<double,2> Uz)
- {
-     if (rank_mpi==0) {
-         cout<<"\nComputing longitudinal and transverse S(lx, lz) using 2D velocity field data..\n";
-     }
-
-    int p_per_proc = Nx*Nz/(4*P);
-
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Nz);
-    Array<double,2> dUz;
-    Array<double,2> dUx;
-    Array<double,2> dUpll;
-    
-    for (int ix=0; ix<p_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int z=index_list(ix, 1, rank_mpi);
-        dUx.resize(Nx-x,Nz-z);
-        dUz.resize(Nx-x,Nz-z);
-        dUpll.resize(Nx-x,Nz-z);
-        int count=(Nx-x)*(Nz-z);
-        double lx=x*dx;
-        double lz=z*dz;
-        double r=sqrt(lx*lx+lz*lz);
-
-        dUx(Range::all(),Range::all())=Ux(Range(x,Nx-1),Range(z,Nz-1))-Ux(Range(0,Nx-x-1),Range(0,Nz-z-1));
-        dUz(Range::all(),Range::all())=Uz(Range(x,Nx-1),Range(z,Nz-1))-Uz(Range(0,Nx-x-1),Range(0,Nz-z-1));
-        	
-        dUpll=(lx*dUx+lz*dUz)/r;
-        dUx=dUx-dUpll*lx/r;
-        dUz=dUz-dUpll*lz/r;
-        dUx=pow(dUx*dUx+dUz*dUz,0.5);
-
-    	for (int p=0; p<=q2-q1; p++){
-            double Spll = sum(pow(dUpll(Range::all(),Range::all()),q1+p))/(count);
-            double Sperp =sum(pow(dUx(Range::all(),Range::all()),q1+p))/(count);
-            Array<int, 1> X, Z, p_arr;
-            Array<double, 1> Spll_arr, Sperp_arr;
-            
-            if (rank_mpi==0) {
-                X.resize(P);
-                Z.resize(P);
-                p_arr.resize(P);
-                Spll_arr.resize(P);
-                Sperp_arr.resize(P);
-            }
-        
-            MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&Spll, 1, MPI_DOUBLE, Spll_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-            MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&Sperp, 1, MPI_DOUBLE, Sperp_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-
-            if (rank_mpi==0) {
-                for (int i=0; i<P; i++) {
-                    SF_Grid2D_pll(X(i), Z(i), p_arr(i)) = Spll_arr(i);
-                    SF_Grid2D_perp(X(i), Z(i), p_arr(i)) = Sperp_arr(i);
-                } 
-            } 
-        } 
+string cache_dataset(hid_t file_id, string name) {
+    if (file_id < 0 or H5Lexists(file_id, cache_key.c_str(), H5P_DEFAULT) <= 0) {
+        return "";
     }
-    if (rank_mpi==0) {
-        SF_Grid2D_pll(0,0,Range::all())=0;
-        SF_Grid2D_perp(0,0,Range::all())=0;
+    string path=cache_key+"/signed_"+name;
+    if (H5Lexists(file_id, path.c_str(), H5P_DEFAULT) > 0) {
+        return path;
     }
-    
+    path=cache_key+"/"+name;
+    if (not signed_switch and H5Lexists(file_id, path.c_str(), H5P_DEFAULT) > 0) {
+        return path;
+    }
+    return "";
 }
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to calculate only the longitudinal structure functions for a 2D velocity field.
+ * \brief   Function to read one order of an array from the cache.
  *
- *         
- * \param Ux is a 2D array representing the x-component of velocity field
- * \param Uz is a 2D array representing the z-component of velocity field
+ *          The array stores blocks of \f$ q_2-q_1+1 \f$ orders for every displacement vector, one block per slot of lag_signs() (and per
+ *          scalar field). A dataset of the signed lags serving a run without signed lags provides the slot of the positive variants.
+ *
+ * \param   file_id is the identifier of the cache file.
+ * \param   path is the dataset, as given by cache_dataset().
+ * \param   data stores the array.
+ * \param   n is the size of the array.
+ * \param   nq is the number of orders of the array, or 1 for the numbers of pairs.
+ * \param   p is the index of the order in the array.
  ********************************************************************************************************************************************
  */
-void SFunc_long_2D(
-         Array<double,2> Ux,
-         Array<double,2> Uz)
- {
-     if (rank_mpi==0) {
-         cout<<"\nComputing longitudinal S(lx, lz) using 2D velocity field data..\n";
-     }
-
-    int p_per_proc = Nx*Nz/(4*P);
-
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Nz);
-    Array<double,2> dUz;
-    Array<double,2> dUx;
-    Array<double,2> dUpll;
-    
-    for (int ix=0; ix<p_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int z=index_list(ix, 1, rank_mpi);
-        dUx.resize(Nx-x,Nz-z);
-        dUz.resize(Nx-x,Nz-z);
-        dUpll.resize(Nx-x,Nz-z);
-        int count=(Nx-x)*(Nz-z);
-        double lx=x*dx;
-        double lz=z*dz;
-        double r=sqrt(lx*lx+lz*lz);
-
-        dUx(Range::all(),Range::all())=Ux(Range(x,Nx-1),Range(z,Nz-1))-Ux(Range(0,Nx-x-1),Range(0,Nz-z-1));
-        dUz(Range::all(),Range::all())=Uz(Range(x,Nx-1),Range(z,Nz-1))-Uz(Range(0,Nx-x-1),Range(0,Nz-z-1));
-            
-        dUpll=(lx*dUx+lz*dUz)/r;
-
-        for (int p=0; p<=q2-q1; p++){
-            double Spll = sum(pow(dUpll(Range::all(),Range::all()),q1+p))/(count);
-            Array<int, 1> X, Z, p_arr;
-            Array<double, 1> Spll_arr;
-            
-            if (rank_mpi==0) {
-                X.resize(P);
-                Z.resize(P);
-                p_arr.resize(P);
-                Spll_arr.resize(P);
-            }
-        
-            MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&Spll, 1, MPI_DOUBLE, Spll_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-            MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+void read_cache(hid_t file_id, string path, double* data, long n, int nq, int p) {
+    long points=cache_points();
+    int blocks=n/(points*nq);
+    hid_t dataset=H5Dopen2(file_id, path.c_str(), H5P_DEFAULT);
+    hid_t space=H5Dget_space(dataset);
+    long size=H5Sget_simple_extent_npoints(space);
+    H5Sclose(space);
+    //Number of slots per field of the dataset and of the array
+    int ls=lag_signs(), cls=ls*(size/points)/blocks;
+    vector<double> values(size);
+    if (size%points != 0 or H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data()) < 0) {
+        cerr<<"ERROR! Unable to read the dataset "<<path<<" of the cache "<<cache_file<<". Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+    H5Dclose(dataset);
+    int cblocks=size/points;
+    for (long i=0; i<points; i++) {
+        for (int b=0; b<blocks; b++) {
+            data[(i*blocks+b)*nq+p]=values[i*cblocks+(b/ls)*cls+b%ls];
+        }
+    }
+}
 
-            if (rank_mpi==0) {
-                for (int i=0; i<P; i++) {
-                    SF_Grid2D_pll(X(i), Z(i), p_arr(i)) = Spll_arr(i);
-                } 
-            }
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write one order of an array to the cache, replacing the dataset if it exists (see read_cache()).
+ ********************************************************************************************************************************************
+ */
+void write_cache(hid_t file_id, string name, const double* data, long n, int nq, int p) {
+    long points=cache_points();
+    int blocks=n/(points*nq);
+    vector<double> values(points*blocks);
+    for (long i=0; i<points; i++) {
+        for (int b=0; b<blocks; b++) {
+            values[i*blocks+b]=data[(i*blocks+b)*nq+p];
         }
     }
-    if (rank_mpi==0) {
-        SF_Grid2D_pll(0,0,Range::all())=0;
+    string path=cache_key+"/"+(signed_switch ? "signed_" : "")+name;
+    if (H5Lexists(file_id, path.c_str(), H5P_DEFAULT) > 0) {
+        H5Ldelete(file_id, path.c_str(), H5P_DEFAULT);
     }
-    
+    hsize_t size=values.size();
+    hid_t space=H5Screate_simple(1, &size, NULL);
+    hid_t dataset=H5Dcreate2(file_id, path.c_str(), H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if (dataset < 0 or H5Dwrite(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data()) < 0) {
+        cerr<<"ERROR! Unable to write the dataset "<<path<<" of the cache "<<cache_file<<". Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+    H5Dclose(dataset);
+    H5Sclose(space);
 }
 
-
-
 /**
  ********************************************************************************************************************************************
- * \brief   Function to calculate structure functions for a 3D scalar field.
+ * \brief   Function to find the orders missing from the cache and to set q1 and q2 to the orders to be computed.
  *
- * \param T is a 3D array representing the scalar field
+ *          The orders from the first to the last missing order are computed, since the powers of the increments are accumulated by
+ *          successive multiplication (see add_powers()); their cost is small compared with that of the increments. If all the orders
+ *          requested are stored in the cache, cache_hit is set and the input fields are not read.
  ********************************************************************************************************************************************
  */
-
-
-void SF_scalar_3D(
-         Array<double,3> T)
- {
-     if (rank_mpi==0) {
-         cout<<"\nComputing S(lx, ly, lz) using 3D scalar field data..\n";
-     }
-    
-    int c_per_proc = Nx*Ny/(4*P);
-
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Ny);
-    Array<double,3> dT;
-    
-    for (int ix=0; ix<c_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int y=index_list(ix, 1, rank_mpi);
-        for(int z=0; z<Nz/2; z++){
-            dT.resize(Nx-x,Ny-y,Nz-z);
-                
-            int count=(Nx-x)*(Ny-y)*(Nz-z);
-            double r=sqrt(x*x*dx*dx+y*y*dy*dy+z*z*dz*dz);
-
-            dT(Range::all(),Range::all(),Range::all())=T(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-T(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-                
-
-            for (int p=0; p<=q2-q1; p++){
-                double St = sum(pow(dT(Range::all(),Range::all(),Range::all()),q1+p))/(count);
-                Array<int, 1> X, Y, Z, p_arr;
-                Array<double, 1> St_arr;
-                
-                if (rank_mpi==0) {
-                    X.resize(P);
-                    Y.resize(P);
-                    Z.resize(P);
-                    p_arr.resize(P);
-                    St_arr.resize(P);
+void open_cache() {
+    cache_q1=q1;
+    cache_q2=q2;
+    int range[2]={q1, q2};
+    if (rank_mpi==0) {
+        cache_key=cache_group();
+        H5E_BEGIN_TRY {
+            hid_t file_id=(access(cache_file.c_str(), F_OK) == 0) ? H5Fopen(cache_file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT) : -1;
+            vector<string> names;
+            if (scalar_switch) {
+                names.push_back("scalar");
+            }
+            else {
+                names.push_back("pll");
+                if (not longitudinal) {
+                    names.push_back("perp");
                 }
-        
-                MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&y, 1, MPI_INT, Y.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&St, 1, MPI_DOUBLE, St_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-                MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-                if (rank_mpi==0) {
-                    for (int i=0; i<P; i++) {
-                        SF_Grid_scalar(X(i), Y(i), Z(i), p_arr(i)) = St_arr(i);
+            }
+            range[0]=q2+1;
+            range[1]=q1-1;
+            for (int q=q1; q<=q2; q++) {
+                for (size_t a=0; a<names.size(); a++) {
+                    if (cache_dataset(file_id, names[a]+"_q"+int_to_str(q)).empty()) {
+                        range[0]=min(range[0], q);
+                        range[1]=max(range[1], q);
                     }
                 }
-
             }
-                
+            //The numbers of pairs inside the mask are obtained with any order
+            if (mask_switch and range[0] > range[1] and cache_dataset(file_id, "count").empty()) {
+                range[0]=range[1]=q1;
+            }
+            if (file_id >= 0) {
+                H5Fclose(file_id);
+            }
+        } H5E_END_TRY;
+        if (range[0] > range[1]) {
+            cout<<"\nAll the orders are found in the cache "<<cache_file<<" (inputs "<<cache_key<<")\n";
+        }
+        else {
+            cout<<"\nComputing the orders "<<range[0]<<" to "<<range[1]<<" missing from the cache "<<cache_file<<" (inputs "<<cache_key<<")\n";
         }
     }
-    if (rank_mpi==0) {
-        SF_Grid_scalar(0,0,0,Range::all())=0;
+    MPI_Bcast(range, 2, MPI_INT, 0, comm_SF);
+    cache_hit=(range[0] > range[1]);
+    if (not cache_hit) {
+        q1=range[0];
+        q2=range[1];
     }
-
-
- }
+}
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to calculate structure functions for a 2D scalar field.
- *
- *
- * \param T is a 2D array representing the scalar field
+ * \brief   Function to store the orders computed in the cache, and to assemble the structure functions of the orders requested from the
+ *          orders computed and those of the cache (rank 0).
  ********************************************************************************************************************************************
  */
-void SF_scalar_2D(Array<double,2> T)
- {
-     if (rank_mpi==0) {
-         cout<<"\nComputing S(lx, lz) using 2D scalar field data..\n";
-     }
+void close_cache() {
+    if (rank_mpi!=0) {
+        q1=cache_q1;
+        q2=cache_q2;
+        return;
+    }
+    mkdir("out",0777);
+    hid_t file_id=-1;
+    H5E_BEGIN_TRY {
+        file_id=(access(cache_file.c_str(), F_OK) == 0) ? H5Fopen(cache_file.c_str(), H5F_ACC_RDWR, H5P_DEFAULT)
+                                                        : H5Fcreate(cache_file.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    } H5E_END_TRY;
+    if (file_id < 0) {
+        cerr<<"ERROR! Unable to open the cache "<<cache_file<<". Aborting..\n";
+        MPI_Abort(comm_SF, 1);
+    }
+    if (H5Lexists(file_id, cache_key.c_str(), H5P_DEFAULT) <= 0) {
+        H5Gclose(H5Gcreate2(file_id, cache_key.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT));
+    }
 
-    int p_per_proc = Nx*Nz/(4*P);
+    //Store the hashes of the contents of the input files hashed by this run
+    if (not cache_hashes.empty() and H5Lexists(file_id, "files", H5P_DEFAULT) <= 0) {
+        H5Gclose(H5Gcreate2(file_id, "files", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT));
+    }
+    for (size_t f=0; f<cache_hashes.size(); f++) {
+        if (H5Lexists(file_id, cache_hashes[f].first.c_str(), H5P_DEFAULT) > 0) {
+            continue;
+        }
+        hid_t space=H5Screate(H5S_SCALAR);
+        hid_t dataset=H5Dcreate2(file_id, cache_hashes[f].first.c_str(), H5T_NATIVE_ULLONG, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Dwrite(dataset, H5T_NATIVE_ULLONG, H5S_ALL, H5S_ALL, H5P_DEFAULT, &cache_hashes[f].second);
+        H5Dclose(dataset);
+        H5Sclose(space);
+    }
 
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Nz);
-    Array<double,2> dT;
-    
-    for (int ix=0; ix<p_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int z=index_list(ix, 1, rank_mpi);
-       			
-        dT.resize(Nx-x,Nz-z);
-        int count=(Nx-x)*(Nz-z);
-
-        dT(Range::all(),Range::all())=T(Range(x,Nx-1),Range(z,Nz-1))-T(Range(0,Nx-x-1),Range(0,Nz-z-1));
-        		
-        for (int p=0; p<=q2-q1; p++){
-            double St = sum(pow(dT(Range::all(),Range::all()),q1+p))/(count);
-            Array<int, 1> X, Z, p_arr;
-            Array<double, 1> St_arr;
-            
-            if (rank_mpi==0) {
-                X.resize(P);
-                Z.resize(P);
-                p_arr.resize(P);
-                St_arr.resize(P);
+    //Store the orders computed and keep them for the orders requested
+    vector<ensemble_array> arrays=cache_arrays();
+    vector<vector<double> > computed(arrays.size());
+    int nq=q2-q1+1;
+    if (not cache_hit) {
+        for (size_t a=0; a<arrays.size(); a++) {
+            for (int q=q1; q<=q2; q++) {
+                write_cache(file_id, arrays[a].name+"_q"+int_to_str(q), arrays[a].data, arrays[a].n, nq, q-q1);
             }
-        
-            MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&St, 1, MPI_DOUBLE, St_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-            MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+            computed[a].assign(arrays[a].data, arrays[a].data+arrays[a].n);
+        }
+        if (mask_switch) {
+            write_cache(file_id, "count", two_dimension_switch ? SF_Grid2D_count.data() : SF_Grid_count.data(),
+                        two_dimension_switch ? SF_Grid2D_count.size() : SF_Grid_count.size(), 1, 0);
+        }
+    }
+    int c1=q1, c2=q2;
+    q1=cache_q1;
+    q2=cache_q2;
+    resize_SFs();
 
-            if (rank_mpi==0) {
-                for (int i=0; i<P; i++) {
-                    SF_Grid2D_scalar(X(i), Z(i), p_arr(i)) = St_arr(i);
-                } 
+    arrays=cache_arrays();
+    nq=q2-q1+1;
+    for (size_t a=0; a<arrays.size(); a++) {
+        for (int q=q1; q<=q2; q++) {
+            if (not cache_hit and q >= c1 and q <= c2) {
+                long points=cache_points();
+                int blocks=arrays[a].n/(points*nq);
+                for (long i=0; i<points*blocks; i++) {
+                    arrays[a].data[i*nq+q-q1]=computed[a][i*(c2-c1+1)+q-c1];
+                }
+            }
+            else {
+                read_cache(file_id, cache_dataset(file_id, arrays[a].name+"_q"+int_to_str(q)), arrays[a].data, arrays[a].n, nq, q-q1);
             }
         }
     }
-    if (rank_mpi==0) {
-        SF_Grid2D_scalar(0,0,Range::all())=0;
+    if (mask_switch) {
+        read_cache(file_id, cache_dataset(file_id, "count"), two_dimension_switch ? SF_Grid2D_count.data() : SF_Grid_count.data(),
+                   two_dimension_switch ? SF_Grid2D_count.size() : SF_Grid_count.size(), 1, 0);
     }
- }
-
+    H5Fclose(file_id);
+}
@@ -0,0 +1,339 @@
+/********************************************************************************************************************************************
+ * fastSF
+ *
+ * Copyright (C) 2020, Mahendra K. Verma
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     1. Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *     2. Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *     3. Neither the name of the copyright holder nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ********************************************************************************************************************************************
+ */
+
+/*! \file fastsf_module.cc
+ *
+ *  \brief Python module computing structure functions of numpy arrays in-process.
+ *
+ *  The module compiles fastSF.cc without its main function and calls the same threaded kernels. The input arrays are used in place
+ *  when they are C-contiguous arrays of doubles, and the structure functions are computed directly into the numpy arrays that are
+ *  returned, so that nothing is copied and no file is written. The computation runs on the calling process with OpenMP threads.
+ *
+ *  \author Shubhadeep Sadhukhan, Shashwat Bhattacharya, Mahendra K. Verma
+ *  \date Feb 2020
+ *  \copyright New BSD License
+ *
+ ********************************************************************************************************************************************
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#define FASTSF_NO_MAIN
+#include "fastSF.cc"
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to view a numpy array as a 3D Blitz array without copying (a 2D array is viewed with \f$ N_y = 1 \f$).
+ ********************************************************************************************************************************************
+ */
+static Array<double,3> view_3D(PyArrayObject* a) {
+    return Array<double,3>((double*) PyArray_DATA(a), shape(Nx, Ny, Nz), neverDeleteData);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to view a numpy array as a 2D Blitz array without copying.
+ ********************************************************************************************************************************************
+ */
+static Array<double,2> view_2D(PyArrayObject* a) {
+    return Array<double,2>((double*) PyArray_DATA(a), shape(Nx, Nz), neverDeleteData);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to create the numpy array of the structure functions and to let the corresponding global array use its memory.
+ *
+ * \param   grid is the 4D global array of the structure functions (3D fields).
+ * \param   grid2D is the 3D global array of the structure functions (2D fields).
+ * \param   nq is the number of orders, or 0 for a single value per displacement vector (the numpy array then has no order dimension).
+ *
+ * \return  The new numpy array, filled with zeros.
+ ********************************************************************************************************************************************
+ */
+static PyObject* new_SF(Array<double,4>& grid, Array<double,3>& grid2D, int nq) {
+    PyObject* a;
+    int m=max(nq, 1);
+    if (two_dimension_switch) {
+        npy_intp dims[3]={Nx/2, Nz/2, nq};
+        a=PyArray_ZEROS(nq > 0 ? 3 : 2, dims, NPY_DOUBLE, 0);
+        if (a != NULL) {
+            grid2D.reference(Array<double,3>((double*) PyArray_DATA((PyArrayObject*) a), shape(Nx/2, Nz/2, m), neverDeleteData));
+        }
+    }
+    else {
+        npy_intp dims[4]={Nx/2, Ny/2, Nz/2, nq};
+        a=PyArray_ZEROS(nq > 0 ? 4 : 3, dims, NPY_DOUBLE, 0);
+        if (a != NULL) {
+            grid.reference(Array<double,4>((double*) PyArray_DATA((PyArrayObject*) a), shape(Nx/2, Ny/2, Nz/2, m), neverDeleteData));
+        }
+    }
+    return a;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to release the references of the global arrays to the memory of the numpy arrays.
+ ********************************************************************************************************************************************
+ */
+static void release_views() {
+    T.reference(Array<double,3>());
+    V1.reference(Array<double,3>());
+    V2.reference(Array<double,3>());
+    V3.reference(Array<double,3>());
+    T_2D.reference(Array<double,2>());
+    V1_2D.reference(Array<double,2>());
+    V3_2D.reference(Array<double,2>());
+    SF_Grid_pll.reference(Array<double,4>());
+    SF_Grid_perp.reference(Array<double,4>());
+    SF_Grid_scalar.reference(Array<double,4>());
+    SF_Grid_count.reference(Array<double,4>());
+    SF_Grid2D_pll.reference(Array<double,3>());
+    SF_Grid2D_perp.reference(Array<double,3>());
+    SF_Grid2D_scalar.reference(Array<double,3>());
+    SF_Grid2D_count.reference(Array<double,3>());
+    mask_runs.clear();
+    mask_rows.clear();
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Python function structure_functions(fields, L=None, q1=1, q2=4, longitudinal=False, mask=None, threads=0).
+ *
+ *          fields is a 2D or 3D array for a scalar field, or a sequence of the velocity components, (u_x, u_z) for 2D fields and
+ *          (u_x, u_y, u_z) for 3D fields. L gives the lengths of the domain, (L_x, L_z) or (L_x, L_y, L_z) (1 by default). mask is an
+ *          optional array of the same shape; only the pairs of points where both values are nonzero are used. threads sets the number of
+ *          OpenMP threads (0 keeps the current setting).
+ *
+ *          The function returns a dictionary with the arrays "pll" and "perp" (velocity) or "scalar", of shape
+ *          (N_x/2, [N_y/2,] N_z/2, q2-q1+1), and "count" (number of valid pairs of every displacement) if a mask is given.
+ ********************************************************************************************************************************************
+ */
+static PyObject* structure_functions(PyObject* self, PyObject* args, PyObject* kwds) {
+    static const char* kwlist[]={"fields", "L", "q1", "q2", "longitudinal", "mask", "threads", NULL};
+    PyObject *fields_obj, *L_obj=Py_None, *mask_obj=Py_None;
+    int q1_in=1, q2_in=4, long_in=0, threads=0;
+    if (not PyArg_ParseTupleAndKeywords(args, kwds, "O|OiipOi", (char**) kwlist, &fields_obj, &L_obj, &q1_in, &q2_in, &long_in,
+                                        &mask_obj, &threads)) {
+        return NULL;
+    }
+
+    //Views of the inputs; a copy is made only if an input is not a C-contiguous array of doubles
+    vector<PyObject*> fields;
+    if (PyArray_Check(fields_obj)) {
+        fields.push_back(PyArray_FROMANY(fields_obj, NPY_DOUBLE, 2, 3, NPY_ARRAY_IN_ARRAY));
+    }
+    else if (PySequence_Check(fields_obj)) {
+        for (Py_ssize_t c=0; c<PySequence_Size(fields_obj); c++) {
+            PyObject* item=PySequence_GetItem(fields_obj, c);
+            fields.push_back(item == NULL ? NULL : PyArray_FROMANY(item, NPY_DOUBLE, 2, 3, NPY_ARRAY_IN_ARRAY));
+            Py_XDECREF(item);
+        }
+    }
+    PyObject* mask_arr=NULL;
+    if (mask_obj != Py_None) {
+        mask_arr=PyArray_FROMANY(mask_obj, NPY_DOUBLE, 2, 3, NPY_ARRAY_IN_ARRAY);
+    }
+
+    PyObject* result=NULL;
+    PyObject *S1=NULL, *S2=NULL, *Np=NULL;
+    int ndim=0;
+    double Ld[3]={1, 1, 1};
+    const char* error=NULL;
+
+    for (size_t c=0; c<fields.size(); c++) {
+        if (fields[c] == NULL) {
+            goto done;
+        }
+    }
+    if ((mask_obj != Py_None and mask_arr == NULL) or PyErr_Occurred()) {
+        goto done;
+    }
+    if (fields.size() < 1 or fields.size() > 3) {
+        error="fields must be an array (scalar field) or a sequence of 2 or 3 arrays (velocity field)";
+        goto done;
+    }
+    ndim=PyArray_NDIM((PyArrayObject*) fields[0]);
+    for (size_t c=0; c<fields.size(); c++) {
+        if (not PyArray_SAMESHAPE((PyArrayObject*) fields[c], (PyArrayObject*) fields[0])) {
+            error="all the fields must have the same shape";
+            goto done;
+        }
+    }
+    if (mask_arr != NULL and not PyArray_SAMESHAPE((PyArrayObject*) mask_arr, (PyArrayObject*) fields[0])) {
+        error="the mask must have the same shape as the fields";
+        goto done;
+    }
+    if (fields.size() > 1 and int(fields.size()) != ndim) {
+        error="a 2D velocity field needs 2 components (u_x, u_z), and a 3D velocity field 3 components (u_x, u_y, u_z)";
+        goto done;
+    }
+    if (q1_in > q2_in) {
+        error="q1 must not be greater than q2";
+        goto done;
+    }
+    if (L_obj != Py_None) {
+        PyObject* L_seq=PySequence_Fast(L_obj, "L must be a sequence of the lengths of the domain");
+        if (L_seq == NULL) {
+            goto done;
+        }
+        if (PySequence_Fast_GET_SIZE(L_seq) != ndim) {
+            Py_DECREF(L_seq);
+            error="L must have one length per dimension of the fields";
+            goto done;
+        }
+        for (int a=0; a<ndim; a++) {
+            Ld[(ndim == 2 and a == 1) ? 2 : a]=PyFloat_AsDouble(PySequence_Fast_GET_ITEM(L_seq, a));
+        }
+        Py_DECREF(L_seq);
+        if (PyErr_Occurred()) {
+            goto done;
+        }
+    }
+
+    //Parameters normally read from para.yaml and from the command line
+    {
+        npy_intp* n=PyArray_DIMS((PyArrayObject*) fields[0]);
+        two_dimension_switch=(ndim == 2);
+        scalar_switch=(fields.size() == 1);
+        longitudinal=long_in;
+        Nx=n[0];
+        Ny=two_dimension_switch ? 1 : n[1];
+        Nz=two_dimension_switch ? n[1] : n[2];
+        Lx=Ld[0];
+        Ly=Ld[1];
+        Lz=Ld[2];
+        dx=(Nx == 1) ? 0 : Lx/double(Nx-1);
+        dy=(Ny == 1) ? 0 : Ly/double(Ny-1);
+        dz=(Nz == 1) ? 0 : Lz/double(Nz-1);
+        q1=q1_in;
+        q2=q2_in;
+        reset_parameters();
+        P=px=py=pz=1;
+        rank_mpi=0;
+        pair_count=0;
+        if (Nx < 2 or Nz < 2 or (not two_dimension_switch and Ny < 2)) {
+            error="the fields must have at least 2 points along every direction";
+            goto done;
+        }
+    }
+
+    if (scalar_switch) {
+        if (two_dimension_switch) {
+            T_2D.reference(view_2D((PyArrayObject*) fields[0]));
+        }
+        else {
+            T.reference(view_3D((PyArrayObject*) fields[0]));
+        }
+        S1=new_SF(SF_Grid_scalar, SF_Grid2D_scalar, q2-q1+1);
+    }
+    else {
+        if (two_dimension_switch) {
+            V1_2D.reference(view_2D((PyArrayObject*) fields[0]));
+            V3_2D.reference(view_2D((PyArrayObject*) fields[1]));
+        }
+        else {
+            V1.reference(view_3D((PyArrayObject*) fields[0]));
+            V2.reference(view_3D((PyArrayObject*) fields[1]));
+            V3.reference(view_3D((PyArrayObject*) fields[2]));
+        }
+        S1=new_SF(SF_Grid_pll, SF_Grid2D_pll, q2-q1+1);
+        if (not longitudinal) {
+            S2=new_SF(SF_Grid_perp, SF_Grid2D_perp, q2-q1+1);
+        }
+    }
+    mask_switch=(mask_arr != NULL);
+    if (mask_switch) {
+        mask_condition=0;
+        mask_runs.clear();
+        mask_rows.assign(1, 0);
+        append_mask_runs((double*) PyArray_DATA((PyArrayObject*) mask_arr), long(Nx)*Ny);
+        Np=new_SF(SF_Grid_count, SF_Grid2D_count, 0);
+    }
+    if (S1 == NULL or (S2 == NULL and not scalar_switch and not longitudinal) or (Np == NULL and mask_switch)) {
+        goto done;
+    }
+
+    //The kernels hold the GIL: the parameters are global, hence the calls must not overlap
+    if (threads > 0) {
+        omp_set_num_threads(threads);
+    }
+    calc_SFs();
+
+    result=PyDict_New();
+    if (result != NULL) {
+        PyDict_SetItemString(result, scalar_switch ? "scalar" : "pll", S1);
+        if (S2 != NULL) {
+            PyDict_SetItemString(result, "perp", S2);
+        }
+        if (Np != NULL) {
+            PyDict_SetItemString(result, "count", Np);
+        }
+    }
+
+done:
+    if (error != NULL) {
+        PyErr_SetString(PyExc_ValueError, error);
+    }
+    release_views();
+    mask_switch=false;
+    for (size_t c=0; c<fields.size(); c++) {
+        Py_XDECREF(fields[c]);
+    }
+    Py_XDECREF(mask_arr);
+    Py_XDECREF(S1);
+    Py_XDECREF(S2);
+    Py_XDECREF(Np);
+    return result;
+}
+
+static PyMethodDef fastsf_methods[]={
+    {"structure_functions", (PyCFunction) structure_functions, METH_VARARGS | METH_KEYWORDS,
+     "structure_functions(fields, L=None, q1=1, q2=4, longitudinal=False, mask=None, threads=0)\n\n"
+     "Compute the structure functions of a scalar field (an array) or of a velocity field (a sequence (ux, uz) or (ux, uy, uz)) of\n"
+     "2D or 3D arrays. Returns a dict with 'pll' and 'perp' (or 'scalar') of shape (Nx/2, [Ny/2,] Nz/2, q2-q1+1), and 'count' if a\n"
+     "mask is given. C-contiguous float64 inputs are used without copying."},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef fastsf_module={
+    PyModuleDef_HEAD_INIT, "fastsf", "In-process structure functions of numpy arrays computed with the fastSF kernels.", -1,
+    fastsf_methods
+};
+
+PyMODINIT_FUNC PyInit_fastsf(void) {
+    import_array();
+    return PyModule_Create(&fastsf_module);
+}
@@ -0,0 +1,272 @@
+/********************************************************************************************************************************************
+ * fastSF
+ *
+ * Copyright (C) 2020, Mahendra K. Verma
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     1. Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *     2. Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *     3. Neither the name of the copyright holder nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ********************************************************************************************************************************************
+ */
+
+/*! \file libfastsf.cc
+ *
+ *  \brief Implementation of the fastSF library (see libfastsf.h).
+ *
+ *  The library compiles fastSF.cc without its main function. The global fields and structure function arrays of fastSF are made to
+ *  refer to the memory of the caller, so that the same kernels and the same distribution of the displacement vectors as the fastSF
+ *  executable are used without copying the fields or the results.
+ *
+ *  \author Shubhadeep Sadhukhan, Shashwat Bhattacharya, Mahendra K. Verma
+ *  \date Feb 2020
+ *  \copyright New BSD License
+ *
+ ********************************************************************************************************************************************
+ */
+
+#define FASTSF_NO_MAIN
+#include "fastSF.cc"
+#include "libfastsf.h"
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to set the global arrays of fastSF to the caller's fields and buffers (a null pointer releases an array).
+ *
+ * \param   grid is the 4D global array of a structure function (3D fields).
+ * \param   grid2D is the 3D global array of a structure function (2D fields).
+ * \param   A is the caller's buffer.
+ * \param   nq is the number of orders stored in the buffer.
+ ********************************************************************************************************************************************
+ */
+static void view_SF(Array<double,4>& grid, Array<double,3>& grid2D, double* A, int nq) {
+    if (A == NULL) {
+        grid.reference(Array<double,4>());
+        grid2D.reference(Array<double,3>());
+    }
+    else if (two_dimension_switch) {
+        grid2D.reference(Array<double,3>(A, shape(Nx/2, Nz/2, nq), neverDeleteData));
+        grid2D = 0;
+    }
+    else {
+        grid.reference(Array<double,4>(A, shape(Nx/2, Ny/2, Nz/2, nq), neverDeleteData));
+        grid = 0;
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to release the references of the global arrays to the memory of the caller.
+ ********************************************************************************************************************************************
+ */
+static void release_views() {
+    T.reference(Array<double,3>());
+    V1.reference(Array<double,3>());
+    V2.reference(Array<double,3>());
+    V3.reference(Array<double,3>());
+    T_2D.reference(Array<double,2>());
+    V1_2D.reference(Array<double,2>());
+    V3_2D.reference(Array<double,2>());
+    view_SF(SF_Grid_pll, SF_Grid2D_pll, NULL, 0);
+    view_SF(SF_Grid_perp, SF_Grid2D_perp, NULL, 0);
+    view_SF(SF_Grid_scalar, SF_Grid2D_scalar, NULL, 0);
+    view_SF(SF_Grid_count, SF_Grid2D_count, NULL, 0);
+    mask_runs.clear();
+    mask_rows.clear();
+    mask_switch=false;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to split the processors among the x, y, and z directions as done by get_Inputs() for the fastSF executable.
+ *
+ * \return  true if the split is valid.
+ ********************************************************************************************************************************************
+ */
+static bool set_processors(int px_in, int py_in) {
+    px=px_in;
+    if (px < 1 or px > P or P%px != 0) {
+        return false;
+    }
+    py=two_dimension_switch ? 1 : (py_in == 0 ? default_py() : py_in);
+    if (py < 1 or (P/px)%py != 0) {
+        return false;
+    }
+    pz=P/(px*py);
+    return px <= max(Nx/2,1) and py <= max(Ny/2,1) and pz <= max(Nz/2,1);
+}
+
+void fastsf_default_options(fastsf_options* options) {
+    options->L[0]=options->L[1]=options->L[2]=1;
+    options->q1=1;
+    options->q2=4;
+    options->longitudinal=0;
+    options->px=1;
+    options->py=0;
+    options->threads=0;
+    options->mask=NULL;
+}
+
+long fastsf_result_size(int ndim, const int* extents, const fastsf_options* options) {
+    fastsf_options defaults;
+    if (options == NULL) {
+        fastsf_default_options(&defaults);
+        options=&defaults;
+    }
+    long size=max(options->q2-options->q1+1, 0);
+    for (int a=0; a<ndim; a++) {
+        size*=extents[a]/2;
+    }
+    return size;
+}
+
+int fastsf_compute(const double* const* fields, int ncomp, int ndim, const int* extents, MPI_Comm comm,
+                   const fastsf_options* options, double* S, double* S_perp, double* count) {
+    fastsf_options defaults;
+    if (options == NULL) {
+        fastsf_default_options(&defaults);
+        options=&defaults;
+    }
+
+    if ((ndim != 2 and ndim != 3) or (ncomp != 1 and ncomp != ndim) or fields == NULL) {
+        return FASTSF_ERROR_FIELDS;
+    }
+    for (int c=0; c<ncomp; c++) {
+        if (fields[c] == NULL) {
+            return FASTSF_ERROR_FIELDS;
+        }
+    }
+    for (int a=0; a<ndim; a++) {
+        if (extents[a] < 2) {
+            return FASTSF_ERROR_FIELDS;
+        }
+    }
+    if (options->q1 > options->q2) {
+        return FASTSF_ERROR_ORDERS;
+    }
+
+    //Parameters normally read from para.yaml and from the command line
+    comm_SF=comm;
+    MPI_Comm_rank(comm_SF, &rank_mpi);
+    MPI_Comm_size(comm_SF, &P);
+    two_dimension_switch=(ndim == 2);
+    scalar_switch=(ncomp == 1);
+    longitudinal=(options->longitudinal != 0);
+    Nx=extents[0];
+    Ny=two_dimension_switch ? 1 : extents[1];
+    Nz=extents[ndim-1];
+    Lx=options->L[0];
+    Ly=options->L[1];
+    Lz=options->L[2];
+    dx=Lx/double(Nx-1);
+    dy=(Ny == 1) ? 0 : Ly/double(Ny-1);
+    dz=Lz/double(Nz-1);
+    q1=options->q1;
+    q2=options->q2;
+    reset_parameters();
+    mask_switch=(options->mask != NULL);
+    pair_count=0;
+    if (not set_processors(options->px, options->py)) {
+        return FASTSF_ERROR_PROCESSORS;
+    }
+    //The buffers are checked at rank 0 only, and all the processes return the same code
+    int missing=(rank_mpi==0 and (S == NULL or (S_perp == NULL and not scalar_switch and not longitudinal)
+                                  or (count == NULL and mask_switch)));
+    MPI_Bcast(&missing, 1, MPI_INT, 0, comm_SF);
+    if (missing) {
+        return FASTSF_ERROR_OUTPUT;
+    }
+
+    //The kernels only read the fields
+    double* f[3];
+    for (int c=0; c<ncomp; c++) {
+        f[c]=const_cast<double*>(fields[c]);
+    }
+    if (two_dimension_switch) {
+        TinyVector<int,2> n=shape(Nx, Nz);
+        if (scalar_switch) {
+            T_2D.reference(Array<double,2>(f[0], n, neverDeleteData));
+        }
+        else {
+            V1_2D.reference(Array<double,2>(f[0], n, neverDeleteData));
+            V3_2D.reference(Array<double,2>(f[1], n, neverDeleteData));
+        }
+    }
+    else {
+        TinyVector<int,3> n=shape(Nx, Ny, Nz);
+        if (scalar_switch) {
+            T.reference(Array<double,3>(f[0], n, neverDeleteData));
+        }
+        else {
+            V1.reference(Array<double,3>(f[0], n, neverDeleteData));
+            V2.reference(Array<double,3>(f[1], n, neverDeleteData));
+            V3.reference(Array<double,3>(f[2], n, neverDeleteData));
+        }
+    }
+    if (rank_mpi==0) {
+        if (scalar_switch) {
+            view_SF(SF_Grid_scalar, SF_Grid2D_scalar, S, q2-q1+1);
+        }
+        else {
+            view_SF(SF_Grid_pll, SF_Grid2D_pll, S, q2-q1+1);
+            if (not longitudinal) {
+                view_SF(SF_Grid_perp, SF_Grid2D_perp, S_perp, q2-q1+1);
+            }
+        }
+        if (mask_switch) {
+            view_SF(SF_Grid_count, SF_Grid2D_count, count, 1);
+        }
+    }
+    if (mask_switch) {
+        mask_condition=0;
+        mask_runs.clear();
+        mask_rows.assign(1, 0);
+        append_mask_runs(options->mask, long(Nx)*Ny);
+    }
+
+    if (options->threads > 0) {
+        omp_set_num_threads(options->threads);
+    }
+    calc_SFs();
+
+    release_views();
+    return FASTSF_SUCCESS;
+}
+
+const char* fastsf_error_string(int status) {
+    switch (status) {
+        case FASTSF_SUCCESS:
+            return "success";
+        case FASTSF_ERROR_FIELDS:
+            return "invalid number of components, dimensions, or extents of the fields, or missing field";
+        case FASTSF_ERROR_ORDERS:
+            return "q1 must not be greater than q2";
+        case FASTSF_ERROR_PROCESSORS:
+            return "the processors cannot be split among the directions as requested by px and py";
+        case FASTSF_ERROR_OUTPUT:
+            return "a result buffer is missing at rank 0";
+        default:
+            return "unknown status";
+    }
+}
@@ -0,0 +1,149 @@
+/********************************************************************************************************************************************
+ * fastSF
+ *
+ * Copyright (C) 2020, Mahendra K. Verma
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     1. Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *     2. Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *     3. Neither the name of the copyright holder nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ********************************************************************************************************************************************
+ */
+
+/*! \file libfastsf.h
+ *
+ *  \brief C interface of the fastSF library, computing structure functions of fields held in memory by the caller.
+ *
+ *  The library is meant for in-situ analysis: a simulation passes pointers to its fields, their extents, and a communicator, and the
+ *  structure functions are computed into buffers provided by the caller, without reading or writing files. Every process of the
+ *  communicator needs the complete fields (as for the fastSF executable), and the displacement vectors are distributed among the
+ *  processes. The results are returned at rank 0 of the communicator.
+ *
+ *  The parameters of a computation are kept in global variables, which are reset to their defaults at every call, hence the calls must
+ *  not overlap but do not depend on each other.
+ *
+ *  \author Shubhadeep Sadhukhan, Shashwat Bhattacharya, Mahendra K. Verma
+ *  \date Feb 2020
+ *  \copyright New BSD License
+ *
+ ********************************************************************************************************************************************
+ */
+
+#ifndef LIBFASTSF_H
+#define LIBFASTSF_H
+
+#include <mpi.h>
+
+//Only the functions below are exported by libfastsf.so, so that the globals of fastSF cannot clash with those of the caller
+#if defined(__GNUC__)
+#define FASTSF_API __attribute__((visibility("default")))
+#else
+#define FASTSF_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Return codes of the library functions.
+ ********************************************************************************************************************************************
+ */
+enum fastsf_status {
+    FASTSF_SUCCESS = 0,          //!< The structure functions have been computed.
+    FASTSF_ERROR_FIELDS = 1,     //!< Invalid number of components, dimensions, or extents, or a missing field pointer.
+    FASTSF_ERROR_ORDERS = 2,     //!< q1 is greater than q2.
+    FASTSF_ERROR_PROCESSORS = 3, //!< The processors cannot be split as requested by px and py.
+    FASTSF_ERROR_OUTPUT = 4      //!< A result buffer needed at rank 0 is missing.
+};
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Options of a computation, corresponding to the entries of para.yaml and to the command line arguments of fastSF.
+ ********************************************************************************************************************************************
+ */
+typedef struct fastsf_options {
+    double L[3];        //!< Lengths of the domain along x, y, and z (L[1] is not used for 2D fields).
+    int q1;             //!< Lowest order of the structure functions.
+    int q2;             //!< Highest order of the structure functions.
+    int longitudinal;   //!< Nonzero to compute only the longitudinal structure functions of a velocity field.
+    int px;             //!< Number of processors in x direction.
+    int py;             //!< Number of processors in y direction (3D fields), or 0 to let the library choose it.
+    int threads;        //!< Number of OpenMP threads per process, or 0 to keep the current setting.
+    const double* mask; //!< Optional field of the same extents; only the pairs of points where both values are nonzero are used.
+} fastsf_options;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to set the default options: unit lengths, q1 = 1, q2 = 4, both structure functions, px = 1, and no mask.
+ ********************************************************************************************************************************************
+ */
+FASTSF_API void fastsf_default_options(fastsf_options* options);
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the number of doubles of one structure function buffer, (Nx/2) (Ny/2) (Nz/2) (q2-q1+1) for 3D fields and
+ *          (Nx/2) (Nz/2) (q2-q1+1) for 2D fields. The count buffer has (q2-q1+1) times fewer elements.
+ *
+ * \param   ndim is the number of dimensions of the fields (2 or 3).
+ * \param   extents are the numbers of grid points, (Nx, Nz) for 2D fields and (Nx, Ny, Nz) for 3D fields.
+ * \param   options are the options of the computation.
+ ********************************************************************************************************************************************
+ */
+FASTSF_API long fastsf_result_size(int ndim, const int* extents, const fastsf_options* options);
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the structure functions of a scalar or velocity field. It has to be called by all the processes of the
+ *          communicator with the same arguments (the buffers are needed only at rank 0).
+ *
+ * \param   fields are the pointers to the C-ordered fields: one pointer for a scalar field, and (u_x, u_z) or (u_x, u_y, u_z) for a 2D
+ *          or a 3D velocity field.
+ * \param   ncomp is the number of components (1 for a scalar field, ndim for a velocity field).
+ * \param   ndim is the number of dimensions of the fields (2 or 3).
+ * \param   extents are the numbers of grid points, (Nx, Nz) for 2D fields and (Nx, Ny, Nz) for 3D fields.
+ * \param   comm is the communicator of the processes sharing the work.
+ * \param   options are the options of the computation (NULL for the defaults).
+ * \param   S receives the scalar or the longitudinal structure functions, C-ordered as (lx, [ly,] lz, q-q1).
+ * \param   S_perp receives the transverse structure functions of a velocity field (not used for a scalar field or with longitudinal).
+ * \param   count receives the number of pairs of every displacement when a mask is given (may be NULL otherwise).
+ *
+ * \return  FASTSF_SUCCESS, or the error code (identical on all the processes).
+ ********************************************************************************************************************************************
+ */
+FASTSF_API int fastsf_compute(const double* const* fields, int ncomp, int ndim, const int* extents, MPI_Comm comm,
+                              const fastsf_options* options, double* S, double* S_perp, double* count);
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the description of a return code.
+ ********************************************************************************************************************************************
+ */
+FASTSF_API const char* fastsf_error_string(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
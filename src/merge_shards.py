@@ -0,0 +1,141 @@
+#############################################################################################################################################
+ # fastSF
+ #
+ # Copyright (C) 2020, Mahendra K. Verma
+ #
+ # All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions are met:
+ #     1. Redistributions of source code must retain the above copyright
+ #        notice, this list of conditions and the following disclaimer.
+ #     2. Redistributions in binary form must reproduce the above copyright
+ #        notice, this list of conditions and the following disclaimer in the
+ #        documentation and/or other materials provided with the distribution.
+ #     3. Neither the name of the copyright holder nor the
+ #        names of its contributors may be used to endorse or promote products
+ #        derived from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ # ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ # WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ # DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ # ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ # (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ # LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ # ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ # SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ #
+ ############################################################################################################################################
+ ##
+ ##! \file merge_shards.py
+ #
+ #   \brief Script to merge the partial results of sharded fastSF runs into the structure functions.
+ #
+ #   Every run with shard: shard_switch computes the displacement vectors of one shard and writes their raw sums over the pairs of points
+ #   and their numbers of pairs to out/SF_shard_k_of_n.h5. The script adds up the sums and the counts of all the given files, which may
+ #   come from several snapshots, divides them, and writes the files SF_Grid_pll, SF_Grid_perp, or SF_Grid_scalar of every order in the
+ #   same layout as fastSF. The snapshots are weighted by their numbers of pairs of points, which are equal without a mask.
+ #
+ #   \author Shubhadeep Sadhukhan, Shashwat Bhattacharya
+ #   \date Feb 2020
+ #   \copyright New BSD License
+ #
+ ############################################################################################################################################
+##
+
+import argparse
+import os
+import sys
+
+import h5py
+import numpy as np
+
+
+PARAMETERS = ["Nx", "Ny", "Nz", "q1", "q2", "scalar_switch", "2D_switch", "Only_longitudinal", "mask_switch", "signed_switch", "px"]
+
+
+def hdf5_writer(filename, dataset, data):
+	file_write = h5py.File(filename, 'w')
+	file_write.create_dataset(dataset, data=data)
+	file_write.close()
+
+
+def read_parameters(shard):
+	missing = [key for key in PARAMETERS if key not in shard.attrs]
+	if missing:
+		sys.exit("ERROR! The shard %s lacks the parameters %s; it was written by an older fastSF." % (shard.filename, missing))
+	return {key: int(shard.attrs[key]) for key in PARAMETERS}
+
+
+def signed_layout(A, slot_size, p):
+	"""Assemble the sign variants of order index p into the signed layout of fastSF, with the zero displacement in the middle."""
+	ny, nz = A.shape[1], A.shape[2]
+	J = np.arange(1 - ny, ny)[:, None]
+	K = np.arange(1 - nz, nz)[None, :]
+	if A.shape[1] == 1:
+		return A[:, 0, np.abs(K[0]), (K[0] < 0)*slot_size + p]
+	return A[:, np.abs(J), np.abs(K), (2*(J < 0) + (K < 0))*slot_size + p]
+
+
+def grid_layout(A, para, slot_size, p):
+	"""Return the array of order index p as written by fastSF."""
+	if para["signed_switch"]:
+		return signed_layout(A, slot_size, p)
+	if para["2D_switch"]:
+		return A[:, 0, :, p]
+	return A[..., p]
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Merge the shards (and snapshots) of fastSF into the structure functions.")
+	parser.add_argument("shards", nargs="+", help="shard files SF_shard_k_of_n.h5 written by fastSF")
+	parser.add_argument("--output", default="out", help="folder of the merged structure functions")
+	args = parser.parse_args()
+
+	para = None
+	sums = {}
+	for name in args.shards:
+		with h5py.File(name, "r") as shard:
+			if para is None:
+				para = read_parameters(shard)
+				nlx = int(shard.attrs["lx_total"])
+				count = np.zeros((nlx,) + shard["count"].shape[1:])
+				hits = np.zeros(nlx, dtype=int)
+			else:
+				other = read_parameters(shard)
+				differ = [key for key in PARAMETERS if other[key] != para[key]]
+				if differ:
+					sys.exit("ERROR! The parameters %s of %s differ from those of %s." % (differ, name, args.shards[0]))
+			lx = shard["lx"][...]
+			hits[lx] += 1
+			count[lx] += shard["count"][...]
+			for key in shard:
+				if key.startswith("sum_"):
+					if key not in sums:
+						sums[key] = np.zeros((nlx,) + shard[key].shape[1:])
+					sums[key][lx] += shard[key][...]
+
+	if hits.min() == 0:
+		sys.exit("ERROR! No shard covers the lx indices %s." % np.flatnonzero(hits == 0).tolist())
+	if hits.min() != hits.max():
+		print("WARNING: The lx indices are covered by %d to %d shards; the snapshots are not complete." % (hits.min(), hits.max()))
+
+	os.makedirs(args.output, exist_ok=True)
+	nq = para["q2"] - para["q1"] + 1
+	weights = np.repeat(count, nq, axis=-1)
+	for key, total in sums.items():
+		SF = np.divide(total, weights, out=np.zeros_like(total), where=weights > 0)
+		for q in range(para["q1"], para["q2"] + 1):
+			dataset = "SF_Grid_%s%d" % (key[4:], q)
+			hdf5_writer(os.path.join(args.output, dataset + ".h5"), dataset, grid_layout(SF, para, nq, q - para["q1"]))
+	if para["mask_switch"]:
+		hdf5_writer(os.path.join(args.output, "SF_Grid_count.h5"), "SF_Grid_count", grid_layout(count, para, 1, 0))
+
+	print("Merged %d shard files (%d lx displacements, each covered by %d) into %s" % (len(args.shards), nlx, hits.min(),
+	      args.output))
+
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,356 @@
+#############################################################################################################################################
+ # fastSF
+ #
+ # Copyright (C) 2020, Mahendra K. Verma
+ #
+ # All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions are met:
+ #     1. Redistributions of source code must retain the above copyright
+ #        notice, this list of conditions and the following disclaimer.
+ #     2. Redistributions in binary form must reproduce the above copyright
+ #        notice, this list of conditions and the following disclaimer in the
+ #        documentation and/or other materials provided with the distribution.
+ #     3. Neither the name of the copyright holder nor the
+ #        names of its contributors may be used to endorse or promote products
+ #        derived from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ # ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ # WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ # DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ # ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ # (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ # LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ # ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ # SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ #
+ ############################################################################################################################################
+ ##
+ ##! \file plan_runs.py
+ #
+ #   \brief Script to choose the decomposition of a fastSF run: the number of MPI processes per node, the number of threads per
+ #          process, and the numbers of processors in x and y direction.
+ #
+ #   For every decomposition of the given nodes and cores, the script applies the checks of fastSF on the numbers of processors,
+ #   estimates the memory per node, and computes the load balance of the displacement vectors with the same cost weighted dealing as
+ #   fastSF. The decompositions that fit in the memory are ranked by the largest number of pairs of points of a thread, and the best
+ #   ones are probed with short runs of fastSF on random fields, which compute a single shard of the displacement vectors. The time of
+ #   every probe is scaled to the full run, and the fastest decomposition is reported with the command to run it.
+ #
+ #   \author Shubhadeep Sadhukhan, Shashwat Bhattacharya
+ #   \date Feb 2020
+ #   \copyright New BSD License
+ #
+ ############################################################################################################################################
+##
+
+import argparse
+import csv
+import heapq
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+import h5py
+import numpy as np
+
+
+PARA_TEMPLATE = """#PARAMETERS FOR PROBING A DECOMPOSITION (generated by plan_runs.py)
+
+program:
+    scalar_switch: {scalar}
+    2D_switch : {two_d}
+    Only_longitudinal: {longitudinal}
+
+grid :
+    Nx : {Nx}
+    Ny : {Ny}
+    Nz : {Nz}
+
+domain_dimension :
+    Lx : 1.0
+    Ly : 1.0
+    Lz : 1.0
+
+structure_function :
+    q1 : {q1}
+    q2 : {q2}
+
+test :
+    test_switch : false
+
+shard :
+    shard_switch : true
+    index : 0
+    count : {shards}
+
+shared_fields :
+    shared_switch : {shared}
+"""
+
+
+def yaml_bool(value):
+	return "true" if value else "false"
+
+
+def hdf5_writer(filename, dataset, data):
+	file_write = h5py.File(filename, 'w')
+	file_write.create_dataset(dataset, data=data)
+	file_write.close()
+
+
+def divisors(n):
+	return [d for d in range(1, n + 1) if n % d == 0]
+
+
+def lag_costs(N, p):
+	"""Numbers of pairs of points along a direction of the p processors, dealt as by compute_index_list() of fastSF.
+
+	Returns the list of the sums of N - l over the displacements l of every processor, and the list of their numbers of displacements.
+	"""
+	load = [(0, r) for r in range(p)]
+	cost = [0]*p
+	size = [0]*p
+	for l in range(N//2):
+		least, r = heapq.heappop(load)
+		cost[r] += N - l
+		size[r] += 1
+		heapq.heappush(load, (least + N - l, r))
+	return cost, size
+
+
+def grid_y(args):
+	return 1 if args.two_d else args.grid[1]
+
+
+def components(args):
+	if args.scalar:
+		return 1
+	return 2 if args.two_d else 3
+
+
+def functions(args):
+	return 1 if args.scalar or args.longitudinal else 2
+
+
+def check_decomposition(args, P, px, py):
+	"""Apply the checks of get_Inputs() of fastSF. Returns pz and an empty string, or None and the error of fastSF."""
+	Nx, Nz = args.grid[0], args.grid[2]
+	Ny = grid_y(args)
+	if px < 1 or px > P or P % px != 0:
+		return None, "Number of processors in x direction has to divide the total number of processors"
+	if (P//px) % py != 0:
+		return None, "Number of processors in y direction has to divide the number of processors divided by the number of processors in x direction"
+	pz = P//(px*py)
+	if px > max(Nx//2, 1):
+		return None, "Number of processors in x direction should be less or equal to Nx/2"
+	if py > max(Ny//2, 1):
+		return None, "Number of processors in y direction should be less or equal to Ny/2"
+	if pz > max(Nz//2, 1):
+		return None, "Number of processors in z direction should be less or equal to Nz/2"
+	return pz, ""
+
+
+def balance(args, px, py, pz, shards=1):
+	"""Largest and mean numbers of pairs of points of a processor, and largest number of displacement vectors of a processor.
+
+	With shards, the lx displacements are dealt to px*shards processors and only the first shard is computed, as in a probe.
+	"""
+	cx, sx = lag_costs(args.grid[0], px*shards)
+	cy, sy = lag_costs(grid_y(args), py) if not args.two_d else ([1], [1])
+	cz, sz = lag_costs(args.grid[2], pz)
+	pairs = np.outer(np.outer(cx[:px], cy), cz).ravel()
+	lags = np.outer(np.outer(sx[:px], sy), sz).ravel()
+	return int(pairs.max()), float(pairs.mean()), int(lags.max())
+
+
+def memory_per_node(args, ranks_per_node, threads, max_lags):
+	"""Estimated memory in bytes of the node holding rank 0: input fields, blocks of structure functions, and buffers."""
+	Nx, Nz = args.grid[0], args.grid[2]
+	Ny = grid_y(args)
+	nq = args.q2 - args.q1 + 1
+	fields = 8*components(args)*Nx*Ny*Nz
+	local = 8*max_lags*(functions(args)*nq + 1)
+	rows = 8*threads*(components(args) + 1)*Nz
+	#rank 0 also holds the full structure functions and receives the blocks of the other processors one at a time
+	grid = 8*(Nx//2)*max(Ny//2, 1)*(Nz//2)*functions(args)*nq + local
+	copies = 1 if args.shared else ranks_per_node
+	return copies*fields + ranks_per_node*(local + rows) + grid
+
+
+def candidates(args):
+	"""All the decompositions of the nodes and cores, with their estimates. The cores of a node are split evenly among its processes."""
+	rows = []
+	for ranks_per_node in divisors(args.cores):
+		threads = args.cores//ranks_per_node
+		P = args.nodes*ranks_per_node
+		for px in divisors(P):
+			for py in ([1] if args.two_d else divisors(P//px)):
+				row = {"np": P, "ranks_per_node": ranks_per_node, "threads": threads, "px": px, "py": py, "status": "ok",
+				       "message": ""}
+				pz, message = check_decomposition(args, P, px, py)
+				if pz is None:
+					row["status"] = "invalid"
+					row["message"] = message
+					rows.append(row)
+					continue
+				max_pairs, mean_pairs, max_lags = balance(args, px, py, pz)
+				row["pz"] = pz
+				row["max_pairs"] = max_pairs
+				row["imbalance"] = max_pairs/mean_pairs
+				row["pairs_per_thread"] = max_pairs/threads
+				row["memory_GB"] = memory_per_node(args, ranks_per_node, threads, max_lags)/1e9
+				if row["memory_GB"] > args.memory*(1 - args.reserve):
+					row["status"] = "no_memory"
+					row["message"] = "needs %.3g GB per node" % row["memory_GB"]
+				rows.append(row)
+	return rows
+
+
+def field_names(args):
+	"""Return the names of the input fields of the probes."""
+	if args.scalar:
+		return ["T.Fr"]
+	if args.two_d:
+		return ["U.V1r", "U.V3r"]
+	return ["U.V1r", "U.V2r", "U.V3r"]
+
+
+def generate_fields(workdir, args):
+	"""Write the random input fields of the probes into workdir/in, once for all the probes.
+
+	The fields are kept if workdir/in already holds those of the same grid, kind of fields, and seed (recorded in fields.json), so
+	that neither the probes nor later plans of the same grid rewrite them.
+	"""
+	indir = os.path.join(workdir, "in")
+	Nx, Nz = args.grid[0], args.grid[2]
+	Ny = grid_y(args)
+	shape = (Nx, Nz) if args.two_d else (Nx, Ny, Nz)
+	stamp = {"shape": list(shape), "names": field_names(args), "seed": args.seed}
+	stamp_file = os.path.join(indir, "fields.json")
+	if os.path.isfile(stamp_file):
+		with open(stamp_file) as f:
+			if json.load(f) == stamp and all(os.path.isfile(os.path.join(indir, n + ".h5")) for n in stamp["names"]):
+				return
+	if os.path.isdir(workdir):
+		shutil.rmtree(workdir)
+	os.makedirs(indir)
+
+	rng = np.random.default_rng(args.seed)
+	for name in stamp["names"]:
+		hdf5_writer(os.path.join(indir, name + ".h5"), name, rng.standard_normal(shape))
+	with open(stamp_file, "w") as f:
+		json.dump(stamp, f)
+
+
+def write_para(workdir, args, shards):
+	"""Write the para.yaml of a probe into workdir/in."""
+	Nx, Nz = args.grid[0], args.grid[2]
+	with open(os.path.join(workdir, "in", "para.yaml"), "w") as para:
+		para.write(PARA_TEMPLATE.format(scalar=yaml_bool(args.scalar), two_d=yaml_bool(args.two_d),
+		                                longitudinal=yaml_bool(args.longitudinal), Nx=Nx, Ny=grid_y(args), Nz=Nz, q1=args.q1, q2=args.q2,
+		                                shards=shards, shared=yaml_bool(args.shared)))
+
+
+def probe(args, row):
+	"""Time the first of several shards with the decomposition of row, and scale the time to the full run."""
+	shards = max(1, min(args.probe_shards, (args.grid[0]//2)//row["px"]))
+	write_para(args.workdir, args, shards)
+	env = dict(os.environ)
+	env["OMP_NUM_THREADS"] = str(row["threads"])
+	cmd = args.mpirun.split() + ["-np", str(row["np"]), args.exe, str(row["px"]), str(row["py"])]
+	try:
+		proc = subprocess.run(cmd, cwd=args.workdir, env=env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+		                      universal_newlines=True, timeout=args.timeout)
+	except subprocess.TimeoutExpired:
+		return None, "timed out after %g s" % args.timeout
+	out = proc.stdout
+	if args.verbose:
+		print(out)
+
+	parallel = re.search(r"Time elapsed for the parallel part:\s*([0-9.eE+-]+)", out)
+	if proc.returncode != 0 or parallel is None:
+		error = re.search(r"ERROR!(.*)", out)
+		return None, error.group(1).strip() if error else "fastSF exited with code %d" % proc.returncode
+	probe_pairs = balance(args, row["px"], row["py"], row["pz"], shards)[0]
+	return float(parallel.group(1))*row["max_pairs"]/probe_pairs, ""
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Choose the decomposition of a fastSF run from estimates and short probes.")
+	parser.add_argument("--exe", default=os.path.abspath(os.path.join(os.path.dirname(__file__), "fastSF.out")),
+	                    help="path of the fastSF executable")
+	parser.add_argument("--mpirun", default="mpirun", help="MPI launcher of the probes, including any extra options")
+	parser.add_argument("--grid", type=int, nargs=3, required=True, metavar=("NX", "NY", "NZ"),
+	                    help="numbers of grid points (NY is ignored for 2D fields)")
+	parser.add_argument("--scalar", action="store_true", help="compute scalar instead of velocity structure functions")
+	parser.add_argument("--two_d", action="store_true", help="use 2D instead of 3D fields")
+	parser.add_argument("--longitudinal", action="store_true", help="compute only the longitudinal structure functions")
+	parser.add_argument("--q1", type=int, default=1, help="first order of the structure functions")
+	parser.add_argument("--q2", type=int, default=4, help="last order of the structure functions")
+	parser.add_argument("--nodes", type=int, default=1, help="number of nodes of the run")
+	parser.add_argument("--cores", type=int, default=os.cpu_count(), help="number of cores per node")
+	parser.add_argument("--memory", type=float, required=True, help="memory per node in GB")
+	parser.add_argument("--reserve", type=float, default=0.1, help="fraction of the memory kept for the system and MPI")
+	parser.add_argument("--shared", action="store_true", help="store the input fields once per node (shared_fields: shared_switch)")
+	parser.add_argument("--probes", type=int, default=3, help="number of decompositions probed, 0 to rank them by the estimates only")
+	parser.add_argument("--probe_shards", type=int, default=8,
+	                    help="number of shards of the displacement vectors, of which a probe computes the first one")
+	parser.add_argument("--seed", type=int, default=0, help="seed of the random input fields of the probes")
+	parser.add_argument("--timeout", type=float, default=600, help="maximum time in seconds allowed for one probe")
+	parser.add_argument("--workdir", default="plan_run", help="scratch folder for the inputs and outputs of the probes")
+	parser.add_argument("--output", default="plan", help="prefix of the CSV and JSON result files")
+	parser.add_argument("--verbose", action="store_true", help="print the output of fastSF")
+	args = parser.parse_args()
+
+	if args.probes > 0 and not os.path.isfile(args.exe):
+		sys.exit("fastSF executable not found at %s. Compile it first with make in the src folder." % args.exe)
+
+	rows = candidates(args)
+	admitted = sorted([r for r in rows if r["status"] == "ok"], key=lambda r: (r["pairs_per_thread"], r["memory_GB"]))
+	if not admitted:
+		sys.exit("ERROR! No decomposition of %d nodes of %d cores fits in %g GB per node." % (args.nodes, args.cores, args.memory))
+
+	if args.probes > 0:
+		generate_fields(args.workdir, args)
+	for row in admitted[:args.probes]:
+		row["t_predicted"], row["message"] = probe(args, row)
+		if row["t_predicted"] is None:
+			row["status"] = "rejected"
+		print("np=%d px=%d py=%d threads=%d: %s" % (row["np"], row["px"], row["py"], row["threads"],
+		      "%.4f s predicted" % row["t_predicted"] if row["t_predicted"] is not None else "failed (%s)" % row["message"]))
+
+	probed = [r for r in admitted if r.get("t_predicted") is not None]
+	best = min(probed, key=lambda r: r["t_predicted"]) if probed else next((r for r in admitted if r["status"] == "ok"), None)
+
+	fields = ["np", "ranks_per_node", "threads", "px", "py", "pz", "status", "memory_GB", "max_pairs", "imbalance",
+	          "pairs_per_thread", "t_predicted", "message"]
+	with open(args.output + ".csv", "w") as f:
+		writer = csv.DictWriter(f, fieldnames=fields, restval="")
+		writer.writeheader()
+		writer.writerows(rows)
+	with open(args.output + ".json", "w") as f:
+		json.dump({"best": best, "candidates": rows}, f, indent=2)
+
+	print("\n%4s %6s %8s %4s %4s %4s %10s %10s %14s" % ("np", "nodes", "threads", "px", "py", "pz", "memory_GB", "imbalance",
+	      "pairs/thread"))
+	for r in admitted[:max(args.probes, 10)]:
+		print("%4d %6d %8d %4d %4d %4d %10.4g %10.4f %14.4g" % (r["np"], args.nodes, r["threads"], r["px"], r["py"], r["pz"],
+		      r["memory_GB"], r["imbalance"], r["pairs_per_thread"]))
+	print("\n%d decompositions: %d admitted, %d invalid, %d over the memory" % (len(rows), len(admitted),
+	      sum(r["status"] == "invalid" for r in rows), sum(r["status"] == "no_memory" for r in rows)))
+	if best is None:
+		sys.exit("ERROR! All the probes failed.")
+	print("Best decomposition: OMP_NUM_THREADS=%d mpirun -np %d %s %d %d" % (best["threads"], best["np"], args.exe, best["px"],
+	      best["py"]))
+	print("Results written to %s.csv and %s.json" % (args.output, args.output))
+
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,243 @@
+#############################################################################################################################################
+ # fastSF
+ #
+ # Copyright (C) 2020, Mahendra K. Verma
+ #
+ # All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions are met:
+ #     1. Redistributions of source code must retain the above copyright
+ #        notice, this list of conditions and the following disclaimer.
+ #     2. Redistributions in binary form must reproduce the above copyright
+ #        notice, this list of conditions and the following disclaimer in the
+ #        documentation and/or other materials provided with the distribution.
+ #     3. Neither the name of the copyright holder nor the
+ #        names of its contributors may be used to endorse or promote products
+ #        derived from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ # ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ # WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ # DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ # ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ # (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ # LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ # ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ # SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ #
+ ############################################################################################################################################
+ ##
+ ##! \file scaling.py
+ #
+ #   \brief Script to run strong and weak scaling studies of fastSF on a local machine.
+ #
+ #   The script generates random input fields, writes the corresponding para.yaml, runs fastSF with mpirun for every combination of
+ #   grid size, number of MPI processes, number of processors in x direction and number of threads, and collects the timings in a
+ #   CSV and a JSON table along with the parallel efficiencies.
+ #
+ #   \author Shubhadeep Sadhukhan, Shashwat Bhattacharya
+ #   \date Feb 2020
+ #   \copyright New BSD License
+ #
+ ############################################################################################################################################
+##
+
+import argparse
+import csv
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+import h5py
+import numpy as np
+
+
+PARA_TEMPLATE = """#PARAMETERS FOR COMPUTING THE STRUCTURE FUNCTIONS (generated by scaling.py)
+
+program:
+    scalar_switch: {scalar}
+    2D_switch : {two_d}
+    Only_longitudinal: {longitudinal}
+
+grid :
+    Nx : {Nx}
+    Ny : {Ny}
+    Nz : {Nz}
+
+domain_dimension :
+    Lx : 1.0
+    Ly : 1.0
+    Lz : 1.0
+
+structure_function :
+    q1 : {q1}
+    q2 : {q2}
+
+test :
+    test_switch : false
+"""
+
+
+def yaml_bool(value):
+	return "true" if value else "false"
+
+
+def hdf5_writer(filename, dataset, data):
+	file_write = h5py.File(filename, 'w')
+	file_write.create_dataset(dataset, data=data)
+	file_write.close()
+
+
+def generate_inputs(workdir, args, N):
+	"""Write random input fields and para.yaml for a grid of N points per direction into workdir/in."""
+	indir = os.path.join(workdir, "in")
+	if os.path.isdir(workdir):
+		shutil.rmtree(workdir)
+	os.makedirs(indir)
+
+	if args.two_d:
+		shape = (N, N)
+		Ny = 1
+	else:
+		shape = (N, N, N)
+		Ny = N
+
+	rng = np.random.default_rng(args.seed)
+	if args.scalar:
+		names = ["T.Fr"]
+	elif args.two_d:
+		names = ["U.V1r", "U.V3r"]
+	else:
+		names = ["U.V1r", "U.V2r", "U.V3r"]
+	for name in names:
+		hdf5_writer(os.path.join(indir, name + ".h5"), name, rng.standard_normal(shape))
+
+	with open(os.path.join(indir, "para.yaml"), "w") as para:
+		para.write(PARA_TEMPLATE.format(scalar=yaml_bool(args.scalar), two_d=yaml_bool(args.two_d),
+		                                longitudinal=yaml_bool(args.longitudinal), Nx=N, Ny=Ny, Nz=N,
+		                                q1=args.q1, q2=args.q2))
+
+
+def pair_count(N, two_d):
+	"""Number of pairs of points visited by fastSF for a grid of N points per direction (the work of the run)."""
+	per_direction = sum(N - l for l in range(N//2))
+	return per_direction**(2 if two_d else 3)
+
+
+def run_case(workdir, args, np_, px, threads):
+	"""Run fastSF once and return the parallel and total times, or None if fastSF rejected the decomposition."""
+	env = dict(os.environ)
+	env["OMP_NUM_THREADS"] = str(threads)
+	cmd = args.mpirun.split() + ["-np", str(np_), args.exe, str(px)]
+	try:
+		proc = subprocess.run(cmd, cwd=workdir, env=env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+		                      universal_newlines=True, timeout=args.timeout)
+	except subprocess.TimeoutExpired:
+		return None, "timed out after %g s" % args.timeout
+	out = proc.stdout
+	if args.verbose:
+		print(out)
+
+	parallel = re.search(r"Time elapsed for the parallel part:\s*([0-9.eE+-]+)", out)
+	total = re.search(r"Total time elapsed:\s*([0-9.eE+-]+)", out)
+	if proc.returncode != 0 or parallel is None or total is None:
+		error = re.search(r"ERROR!(.*)", out)
+		return None, error.group(1).strip() if error else "fastSF exited with code %d" % proc.returncode
+	return (float(parallel.group(1)), float(total.group(1))), ""
+
+
+def efficiencies(rows):
+	"""Add strong scaling and work-normalised efficiencies to the successful runs.
+
+	The strong scaling efficiency compares runs with the same grid against the run of that grid that used the fewest cores.
+	The work-normalised efficiency compares the pairs processed per core-second against the smallest run of the whole study,
+	which is the weak scaling efficiency when the grid grows with the number of cores.
+	"""
+	done = [r for r in rows if r["status"] == "ok"]
+	if not done:
+		return
+	rate = lambda r: r["pairs"]/(r["t_parallel"]*r["cores"])
+	reference = min(done, key=lambda r: (r["cores"], r["N"]))
+	for r in done:
+		same_grid = [s for s in done if s["N"] == r["N"]]
+		base = min(same_grid, key=lambda s: (s["cores"], s["t_parallel"]))
+		r["speedup"] = base["t_parallel"]/r["t_parallel"]
+		r["strong_efficiency"] = (base["t_parallel"]*base["cores"])/(r["t_parallel"]*r["cores"])
+		r["work_efficiency"] = rate(r)/rate(reference)
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Strong and weak scaling study of fastSF with synthetic input fields.")
+	parser.add_argument("--exe", default=os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "src", "fastSF.out")),
+	                    help="path of the fastSF executable")
+	parser.add_argument("--mpirun", default="mpirun", help="MPI launcher, including any extra options")
+	parser.add_argument("--np", type=int, nargs="+", default=[1, 2, 4], help="numbers of MPI processes")
+	parser.add_argument("--px", type=int, nargs="+", default=[1], help="numbers of processors in x direction")
+	parser.add_argument("--threads", type=int, nargs="+", default=[1], help="numbers of threads per MPI process")
+	parser.add_argument("--grid", type=int, nargs="+", default=[32], help="numbers of grid points per direction")
+	parser.add_argument("--scalar", action="store_true", help="compute scalar instead of velocity structure functions")
+	parser.add_argument("--two_d", action="store_true", help="use 2D instead of 3D fields")
+	parser.add_argument("--longitudinal", action="store_true", help="compute only the longitudinal structure functions")
+	parser.add_argument("--q1", type=int, default=1, help="first order of the structure functions")
+	parser.add_argument("--q2", type=int, default=4, help="last order of the structure functions")
+	parser.add_argument("--seed", type=int, default=0, help="seed of the random input fields")
+	parser.add_argument("--repeat", type=int, default=1, help="number of runs per case; the fastest one is kept")
+	parser.add_argument("--timeout", type=float, default=3600, help="maximum time in seconds allowed for one run")
+	parser.add_argument("--workdir", default="scaling_run", help="scratch folder for the generated inputs and outputs")
+	parser.add_argument("--output", default="scaling", help="prefix of the CSV and JSON result files")
+	parser.add_argument("--verbose", action="store_true", help="print the output of fastSF")
+	args = parser.parse_args()
+
+	if not os.path.isfile(args.exe):
+		sys.exit("fastSF executable not found at %s. Compile it first with make in the src folder." % args.exe)
+
+	rows = []
+	for N in args.grid:
+		generate_inputs(args.workdir, args, N)
+		for np_ in args.np:
+			for px in args.px:
+				for threads in args.threads:
+					row = {"N": N, "np": np_, "px": px, "threads": threads, "cores": np_*threads,
+					       "pairs": pair_count(N, args.two_d), "status": "ok", "message": ""}
+					times = []
+					for _ in range(args.repeat):
+						result, message = run_case(args.workdir, args, np_, px, threads)
+						if result is None:
+							# a failed repeat invalidates the whole case, including the timings of the earlier repeats
+							row["status"] = "rejected"
+							row["message"] = message
+							times = []
+							break
+						times.append(result)
+					if times:
+						row["t_parallel"], row["t_total"] = min(times)
+					print("N=%d np=%d px=%d threads=%d: %s" % (N, np_, px, threads,
+					      "%.4f s" % row["t_parallel"] if times else "skipped (%s)" % row["message"]))
+					rows.append(row)
+
+	efficiencies(rows)
+
+	fields = ["N", "np", "px", "threads", "cores", "pairs", "status", "t_parallel", "t_total", "speedup",
+	          "strong_efficiency", "work_efficiency", "message"]
+	with open(args.output + ".csv", "w") as f:
+		writer = csv.DictWriter(f, fieldnames=fields, restval="")
+		writer.writeheader()
+		writer.writerows(rows)
+	with open(args.output + ".json", "w") as f:
+		json.dump(rows, f, indent=2)
+
+	print("\n%6s %4s %4s %8s %12s %10s %10s" % ("N", "np", "px", "threads", "t_parallel", "strong_eff", "work_eff"))
+	for r in rows:
+		if r["status"] == "ok":
+			print("%6d %4d %4d %8d %12.4f %10.3f %10.3f" % (r["N"], r["np"], r["px"], r["threads"], r["t_parallel"],
+			      r["strong_efficiency"], r["work_efficiency"]))
+	print("\nResults written to %s.csv and %s.json" % (args.output, args.output))
+
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,170 @@
+/********************************************************************************************************************************************
+ * fastSF
+ *
+ * Copyright (C) 2020, Mahendra K. Verma
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     1. Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *     2. Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *     3. Neither the name of the copyright holder nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ********************************************************************************************************************************************
+ */
+
+/*! \file test_library.cc
+ *
+ *  \brief Test of libfastsf: successive calls of fastsf_compute() with different options must not depend on each other.
+ *
+ *  A 3D velocity field with a mask is computed first, then a 2D scalar field without mask, whose structure functions are compared with
+ *  those computed pair by pair, and then the 3D velocity field again, whose structure functions must be identical to those of the first
+ *  call. The test is passed if the relative difference is less than \f$ 10^{-10} \f$.
+ *
+ *  Usage: mpirun -np P test_library.out
+ *
+ *  \author Shubhadeep Sadhukhan, Shashwat Bhattacharya, Mahendra K. Verma
+ *  \date Feb 2020
+ *  \copyright New BSD License
+ *
+ ********************************************************************************************************************************************
+ */
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <mpi.h>
+#include "libfastsf.h"
+using namespace std;
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning a field of n pseudo-random values in [-1, 1), identical on all the processes.
+ ********************************************************************************************************************************************
+ */
+vector<double> random_field(long n, unsigned seed) {
+    vector<double> f(n);
+    for (long i=0; i<n; i++) {
+        seed=seed*1103515245u+12345u;
+        f[i]=(seed>>8)/double(1<<23)-1;
+    }
+    return f;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function computing the structure functions of a 3D velocity field with a mask; the buffers are filled at rank 0.
+ ********************************************************************************************************************************************
+ */
+int velocity_3D(const vector<double>* u, const vector<double>& mask, const int* extents, int P, vector<double>& S, vector<double>& S_perp,
+                vector<double>& count) {
+    fastsf_options options;
+    fastsf_default_options(&options);
+    options.L[0]=1.0;
+    options.L[1]=2.0;
+    options.L[2]=1.5;
+    options.q1=1;
+    options.q2=3;
+    options.px=P;
+    options.mask=mask.data();
+    long size=fastsf_result_size(3, extents, &options);
+    S.assign(size, 0);
+    S_perp.assign(size, 0);
+    count.assign(size/3, 0);
+    const double* fields[3]={u[0].data(), u[1].data(), u[2].data()};
+    return fastsf_compute(fields, 3, 3, extents, MPI_COMM_WORLD, &options, S.data(), S_perp.data(), count.data());
+}
+
+int main() {
+    MPI_Init(NULL, NULL);
+    int rank, P;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &P);
+
+    int extents[3]={8, 6, 10};
+    long n=long(extents[0])*extents[1]*extents[2];
+    vector<double> u[3]={random_field(n, 1), random_field(n, 2), random_field(n, 3)};
+    vector<double> mask=random_field(n, 4);
+    for (long i=0; i<n; i++) {
+        mask[i]=(mask[i] > -0.5);
+    }
+    vector<double> S1, S1_perp, count1, S2, S2_perp, count2;
+    int status=velocity_3D(u, mask, extents, P, S1, S1_perp, count1);
+
+    //2D scalar field without mask, with other orders and lengths
+    int extents_2D[2]={12, 10};
+    int Nx=extents_2D[0], Nz=extents_2D[1];
+    vector<double> T=random_field(long(Nx)*Nz, 5);
+    fastsf_options options;
+    fastsf_default_options(&options);
+    options.q1=2;
+    options.q2=4;
+    int nq=options.q2-options.q1+1;
+    vector<double> S(fastsf_result_size(2, extents_2D, &options));
+    const double* fields[1]={T.data()};
+    if (status == FASTSF_SUCCESS) {
+        status=fastsf_compute(fields, 1, 2, extents_2D, MPI_COMM_WORLD, &options, S.data(), NULL, NULL);
+    }
+    if (status == FASTSF_SUCCESS) {
+        status=velocity_3D(u, mask, extents, P, S2, S2_perp, count2);
+    }
+
+    if (rank==0) {
+        double error=0, scale=0;
+        for (int x=0; x<Nx/2; x++) {
+            for (int z=0; z<Nz/2; z++) {
+                for (int q=options.q1; q<=options.q2 and (x>0 or z>0); q++) {
+                    double sum=0;
+                    for (int i=0; i<Nx-x; i++) {
+                        for (int k=0; k<Nz-z; k++) {
+                            sum+=pow(T[long(i+x)*Nz+k+z]-T[long(i)*Nz+k], q);
+                        }
+                    }
+                    sum/=double(Nx-x)*(Nz-z);
+                    error=max(error, fabs(S[(long(x)*(Nz/2)+z)*nq+q-options.q1]-sum));
+                    scale=max(scale, fabs(sum));
+                }
+            }
+        }
+        error/=scale;
+        //The second computation of the 3D velocity field has to reproduce the first one
+        for (size_t i=0; i<S1.size(); i++) {
+            error=max(error, fabs(S1[i]-S2[i])+fabs(S1_perp[i]-S2_perp[i]));
+        }
+        for (size_t i=0; i<count1.size(); i++) {
+            error=max(error, fabs(count1[i]-count2[i]));
+        }
+        if (status != FASTSF_SUCCESS) {
+            cout<<"LIBRARY: TEST_FAILED. "<<fastsf_error_string(status)<<endl;
+        }
+        else if (error < 1e-10) {
+            cout<<"LIBRARY: TEST_PASSED. Successive calls with different options are independent. MAXIMUM RELATIVE ERROR: "<<error<<endl;
+        }
+        else {
+            cout<<"LIBRARY: TEST_FAILED. MAXIMUM RELATIVE ERROR: "<<error<<endl;
+            status=-1;
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Finalize();
+    return status == FASTSF_SUCCESS ? 0 : 1;
+}
@@ -0,0 +1,534 @@
+#############################################################################################################################################
+ # fastSF
+ #
+ # Copyright (C) 2020, Mahendra K. Verma
+ #
+ # All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions are met:
+ #     1. Redistributions of source code must retain the above copyright
+ #        notice, this list of conditions and the following disclaimer.
+ #     2. Redistributions in binary form must reproduce the above copyright
+ #        notice, this list of conditions and the following disclaimer in the
+ #        documentation and/or other materials provided with the distribution.
+ #     3. Neither the name of the copyright holder nor the
+ #        names of its contributors may be used to endorse or promote products
+ #        derived from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ # ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ # WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ # DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ # ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ # (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ # LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ # ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ # SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ #
+ ############################################################################################################################################
+ ##
+ ##! \file test_modes.py
+ #
+ #   \brief Script to validate the optional modes of fastSF against brute-force structure functions.
+ #
+ #   Every case writes small random input fields and a para.yaml, runs fastSF with mpirun, and compares its output with the structure
+ #   functions computed pair by pair with numpy: signed lags with a mask, the cylindrical bins, the progressive levels, the ensemble
+ #   with a resumed accumulator, the shards merged by merge_shards.py, the sub-blocks, the tensors, the particles, the spherical
+ #   harmonics, and the cache with extended orders. A case is PASSED if the relative difference is less than 1e-10.
+ #
+ #   \author Shubhadeep Sadhukhan, Shashwat Bhattacharya
+ #   \date Feb 2020
+ #   \copyright New BSD License
+ #
+ ############################################################################################################################################
+##
+
+import argparse
+import itertools
+import math
+import os
+import shutil
+import subprocess
+import sys
+
+import h5py
+import numpy as np
+from numpy.polynomial import legendre
+
+
+PARA_TEMPLATE = """#PARAMETERS FOR COMPUTING THE STRUCTURE FUNCTIONS (generated by test_modes.py)
+
+program:
+    scalar_switch: {scalar}
+    2D_switch : {two_d}
+    Only_longitudinal: false
+{program}
+grid :
+    Nx : {Nx}
+    Ny : {Ny}
+    Nz : {Nz}
+
+domain_dimension :
+    Lx : 1.0
+    Ly : 2.0
+    Lz : 1.5
+
+structure_function :
+    q1 : {q1}
+    q2 : {q2}
+
+test :
+    test_switch : false
+
+{extra}
+"""
+
+TOLERANCE = 1e-10
+
+
+def yaml_bool(value):
+	return "true" if value else "false"
+
+
+def hdf5_writer(filename, dataset, data):
+	file_write = h5py.File(filename, 'w')
+	file_write.create_dataset(dataset, data=data)
+	file_write.close()
+
+
+def hdf5_reader(filename, dataset):
+	file_read = h5py.File(filename, 'r')
+	data = file_read["/" + dataset][...]
+	file_read.close()
+	return data
+
+
+def field_names(scalar, two_d):
+	if scalar:
+		return ["T.Fr"]
+	if two_d:
+		return ["U.V1r", "U.V3r"]
+	return ["U.V1r", "U.V2r", "U.V3r"]
+
+
+class Case:
+	"""Input folder of a case: random fields of the shape (Nx, Ny, Nz), or (Nx, Nz) for 2D fields, and their para.yaml."""
+
+	def __init__(self, workdir, name, scalar, two_d, shape, seed=0, folder="in", clean=True):
+		self.dir = os.path.join(workdir, name)
+		self.scalar, self.two_d = scalar, two_d
+		self.Nx, self.Ny, self.Nz = shape
+		self.spacing = (1.0/(self.Nx - 1), 2.0/(self.Ny - 1) if self.Ny > 1 else 0.0, 1.5/(self.Nz - 1))
+		if clean and os.path.isdir(self.dir):
+			shutil.rmtree(self.dir)
+		os.makedirs(os.path.join(self.dir, folder), exist_ok=True)
+		os.makedirs(os.path.join(self.dir, "in"), exist_ok=True)
+
+		rng = np.random.default_rng(seed)
+		self.fields = []
+		for name in field_names(scalar, two_d) + ([] if scalar else ["T.Fr"]):
+			data = rng.standard_normal((self.Nx, self.Nz) if two_d else shape)
+			hdf5_writer(os.path.join(self.dir, folder, name + ".h5"), name, data)
+			self.fields.append(data[:, None, :] if two_d else data)
+		# the scalar field of a velocity case only serves as the mask
+		self.mask_field = self.fields[0] if scalar else self.fields.pop()
+
+	def add_scalar(self, name, seed):
+		"""Add a scalar field, to be listed in program: scalar_fields."""
+		data = np.random.default_rng(seed).standard_normal((self.Nx, self.Ny, self.Nz))
+		hdf5_writer(os.path.join(self.dir, "in", name + ".h5"), name, data)
+		self.fields.append(data)
+
+	def write_para(self, q1=1, q2=4, extra="", program=""):
+		with open(os.path.join(self.dir, "in", "para.yaml"), "w") as para:
+			para.write(PARA_TEMPLATE.format(scalar=yaml_bool(self.scalar), two_d=yaml_bool(self.two_d), Nx=self.Nx,
+			                                Ny=self.Ny, Nz=self.Nz, q1=q1, q2=q2, extra=extra, program=program))
+
+	def output(self, name):
+		return hdf5_reader(os.path.join(self.dir, "out", name + ".h5"), name)
+
+
+def run_fastSF(case, args, px=None):
+	"""Run fastSF in the folder of the case and return its output; stop the case if fastSF fails."""
+	cmd = args.mpirun.split() + ["-np", str(args.np), args.exe, str(args.np if px is None else px)]
+	proc = subprocess.run(cmd, cwd=case.dir, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+	if args.verbose:
+		print(proc.stdout)
+	if proc.returncode != 0 or "ERROR!" in proc.stdout:
+		raise RuntimeError("fastSF failed:\n" + proc.stdout[-2000:])
+	return proc.stdout
+
+
+def lag_ranges(case, signed):
+	"""Displacements along x, y, and z in the order of the output arrays."""
+	lx = range(case.Nx//2)
+	if signed:
+		return lx, range(-(case.Ny//2 - 1), case.Ny//2) if case.Ny > 1 else range(1), range(-(case.Nz//2 - 1), case.Nz//2)
+	return lx, range(max(case.Ny//2, 1)), range(case.Nz//2)
+
+
+def pairs(case, fields, signed=False, mask=None):
+	"""Brute force over the displacement vectors: yields the index of the displacement in the output arrays, the displacement,
+	the base points, and the increments of the fields of all the pairs of points, restricted to the mask if any."""
+	ranges = lag_ranges(case, signed)
+	for index in itertools.product(*[range(len(r)) for r in ranges]):
+		lag = tuple(r[i] for r, i in zip(ranges, index))
+		if lag == (0, 0, 0):
+			continue
+		base = tuple(slice(max(0, -l), N - max(0, l)) for l, N in zip(lag, (case.Nx, case.Ny, case.Nz)))
+		shifted = tuple(slice(max(0, l), N - max(0, -l)) for l, N in zip(lag, (case.Nx, case.Ny, case.Nz)))
+		valid = np.ones(fields[0][base].shape, bool) if mask is None else mask[base] & mask[shifted]
+		increments = [f[shifted][valid] - f[base][valid] for f in fields]
+		yield index, lag, base, valid, increments
+
+
+def projections(case, lag, increments):
+	"""Longitudinal and transverse velocity increments of a displacement vector."""
+	vector = np.array([l*d for l, d in zip(lag, case.spacing)])
+	if case.two_d:
+		vector = vector[[0, 2]]
+	unit = vector/np.linalg.norm(vector)
+	pll = sum(du*e for du, e in zip(increments, unit))
+	perp = np.sqrt(sum((du - pll*e)**2 for du, e in zip(increments, unit)))
+	return pll, perp
+
+
+def brute_force(case, fields, q1, q2, signed=False, mask=None):
+	"""Structure functions of every displacement vector, and their numbers of pairs of points, as fastSF stores them."""
+	ranges = lag_ranges(case, signed)
+	shape = tuple(len(r) for r in ranges)
+	kinds = ["scalar"] if case.scalar else ["pll", "perp"]
+	SF = {(kind, q): np.zeros(shape) for kind in kinds for q in range(q1, q2 + 1)}
+	SF["count"] = np.zeros(shape)
+	for index, lag, base, valid, increments in pairs(case, fields, signed, mask):
+		SF["count"][index] = len(increments[0])
+		if len(increments[0]) == 0:
+			continue
+		values = {"scalar": increments[0]} if case.scalar else dict(zip(kinds, projections(case, lag, increments)))
+		for q in range(q1, q2 + 1):
+			for kind in kinds:
+				SF[(kind, q)][index] = np.mean(values[kind]**q)
+	if case.two_d:
+		SF = {key: value[:, 0, :] for key, value in SF.items()}
+	return SF
+
+
+def difference(computed, expected):
+	"""Relative difference between two arrays; a shape mismatch is reported as an infinite difference."""
+	computed, expected = np.asarray(computed), np.asarray(expected)
+	if computed.shape != expected.shape:
+		return np.inf
+	return np.abs(computed - expected).max()/max(np.abs(expected).max(), 1e-300)
+
+
+def compare_grids(case, SF, q1, q2):
+	worst = 0.0
+	for key, expected in SF.items():
+		if key == "count":
+			continue
+		kind, q = key
+		worst = max(worst, difference(case.output("SF_Grid_%s%d" % (kind, q)), expected))
+	return worst
+
+
+def test_signed_mask(args):
+	"""Signed lags (user-036) of 3D velocity fields, with the mask of a scalar field above a threshold."""
+	case = Case(args.workdir, "signed_mask", False, False, (8, 6, 10))
+	case.write_para(extra="signed_lags:\n    signed_switch: true\n\nmask:\n    mask_switch: true\n    condition: T_above\n"
+	                      "    threshold: 0.2\n")
+	run_fastSF(case, args)
+	SF = brute_force(case, case.fields, 1, 4, signed=True, mask=case.mask_field > 0.2)
+	return max(compare_grids(case, SF, 1, 4), difference(case.output("SF_Grid_count"), SF["count"]))
+
+
+def cylindrical_case(args, name, two_d, extra=""):
+	"""Cylindrical bins (user-030) of the signed lags of velocity fields with a mask, about the z axis."""
+	case = Case(args.workdir, name, False, two_d, (8, 1, 10) if two_d else (8, 6, 10))
+	case.write_para(extra=extra + "anisotropy:\n    cylindrical_switch: true\n    axis: z\n\nsigned_lags:\n    signed_switch: true\n\n"
+	                      "mask:\n    mask_switch: true\n    condition: T_above\n    threshold: 0.2\n")
+	run_fastSF(case, args)
+	SF = brute_force(case, case.fields, 1, 4, signed=True, mask=case.mask_field > 0.2)
+	count = case.output("SF_cyl_count")
+	width = min(d for d in case.spacing[:2] if d > 0)
+	ranges = lag_ranges(case, True)
+	sums = {key: np.zeros(count.shape) for key in SF if key != "count"}
+	n = np.zeros(count.shape)
+	for index in itertools.product(*[range(len(r)) for r in ranges]):
+		lag = [abs(r[i]) for r, i in zip(ranges, index)]
+		shell = int(math.hypot(lag[0]*case.spacing[0], lag[1]*case.spacing[1])/width + 0.5)
+		grid = index[0::2] if two_d else index
+		n[shell, lag[2]] += SF["count"][grid]
+		for key in sums:
+			sums[key][shell, lag[2]] += SF["count"][grid]*SF[key][grid]
+	worst = difference(count, n)
+	for (kind, q), value in sums.items():
+		worst = max(worst, difference(case.output("SF_cyl_%s%d" % (kind, q)), value/np.maximum(n, 1)))
+	return worst
+
+
+def test_cylindrical(args):
+	"""Cylindrical bins of 3D and 2D velocity fields."""
+	return max(cylindrical_case(args, "cylindrical_3D", False), cylindrical_case(args, "cylindrical_2D", True))
+
+
+def test_progressive(args):
+	"""Progressive levels (user-043) written after every level, with the cylindrical bins collected again at every level."""
+	extra = "progressive:\n    progress_switch: true\n    interval: 0\n\n"
+	return max(cylindrical_case(args, "progressive_3D", False, extra), cylindrical_case(args, "progressive_2D", True, extra))
+
+
+def test_ensemble(args):
+	"""Ensemble of three snapshots of 2D velocity fields (user-037), resumed from the accumulator of the first two."""
+	snapshots = []
+	for s in range(3):
+		case = Case(args.workdir, "ensemble", False, True, (10, 1, 8), seed=s, folder="in/snap%d" % s, clean=(s == 0))
+		snapshots.append(brute_force(case, case.fields, 1, 4))
+	for count in (2, 3):
+		folders = ", ".join("in/snap%d" % s for s in range(count))
+		case.write_para(extra="ensemble:\n    ensemble_switch: true\n    snapshots: [%s]\n" % folders)
+		out = run_fastSF(case, args)
+	if "Resuming the ensemble" not in out:
+		raise RuntimeError("the ensemble was not resumed from the accumulator")
+	worst = 0.0
+	for key in snapshots[0]:
+		if key == "count":
+			continue
+		values = np.array([SF[key] for SF in snapshots])
+		name = "SF_Grid_%s%d" % key
+		worst = max(worst, difference(case.output(name), values.mean(0)))
+		worst = max(worst, difference(case.output(name + "_err"), values.std(0, ddof=1)/math.sqrt(len(values))))
+	return worst
+
+
+def test_shards(args):
+	"""Two shards of 3D scalar fields (user-038), merged by merge_shards.py."""
+	case = Case(args.workdir, "shards", True, False, (16, 6, 8))
+	files = []
+	for index in range(2):
+		case.write_para(extra="shard:\n    shard_switch: true\n    index: %d\n    count: 2\n" % index)
+		run_fastSF(case, args)
+		files.append(os.path.join(case.dir, "out", "SF_shard_%d_of_2.h5" % index))
+	merge = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "merge_shards.py")
+	proc = subprocess.run([sys.executable, merge] + files + ["--output", os.path.join(case.dir, "out")],
+	                      stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+	if proc.returncode != 0:
+		raise RuntimeError("merge_shards.py failed:\n" + proc.stdout)
+	return compare_grids(case, brute_force(case, case.fields, 1, 4), 1, 4)
+
+
+def blocks_case(args, name, scalar):
+	"""Structure functions of the sub-blocks (user-041) of 3D fields, the last sub-block of every direction smaller."""
+	case = Case(args.workdir, name, scalar, False, (8, 6, 10))
+	size = (3, 4, 4)
+	program = ""
+	if scalar:
+		case.add_scalar("S.Fr", 1)
+		program = "    scalar_fields: [T.Fr, S.Fr]\n"
+	case.write_para(extra="local_blocks:\n    block_switch: true\n    size_x: %d\n    size_y: %d\n    size_z: %d\n" % size,
+	                program=program)
+	run_fastSF(case, args)
+	blocks = [-(-N//s) for N, s in zip((case.Nx, case.Ny, case.Nz), size)]
+	I, J, K = np.meshgrid(np.arange(case.Nx), np.arange(case.Ny), np.arange(case.Nz), indexing="ij")
+	block_of = ((I//size[0])*blocks[1] + J//size[1])*blocks[2] + K//size[2]
+	n = blocks[0]*blocks[1]*blocks[2]
+	shape = tuple(len(r) for r in lag_ranges(case, False)) + (n,)
+	# file names of the structure functions of the sub-blocks, without the order
+	kinds = [("scalar", "_T.Fr"), ("scalar", "_S.Fr")] if scalar else [("pll", ""), ("perp", "")]
+	count = np.zeros(shape)
+	SF = {(kind, q): np.zeros(shape) for kind in kinds for q in range(1, 5)}
+	for index, lag, base, valid, increments in pairs(case, case.fields):
+		b = block_of[base][valid]
+		count[index] = np.bincount(b, minlength=n)
+		for kind, values in zip(kinds, increments if scalar else projections(case, lag, increments)):
+			for q in range(1, 5):
+				SF[(kind, q)][index] = np.bincount(b, values**q, minlength=n)/np.maximum(count[index], 1)
+	worst = difference(case.output("SF_block_count"), count)
+	for (kind, q), expected in SF.items():
+		worst = max(worst, difference(case.output("SF_block_%s%d%s" % (kind[0], q, kind[1])), expected))
+	return worst
+
+
+def test_blocks(args):
+	"""Sub-blocks of 3D velocity fields, and of two 3D scalar fields."""
+	return max(blocks_case(args, "blocks", False), blocks_case(args, "blocks_scalars", True))
+
+
+def tensor_case(args, name, two_d, extra="", mask=None):
+	"""Second and third order tensors of the velocity increments (user-047) of velocity fields."""
+	case = Case(args.workdir, name, False, two_d, (8, 1, 10) if two_d else (8, 6, 10))
+	case.write_para(extra="tensor:\n    tensor_switch: true\n    order: 3\n\n" + extra)
+	run_fastSF(case, args)
+	labels = "xz" if two_d else "xyz"
+	components = list(itertools.combinations_with_replacement(range(len(labels)), 2))
+	components += list(itertools.combinations_with_replacement(range(len(labels)), 3))
+	shape = tuple(len(r) for r in lag_ranges(case, False))
+	D = {c: np.zeros(shape) for c in components}
+	for index, lag, base, valid, increments in pairs(case, case.fields, mask=None if mask is None else case.mask_field > mask):
+		for c in components:
+			D[c][index] = np.mean(np.prod([increments[i] for i in c], axis=0)) if len(increments[0]) else 0
+	worst = 0.0
+	for c, expected in D.items():
+		if two_d:
+			expected = expected[:, 0, :]
+		worst = max(worst, difference(case.output("SF_Grid_tensor_" + "".join(labels[i] for i in c)), expected))
+	return worst
+
+
+def test_tensor(args):
+	"""Tensors of 3D velocity fields, and of 3D and 2D velocity fields whose rows are split by sub-blocks and a mask."""
+	split = ("local_blocks:\n    block_switch: true\n    size_x: 3\n    size_y: 4\n    size_z: 4\n\n"
+	         "mask:\n    mask_switch: true\n    condition: T_above\n    threshold: -0.5\n")
+	return max(tensor_case(args, "tensor", False), tensor_case(args, "tensor_split_3D", False, split, -0.5),
+	           tensor_case(args, "tensor_split_2D", True, split.replace("    size_y: 4\n", ""), -0.5))
+
+
+def test_particles(args):
+	"""Structure functions of scattered particles (user-048) with 3D velocities, over the bins of their separation."""
+	case = Case(args.workdir, "particles", False, False, (8, 8, 8))
+	rmax, bins = 0.4, 8
+	case.write_para(extra="particles:\n    particle_switch: true\n    max_separation: %g\n    bins: %d\n" % (rmax, bins))
+	rng = np.random.default_rng(1)
+	X = rng.uniform(0, 1, (400, 3))*[1.0, 2.0, 1.5]
+	V = rng.standard_normal((400, 3))
+	hdf5_writer(os.path.join(case.dir, "in", "particles.h5"), "particles", np.hstack([X, V]))
+	run_fastSF(case, args)
+
+	i, j = np.triu_indices(len(X), 1)
+	L = X[j] - X[i]
+	r = np.linalg.norm(L, axis=1)
+	near = (r > 0) & (r <= rmax)
+	i, j, L, r = i[near], j[near], L[near], r[near]
+	b = np.minimum((r/rmax*bins).astype(int), bins - 1)
+	count = np.bincount(b, minlength=bins)
+	unit = L/r[:, None]
+	dV = V[j] - V[i]
+	pll = (dV*unit).sum(1)
+	perp = np.linalg.norm(dV - pll[:, None]*unit, axis=1)
+	worst = difference(case.output("SF_particles_count"), count)
+	for q in range(1, 5):
+		for kind, values in (("pll", pll), ("perp", perp)):
+			expected = np.bincount(b, values**q, minlength=bins)/np.maximum(count, 1)
+			worst = max(worst, difference(case.output("SF_particles_%s%d" % (kind, q)), expected))
+	return worst
+
+
+def real_harmonics(vector, degree):
+	"""Real spherical harmonics Y_l^m of the direction of a vector about the z axis, at the index l*l + l + m."""
+	x, y, z = vector
+	cos_theta = z/math.sqrt(x*x + y*y + z*z)
+	phi = math.atan2(y, x)
+	Y = np.zeros((degree + 1)**2)
+	for l in range(degree + 1):
+		coefficients = np.zeros(l + 1)
+		coefficients[l] = 1
+		for m in range(l + 1):
+			P = (-1)**m*(1 - cos_theta**2)**(m/2.0)*legendre.legval(cos_theta, legendre.legder(coefficients, m))
+			K = math.sqrt((2*l + 1)/(4*math.pi)*math.factorial(l - m)/math.factorial(l + m))
+			if m == 0:
+				Y[l*l + l] = K*P
+			else:
+				Y[l*l + l + m] = math.sqrt(2)*K*P*math.cos(m*phi)
+				Y[l*l + l - m] = math.sqrt(2)*K*P*math.sin(m*phi)
+	return Y
+
+
+def test_harmonics(args):
+	"""Projections onto the spherical harmonics (user-049) of the signed lags of a 3D scalar field, in shells of |l|."""
+	case = Case(args.workdir, "harmonics", True, False, (8, 6, 8))
+	degree = 2
+	case.write_para(extra="harmonics:\n    harmonic_switch: true\n    degree: %d\n\nanisotropy:\n    axis: z\n\n"
+	                      "signed_lags:\n    signed_switch: true\n" % degree)
+	run_fastSF(case, args)
+	SF = brute_force(case, case.fields, 1, 4, signed=True)
+	ranges = lag_ranges(case, True)
+	width = min(case.spacing)
+	count = case.output("SF_harm_count")
+	worst = 0.0
+	for q in range(1, 5):
+		sums, n = np.zeros((len(count), (degree + 1)**2)), np.zeros(len(count))
+		for lag in itertools.product(range(-(case.Nx//2 - 1), case.Nx//2), ranges[1], ranges[2]):
+			if lag == (0, 0, 0):
+				continue
+			# S(-l) = (-1)^q S(l) for the displacements with l_x < 0, which are not computed
+			sign = (-1)**q if lag[0] < 0 else 1
+			half = tuple(-l for l in lag) if lag[0] < 0 else lag
+			value = sign*SF[("scalar", q)][half[0], half[1] - ranges[1][0], half[2] - ranges[2][0]]
+			vector = [l*d for l, d in zip(lag, case.spacing)]
+			shell = int(np.linalg.norm(vector)/width + 0.5)
+			sums[shell] += value*real_harmonics(vector, degree)
+			n[shell] += 1
+		worst = max(worst, difference(count, n))
+		worst = max(worst, difference(case.output("SF_harm_scalar%d" % q), 4*math.pi*sums/np.maximum(n, 1)[:, None]))
+	return worst
+
+
+def test_cache(args):
+	"""Cache of 3D velocity fields (user-050): the orders 1 to 2 are computed first, then extended to 1 to 4, then served for a
+	copied input and computed again for a rewritten one."""
+	case = Case(args.workdir, "cache", False, False, (8, 6, 10))
+	extra = "cache:\n    cache_switch: true\n"
+	case.write_para(1, 2, extra)
+	run_fastSF(case, args)
+	case.write_para(1, 4, extra)
+	out = run_fastSF(case, args)
+	if "Computing the orders 3 to 4 missing from the cache" not in out:
+		raise RuntimeError("the cached orders were computed again")
+	out = run_fastSF(case, args)
+	if "All the orders are found in the cache" not in out:
+		raise RuntimeError("the cache was missed with unchanged inputs")
+	# a copy of an input has a new identity but the same contents
+	path = os.path.join(case.dir, "in", "U.V1r.h5")
+	shutil.copy(path, path + ".copy")
+	os.replace(path + ".copy", path)
+	out = run_fastSF(case, args)
+	if "All the orders are found in the cache" not in out:
+		raise RuntimeError("the cache was missed with a copied input")
+	worst = compare_grids(case, brute_force(case, case.fields, 1, 4), 1, 4)
+	# an input rewritten with other values must be computed again
+	case.fields[0][0, 0, 0] += 1.0
+	hdf5_writer(path, "U.V1r", case.fields[0])
+	out = run_fastSF(case, args)
+	if "Computing the orders 1 to 4 missing from the cache" not in out:
+		raise RuntimeError("the cache served a rewritten input")
+	return max(worst, compare_grids(case, brute_force(case, case.fields, 1, 4), 1, 4))
+
+
+TESTS = [("signed lags with a mask", test_signed_mask), ("cylindrical bins", test_cylindrical),
+         ("progressive levels", test_progressive), ("ensemble", test_ensemble), ("shards", test_shards), ("sub-blocks", test_blocks),
+         ("tensor", test_tensor), ("particles", test_particles), ("spherical harmonics", test_harmonics), ("cache", test_cache)]
+
+
+def main():
+	parser = argparse.ArgumentParser(description="Validation of the optional modes of fastSF against brute-force structure functions.")
+	parser.add_argument("--exe", default=os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "src", "fastSF.out")),
+	                    help="path of the fastSF executable")
+	parser.add_argument("--mpirun", default="mpirun", help="MPI launcher, including any extra options")
+	parser.add_argument("--np", type=int, default=2, help="number of MPI processes, all in x direction")
+	parser.add_argument("--workdir", default="modes_run", help="scratch folder for the generated inputs and outputs")
+	parser.add_argument("--verbose", action="store_true", help="print the output of fastSF")
+	args = parser.parse_args()
+	args.exe = os.path.abspath(args.exe)
+
+	if not os.path.isfile(args.exe):
+		sys.exit("fastSF executable not found at %s. Compile it first with make in the src folder." % args.exe)
+
+	failed = 0
+	for name, test in TESTS:
+		try:
+			error = test(args)
+			message = "maximum relative difference %.3e" % error
+		except RuntimeError as e:
+			error, message = np.inf, str(e)
+		status = "PASSED" if error < TOLERANCE else "FAILED"
+		failed += status == "FAILED"
+		print("%-28s %s (%s)" % (name, status, message))
+
+	if failed:
+		sys.exit("%d of %d cases FAILED" % (failed, len(TESTS)))
+	print("All %d cases PASSED" % len(TESTS))
+
+
+if __name__ == "__main__":
+	main()